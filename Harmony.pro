@@ -25,33 +25,14 @@ CONFIG += thread
 
 TEMPLATE = app
 
+include(harmonycore.pri)
+
 SOURCES += main.cpp \
-    discretegroup.cpp \
-    topologicalsurface.cpp \
-    grouprepresentation.cpp \
-    sl2cmatrix.cpp \
-    cp1point.cpp \
-    h3point.cpp \
-    h2point.cpp \
-    sl2rmatrix.cpp \
     canvas.cpp \
-    h2geodesic.cpp \
     canvasdelegate.cpp \
+    canvastilecache.cpp \
     h2canvasdelegate.cpp \
-    planarline.cpp \
-    circle.cpp \
-    h2polygon.cpp \
-    h2isometry.cpp \
-    h3isometry.cpp \
-    tools.cpp \
-#    h3canvasdelegate.cpp\
-    fenchelnielsenconstructor.cpp \
-    h2mesh.cpp \
-    h2triangle.cpp \
-    h2polygontriangulater.cpp \
-    h2meshconstructor.cpp \
-    h2meshpoint.cpp \
-    word.cpp \
+#    h3canvasdelegate.cpp \
     topmenu.cpp \
     inputmenu.cpp \
     outputmenu.cpp \
@@ -61,48 +42,20 @@ SOURCES += main.cpp \
     topfactory.cpp \
     displaymenu.cpp \
     fenchelnielsenuser.cpp \
-    liftedgraph.cpp \
-    triangularsubdivision.cpp \
     h2discreteflowfactorythread.cpp \
     h2canvasdelegateliftedgraph.cpp \
     statusbar.cpp \
     canvasdelegatetests.cpp \
     tests.cpp \
     leftmenu.cpp \
-    fundamentaldomaingenerator.cpp \
-    mainwindow.cpp \
-    h2tangentvector.cpp \
-    discreteflowfactory.cpp \
-    discreteflowiterator.cpp
+    mainwindow.cpp
 
 HEADERS += \
-    discretegroup.h \
-    topologicalsurface.h \
-    grouprepresentation.h \
-    sl2cmatrix.h \
-    cp1point.h \
-    h3point.h \
-    h2point.h \
-    sl2rmatrix.h \
     canvas.h \
-    h2geodesic.h \
     canvasdelegate.h \
+    canvastilecache.h \
     h2canvasdelegate.h \
-    planarline.h \
-    circle.h \
-    h2polygon.h \
-    h2isometry.h \
-    h3isometry.h \
-    tools.h \
-    types.h \
-#    h3canvasdelegate.h\
-    fenchelnielsenconstructor.h \
-    h2mesh.h \
-    h2triangle.h \
-    h2polygontriangulater.h \
-    h2meshconstructor.h \
-    h2meshpoint.h \
-    word.h \
+#    h3canvasdelegate.h \
     topmenu.h \
     inputmenu.h \
     outputmenu.h \
@@ -112,18 +65,12 @@ HEADERS += \
     topfactory.h \
     displaymenu.h \
     fenchelnielsenuser.h \
-    liftedgraph.h \
-    triangularsubdivision.h \
     h2discreteflowfactorythread.h \
     h2canvasdelegateliftedgraph.h \
     statusbar.h \
     canvasdelegatetests.h \
     leftmenu.h \
-    fundamentaldomaingenerator.h \
-    mainwindow.h \
-    h2tangentvector.h \
-    discreteflowfactory.h \
-    discreteflowiterator.h
+    mainwindow.h
 
 OTHER_FILES += \
     TODO.txt
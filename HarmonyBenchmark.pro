@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Microbenchmarks of the geometry kernels, the flow iterations and the mesh construction (without widgets)
+#
+#-------------------------------------------------
+
+QT = core
+TARGET = HarmonyBenchmark
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+include(harmonycore.pri)
+
+SOURCES += harmonybenchmark.cpp
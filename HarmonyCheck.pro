@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Consistency checks of the flows (without widgets), exits with status 1 if one fails
+#
+#-------------------------------------------------
+
+QT = core
+TARGET = HarmonyCheck
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+include(harmonycore.pri)
+
+SOURCES += harmonycheck.cpp
@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Command line flow runner, without widgets (runs without a display)
+#
+#-------------------------------------------------
+
+QT = core
+TARGET = HarmonyCli
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+include(harmonycore.pri)
+
+SOURCES += harmonycli.cpp
@@ -155,8 +155,11 @@ void ActionHandler::processMessage(ActionHandlerMessage message)
     case ActionHandlerMessage::END_CANVAS_REPAINT:
         if (isShowingLive)
         {
-            topFactory->h2factory.factory.refreshImageFunction();
-            updateCanvasGraph(false, true);
+            // Only the values of the latest iteration are copied, without waiting for the flow thread
+            if (topFactory->h2factory.factory.refreshImageFunctionFromPublishedValues())
+            {
+                updateCanvasGraph(false, true);
+            }
             rightCanvas->update();
         }
         break;
@@ -184,6 +187,7 @@ void ActionHandler::computeButtonClicked()
     connect(outputMenu->computeButton, SIGNAL(clicked()), this, SLOT(stopButtonClicked()));
 
     isShowingLive = outputMenu->showLiveCheckbox->checkState();
+    topFactory->h2factory.factory.setPublishingValues(isShowingLive);
     topFactory->runH2Flow(outputMenu->flowComboBox->currentIndex());
     if (isShowingLive)
     {
@@ -488,19 +492,35 @@ void ActionHandler::flowChoiceClicked(int choice)
 {
     switch(choice)
     {
-    case OutputMenu::FLOW_CHOICE:
+    case FLOW_CHOICE:
         outputMenu->enableRunButtons(false);
         break;
 
-    case OutputMenu::FLOW_CENTROID:
+    case FLOW_CENTROID:
+        outputMenu->enableRunButtons(true);
+        break;
+
+    case FLOW_ENERGY_CONSTANT_STEP:
+        outputMenu->enableRunButtons(true);
+        break;
+
+    case FLOW_ENERGY_OPTIMAL_STEP:
         outputMenu->enableRunButtons(true);
         break;
 
-    case OutputMenu::FLOW_ENERGY_CONSTANT_STEP:
+    case FLOW_ENERGY_NEWTON:
         outputMenu->enableRunButtons(true);
         break;
 
-    case OutputMenu::FLOW_ENERGY_OPTIMAL_STEP:
+    case FLOW_MULTIGRID:
+        outputMenu->enableRunButtons(true);
+        break;
+
+    case FLOW_CENTROID_ANDERSON:
+        outputMenu->enableRunButtons(true);
+        break;
+
+    case FLOW_CENTROID_GAUSS_SEIDEL:
         outputMenu->enableRunButtons(true);
         break;
 
@@ -830,6 +850,12 @@ void ActionHandler::randomFNcoordinates(uint genus, std::vector<double> &lengths
 
 void ActionHandler::finishedComputing()
 {
+    if (isShowingLive)
+    {
+        // The flow thread has returned without refreshing the image function, which was read by the canvas
+        topFactory->h2factory.factory.setPublishingValues(false);
+        topFactory->h2factory.factory.refreshImageFunction();
+    }
     isShowingLive = false;
     leftCanvas->setEnabled(true);
     rightCanvas->setEnabled(true);
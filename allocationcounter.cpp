@@ -0,0 +1,86 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef HARMONY_COUNT_ALLOCATIONS
+
+static std::atomic<unsigned long long> nbAllocations(0);
+
+static void * countedAllocation(std::size_t size)
+{
+    nbAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *out = std::malloc(size == 0 ? 1 : size);
+    if (out == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return out;
+}
+
+void * operator new(std::size_t size)
+{
+    return countedAllocation(size);
+}
+
+void * operator new[](std::size_t size)
+{
+    return countedAllocation(size);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    nbAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    nbAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+
+bool AllocationCounter::isEnabled()
+{
+    return true;
+}
+
+unsigned long long AllocationCounter::getNbAllocations()
+{
+    return nbAllocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool AllocationCounter::isEnabled()
+{
+    return false;
+}
+
+unsigned long long AllocationCounter::getNbAllocations()
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+
+// Debug counter of the calls to the global operator new, from all threads.
+// The count is only maintained when compiling with HARMONY_COUNT_ALLOCATIONS defined (see Harmony.pro); otherwise it stays at 0.
+
+class AllocationCounter
+{
+public:
+    static bool isEnabled();
+    static unsigned long long getNbAllocations();
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,193 @@
+#include "canvastilecache.h"
+
+#include <functional>
+
+#include <QPainter>
+
+
+CanvasTileCache::CanvasTileCache(uint nbLayers, uint tileSize) : tileSize(tileSize), layersTiles(nbLayers), nbDraws(0)
+{
+    if (tileSize == 0)
+    {
+        throw(QString("Error in CanvasTileCache::CanvasTileCache: tiles must not be empty"));
+    }
+}
+
+void CanvasTileCache::setView(const std::vector<double> &viewKey)
+{
+    if (viewKey != this->viewKey)
+    {
+        this->viewKey = viewKey;
+        invalidateAll();
+    }
+}
+
+void CanvasTileCache::invalidateLayer(uint layer)
+{
+    layersTiles.at(layer).clear();
+}
+
+void CanvasTileCache::invalidateAll()
+{
+    for (auto &tiles : layersTiles)
+    {
+        tiles.clear();
+    }
+}
+
+int CanvasTileCache::tileFloor(int pixel) const
+{
+    int size = tileSize;
+    return (pixel >= 0) ? pixel/size : -((size - 1 - pixel)/size);
+}
+
+void CanvasTileCache::tilesRange(const QRect &area, int &iMin, int &iMax, int &jMin, int &jMax) const
+{
+    iMin = tileFloor(area.left());
+    iMax = tileFloor(area.left() + area.width() - 1);
+    jMin = tileFloor(area.top());
+    jMax = tileFloor(area.top() + area.height() - 1);
+}
+
+std::vector<QRect> CanvasTileCache::getRegionsToRender(uint layer, const QRect &area) const
+{
+    std::vector<QRect> res;
+    if (area.isEmpty())
+    {
+        return res;
+    }
+
+    const TileMap &tiles = layersTiles.at(layer);
+    int iMin, iMax, jMin, jMax, i, j;
+    tilesRange(area, iMin, iMax, jMin, jMax);
+
+    // After a pan, the missing tiles are a few complete rows and a few columns of the other rows
+    int jFullMin = jMax + 1, jFullMax = jMin - 1;
+    bool isRowMissing;
+    for (j=jMin; j<=jMax; ++j)
+    {
+        isRowMissing = true;
+        for (i=iMin; i<=iMax; ++i)
+        {
+            if (tiles.find(std::make_pair(i, j)) != tiles.end())
+            {
+                isRowMissing = false;
+                break;
+            }
+        }
+        if (isRowMissing)
+        {
+            jFullMin = std::min(jFullMin, j);
+            jFullMax = std::max(jFullMax, j);
+        }
+    }
+
+    int iRestMin = iMax + 1, iRestMax = iMin - 1, jRestMin = jMax + 1, jRestMax = jMin - 1;
+    for (j=jMin; j<=jMax; ++j)
+    {
+        if (j >= jFullMin && j <= jFullMax)
+        {
+            continue;
+        }
+        for (i=iMin; i<=iMax; ++i)
+        {
+            if (tiles.find(std::make_pair(i, j)) == tiles.end())
+            {
+                iRestMin = std::min(iRestMin, i);
+                iRestMax = std::max(iRestMax, i);
+                jRestMin = std::min(jRestMin, j);
+                jRestMax = std::max(jRestMax, j);
+            }
+        }
+    }
+
+    int size = tileSize;
+    if (jFullMin <= jFullMax)
+    {
+        res.push_back(QRect(iMin*size, jFullMin*size, (iMax - iMin + 1)*size, (jFullMax - jFullMin + 1)*size));
+    }
+    if (iRestMin <= iRestMax)
+    {
+        res.push_back(QRect(iRestMin*size, jRestMin*size, (iRestMax - iRestMin + 1)*size, (jRestMax - jRestMin + 1)*size));
+    }
+    return res;
+}
+
+void CanvasTileCache::insertTiles(uint layer, const QImage &image, const QPoint &topLeft)
+{
+    int size = tileSize;
+    if ((image.width() % size != 0) || (image.height() % size != 0) || (topLeft.x() % size != 0) || (topLeft.y() % size != 0))
+    {
+        throw(QString("Error in CanvasTileCache::insertTiles: the image is not made of whole tiles"));
+    }
+
+    TileMap &tiles = layersTiles.at(layer);
+    int i0 = tileFloor(topLeft.x()), j0 = tileFloor(topLeft.y());
+    for (int b=0; b!=image.height()/size; ++b)
+    {
+        for (int a=0; a!=image.width()/size; ++a)
+        {
+            Tile &tile = tiles[std::make_pair(i0 + a, j0 + b)];
+            tile.image = image.copy(a*size, b*size, size, size);
+            tile.lastUse = nbDraws;
+        }
+    }
+}
+
+void CanvasTileCache::drawLayer(uint layer, const QRect &area, QPainter &painter)
+{
+    if (area.isEmpty())
+    {
+        return;
+    }
+    ++nbDraws;
+
+    TileMap &tiles = layersTiles.at(layer);
+    int iMin, iMax, jMin, jMax, size = tileSize;
+    tilesRange(area, iMin, iMax, jMin, jMax);
+    for (int j=jMin; j<=jMax; ++j)
+    {
+        for (int i=iMin; i<=iMax; ++i)
+        {
+            auto it = tiles.find(std::make_pair(i, j));
+            if (it != tiles.end())
+            {
+                painter.drawImage(QPoint(i*size - area.left(), j*size - area.top()), it->second.image);
+                it->second.lastUse = nbDraws;
+            }
+        }
+    }
+
+    // Keep the tiles of about one more view around the current one, for pans back and forth
+    evictOldTiles(layer, 2*(iMax - iMin + 1)*(jMax - jMin + 1));
+}
+
+void CanvasTileCache::evictOldTiles(uint layer, uint maxNbTiles)
+{
+    TileMap &tiles = layersTiles.at(layer);
+    if (tiles.size() <= maxNbTiles)
+    {
+        return;
+    }
+
+    std::vector<uint> lastUses;
+    lastUses.reserve(tiles.size());
+    for (const auto &tile : tiles)
+    {
+        lastUses.push_back(tile.second.lastUse);
+    }
+    std::nth_element(lastUses.begin(), lastUses.begin() + (maxNbTiles - 1), lastUses.end(), std::greater<uint>());
+    uint oldestKept = lastUses[maxNbTiles - 1];
+
+    for (auto it = tiles.begin(); it != tiles.end();)
+    {
+        if (it->second.lastUse < oldestKept)
+        {
+            it = tiles.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CANVASTILECACHE_H
+#define CANVASTILECACHE_H
+
+#include <map>
+
+#include <QImage>
+#include <QRect>
+
+#include "tools.h"
+
+class QPainter;
+
+
+// Rasterized layers of a canvas back buffer, cut into square tiles of a pixel grid attached to the view.
+// The grid moves with pans, so that a pan only leaves new tiles to render. Anything else that moves the pixels
+// (zoom, resize, change of isometry) changes the view key and drops every tile; a change of the contents of one
+// layer drops the tiles of that layer only.
+// The tiles are transparent ARGB32 premultiplied images, drawn over each other in the order of the layers.
+class CanvasTileCache
+{
+public:
+    CanvasTileCache(uint nbLayers, uint tileSize = 256);
+
+    uint getTileSize() const {return tileSize;}
+
+    void setView(const std::vector<double> &viewKey);
+    void invalidateLayer(uint layer);
+    void invalidateAll();
+
+    // Rectangles of grid pixels, made of whole tiles, covering the tiles of layer meeting area that are not cached:
+    // one band for the complete rows, and the bounding rectangle of the other tiles
+    std::vector<QRect> getRegionsToRender(uint layer, const QRect &area) const;
+    // Cuts an image rendered for one of the regions above into tiles. The image top left pixel is the region top left grid pixel.
+    void insertTiles(uint layer, const QImage &image, const QPoint &topLeft);
+    // Draws the tiles of layer meeting area with painter, where the top left grid pixel of area is drawn at (0, 0)
+    void drawLayer(uint layer, const QRect &area, QPainter &painter);
+
+private:
+    struct Tile
+    {
+        QImage image;
+        uint lastUse;
+    };
+    typedef std::map< std::pair<int, int>, Tile > TileMap;
+
+    void tilesRange(const QRect &area, int &iMin, int &iMax, int &jMin, int &jMax) const;
+    int tileFloor(int pixel) const;
+    void evictOldTiles(uint layer, uint maxNbTiles);
+
+    uint tileSize;
+    std::vector<double> viewKey;
+    std::vector<TileMap> layersTiles;
+    uint nbDraws;
+};
+
+#endif // CANVASTILECACHE_H
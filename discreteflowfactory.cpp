@@ -1,7 +1,12 @@
 #include "discreteflowfactory.h"
 
+#include <limits>
+
 #include "fenchelnielsenconstructor.h"
-#include "h2discreteflowfactorythread.h"
+#include "flowcheckpoint.h"
+#include "flowchoice.h"
+#include "flowtelemetry.h"
+#include "profiler.h"
 
 template<typename Point, typename Map>
 DiscreteFlowFactory<Point, Map>::DiscreteFlowFactory(GroupRepresentation<H2Isometry> *rhoDomain,
@@ -9,7 +14,7 @@ DiscreteFlowFactory<Point, Map>::DiscreteFlowFactory(GroupRepresentation<H2Isome
                                                              LiftedGraphFunctionTriangulated<H2Point, H2Isometry> *domainFunction,
                                                              LiftedGraphFunctionTriangulated<H2Point, H2Isometry> *imageFunction) :
     rhoDomain(rhoDomain), rhoImage(rhoImage), domainFunction(domainFunction), initialImageFunction(nullptr), imageFunction(imageFunction),
-    iterator(nullptr)
+    iterator(nullptr), multigrid(nullptr)
 {
     isGenusSet = false;
     isRhoDomainSet = false;
@@ -17,6 +22,20 @@ DiscreteFlowFactory<Point, Map>::DiscreteFlowFactory(GroupRepresentation<H2Isome
     isMeshDepthSet = false;
 
     tolerance = 0.0000000001;
+    nbIterations = 0;
+    supError = 0.0;
+    energyError = 0.0;
+    energy = 0.0;
+    nbThreads = ThreadPool::defaultNbThreads();
+    andersonMemory = 5;
+    overRelaxationFactor = 0.0;
+    isPublishingValues = false;
+    nbIterationsSinceReset = 0;
+    nbIterationsBetweenCheckpoints = 0;
+    telemetry = nullptr;
+    telemetryEnergy = 0.0;
+    isInitialImageFunctionStale = false;
+    previousPathStepLength = 0.0;
 }
 
 template<typename Point, typename Map>
@@ -159,6 +178,7 @@ void DiscreteFlowFactory<Point, Map>::resetRhoImage()
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::initializeDomainFunction()
 {
+    PROFILE_SCOPE("DiscreteFlowFactory::initializeDomainFunction");
     if (!(isGenusSet && isRhoDomainSet && isMeshDepthSet))
     {
         throw(QString("Error in DiscreteFlowFactory<Point, Map>::initializeDomainFunction(): not ready to initialize domain function"));
@@ -179,12 +199,14 @@ void DiscreteFlowFactory<Point, Map>::initializeDomainFunction()
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::initializeImageFunction()
 {
+    PROFILE_SCOPE("DiscreteFlowFactory::initializeImageFunction");
     if (!isReady())
     {
         throw(QString("Error in DiscreteFlowFactory<Point, Map>::initializeImageFunction: Factory not ready to image function"));
     }
 
     initialImageFunction.reset(new LiftedGraphFunctionTriangulated<Point, Map>(*domainFunction, *rhoImage));
+    isInitialImageFunctionStale = false;
     resetInitial();
 }
 
@@ -197,17 +219,84 @@ bool DiscreteFlowFactory<Point, Map>::isReady() const
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::resetInitial()
 {
+    PROFILE_SCOPE("DiscreteFlowFactory::resetInitial");
     if (!isReady())
     {
         throw(QString("Error in DiscreteFlowFactory<Point, Map>::resetInit: Factory not ready to reset initial"));
     }
+    if (isInitialImageFunctionStale)
+    {
+        initialImageFunction.reset(new LiftedGraphFunctionTriangulated<Point, Map>(*domainFunction, *rhoImage));
+        isInitialImageFunctionStale = false;
+    }
+    previousPathValues.clear();
     imageFunction->cloneCopyAssign(initialImageFunction.get());
+    multigrid.reset();
     iterator.reset(new DiscreteFlowIterator<Point, Map>(initialImageFunction.get()));
+    iterator->setNbThreads(nbThreads);
+    iterator->setAndersonMemory(andersonMemory);
+    iterator->setOverRelaxationFactor(overRelaxationFactor);
+    nbIterationsSinceReset = 0;
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::continueRhoImage(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists, bool usePredictor)
+{
+    PROFILE_SCOPE("DiscreteFlowFactory::continueRhoImage");
+    if (!(isReady() && iterator))
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::continueRhoImage: Factory not ready"));
+    }
+    if (FNLengths.size() != FNLengthsImage.size() || FNTwists.size() != FNTwistsImage.size())
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::continueRhoImage: genus does not match number of FN coordinates"));
+    }
+
+    double stepLength = 0.0;
+    for (uint k=0; k!=FNLengths.size(); ++k)
+    {
+        stepLength += (FNLengths[k] - FNLengthsImage[k])*(FNLengths[k] - FNLengthsImage[k]);
+        stepLength += (FNTwists[k] - FNTwistsImage[k])*(FNTwists[k] - FNTwistsImage[k]);
+    }
+    stepLength = sqrt(stepLength);
+
+    std::vector<Point> values = iterator->getValues();
+    std::vector<Point> predictedValues = values;
+    if (usePredictor && !previousPathValues.empty() && previousPathStepLength > 0.0)
+    {
+        // Secant predictor, with the step lengths measured in FN coordinates
+        double s = 1.0 + stepLength/previousPathStepLength;
+        for (uint i=0; i!=values.size(); ++i)
+        {
+            if (!(previousPathValues[i] == values[i]))
+            {
+                predictedValues[i] = Point::proportionalPoint(previousPathValues[i], values[i], s);
+            }
+        }
+    }
+    previousPathValues = std::move(values);
+    previousPathStepLength = stepLength;
+
+    FNLengthsImage = FNLengths;
+    FNTwistsImage = FNTwists;
+    FenchelNielsenConstructor FN(FNLengths, FNTwists);
+    *rhoImage = FN.getRepresentation();
+
+    // setRepresentation also moves the lifts of each boundary point so that they are related by the new pairings
+    iterator->setValues(predictedValues);
+    iterator->setRepresentation(*rhoImage);
+    if (multigrid)
+    {
+        multigrid->setRepresentation(*rhoImage);
+    }
+    isInitialImageFunctionStale = true;
+    refreshImageFunction();
 }
 
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::refreshImageFunction()
 {
+    PROFILE_SCOPE("DiscreteFlowFactory::refreshImageFunction");
     iterator->getOutputFunction(imageFunction);
 }
 
@@ -229,6 +318,7 @@ template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::updateSupError()
 {
     supError = 2.0*iterator->updateSupDelta()/(minDomainEdgeLength*minDomainEdgeLength);
+    PROFILE_COUNTER("sup error", supError);
 }
 
 template<typename Point, typename Map>
@@ -243,12 +333,29 @@ void DiscreteFlowFactory<Point, Map>::updateEnergyError()
 
 }
 
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::updateEnergy()
+{
+    iterator->updateEnergy();
+    energy = iterator->getEnergy();
+}
+
 template<typename Point, typename Map>
 double DiscreteFlowFactory<Point, Map>::getTolerance() const
 {
     return tolerance;
 }
 
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setTolerance(double tolerance)
+{
+    if (tolerance <= 0.0)
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::setTolerance: tolerance must be positive"));
+    }
+    this->tolerance = tolerance;
+}
+
 
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::setFlowChoice(int flowChoice)
@@ -256,15 +363,81 @@ void DiscreteFlowFactory<Point, Map>::setFlowChoice(int flowChoice)
     this->flowChoice = flowChoice;
 }
 
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setNbThreads(uint nbThreads)
+{
+    // nbThreads = 0 means one thread per core
+    this->nbThreads = (nbThreads == 0) ? ThreadPool::defaultNbThreads() : nbThreads;
+    if (iterator)
+    {
+        iterator->setNbThreads(this->nbThreads);
+    }
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setAndersonMemory(uint andersonMemory)
+{
+    if (andersonMemory == 0)
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::setAndersonMemory: the memory must be positive"));
+    }
+    this->andersonMemory = andersonMemory;
+    if (iterator)
+    {
+        iterator->setAndersonMemory(andersonMemory);
+    }
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setOverRelaxationFactor(double overRelaxationFactor)
+{
+    if (overRelaxationFactor != 0.0 && (overRelaxationFactor < 1.0 || overRelaxationFactor >= 2.0))
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::setOverRelaxationFactor: the factor must be in [1, 2), or 0 for the automatic estimate"));
+    }
+    this->overRelaxationFactor = overRelaxationFactor;
+    if (iterator)
+    {
+        iterator->setOverRelaxationFactor(overRelaxationFactor);
+    }
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::iterateFlow()
+{
+    PROFILE_SCOPE("DiscreteFlowFactory::iterateFlow");
+    if (flowChoice == FLOW_MULTIGRID)
+    {
+        // The coarser meshes are solved first, and give the initial values on the mesh of depth meshDepth
+        // (unless the values were restored from a checkpoint)
+        if (!multigrid)
+        {
+            multigrid.reset(new DiscreteFlowMultigrid<Point, Map>(iterator.get(), *domainFunction, *rhoDomain, *rhoImage));
+            if (nbIterationsSinceReset == 0)
+            {
+                multigrid->runFullMultigrid();
+            }
+        }
+        multigrid->iterate();
+    }
+    else
+    {
+        iterator->iterate(flowChoice);
+    }
+}
+
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::run()
 {
-    stop = false;
+    PROFILE_SCOPE("DiscreteFlowFactory::run");
+    cancellation.reset();
     nbIterations = 0;
-    while(!stop)
+    progress.start(supError, tolerance);
+    while(!cancellation.isCancelled())
     {
-        iterator->iterate(flowChoice);
+        iterateFlow();
         ++nbIterations;
+        afterIteration();
 
         if ((nbIterations % 8)==0)
         {
@@ -274,20 +447,32 @@ void DiscreteFlowFactory<Point, Map>::run()
                 break;
             }
         }
+        progress.update(nbIterations, supError);
     }
     updateSupError();
-    refreshImageFunction();
+    progress.finish(nbIterations, supError);
+    if (!isPublishingValues)
+    {
+        refreshImageFunction();
+    }
+    if (!checkpointFileName.isEmpty())
+    {
+        writeCheckpoint();
+    }
 }
 
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::iterate(uint N)
 {
-    stop = false;
+    PROFILE_SCOPE("DiscreteFlowFactory::iterate");
+    cancellation.reset();
     nbIterations = 0;
-    while(!stop && nbIterations<N)
+    progress.start(supError, tolerance);
+    while(!cancellation.isCancelled() && nbIterations<N)
     {
-        iterator->iterate(flowChoice);
+        iterateFlow();
         ++nbIterations;
+        afterIteration();
 
         if ((nbIterations % 8)==0)
         {
@@ -297,15 +482,152 @@ void DiscreteFlowFactory<Point, Map>::iterate(uint N)
                 break;
             }
         }
+        progress.update(nbIterations, supError);
     }
     updateSupError();
-    refreshImageFunction();
+    progress.finish(nbIterations, supError);
+    if (!isPublishingValues)
+    {
+        refreshImageFunction();
+    }
+    if (!checkpointFileName.isEmpty())
+    {
+        writeCheckpoint();
+    }
 }
 
 template<typename Point, typename Map>
 void DiscreteFlowFactory<Point, Map>::stopRunning()
 {
-    stop = true;
+    cancellation.cancel();
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::afterIteration()
+{
+    ++nbIterationsSinceReset;
+    if (!checkpointFileName.isEmpty() && (nbIterationsSinceReset % nbIterationsBetweenCheckpoints) == 0)
+    {
+        writeCheckpoint();
+    }
+    if (telemetry && (nbIterationsSinceReset % telemetry->getStride()) == 0)
+    {
+        recordTelemetry();
+    }
+    if (isPublishingValues)
+    {
+        iterator->copyValues(publishedValues.getWriteBuffer());
+        publishedValues.publish();
+    }
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setPublishingValues(bool isPublishingValues)
+{
+    // Values published by a previous run, maybe on another mesh or for another representation, are never shown
+    this->isPublishingValues = isPublishingValues;
+    publishedValues.discard();
+}
+
+template<typename Point, typename Map>
+bool DiscreteFlowFactory<Point, Map>::refreshImageFunctionFromPublishedValues()
+{
+    PROFILE_SCOPE("DiscreteFlowFactory::refreshImageFunctionFromPublishedValues");
+    if (!publishedValues.update())
+    {
+        return false;
+    }
+    imageFunction->resetValues(publishedValues.getReadBuffer());
+    return true;
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setTelemetry(FlowTelemetry *telemetry)
+{
+    this->telemetry = telemetry;
+    telemetryEnergy = std::numeric_limits<double>::quiet_NaN();
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::recordTelemetry()
+{
+    PROFILE_SCOPE("DiscreteFlowFactory::recordTelemetry");
+    FlowTelemetry::Record record;
+    record.iteration = nbIterationsSinceReset;
+    updateEnergy();
+    record.energy = energy;
+    record.energyDelta = energy - telemetryEnergy;
+    telemetryEnergy = energy;
+    record.supDelta = iterator->updateSupDelta();
+    record.gradientNorm = iterator->computeGradientNorm();
+    record.step = iterator->getLastStep();
+    telemetry->record(record);
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::setCheckpointFile(const QString &fileName, uint nbIterationsBetweenCheckpoints)
+{
+    if (!fileName.isEmpty() && nbIterationsBetweenCheckpoints == 0)
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::setCheckpointFile: the number of iterations between checkpoints must be positive"));
+    }
+    checkpointFileName = fileName;
+    this->nbIterationsBetweenCheckpoints = nbIterationsBetweenCheckpoints;
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::writeCheckpoint() const
+{
+    PROFILE_SCOPE("DiscreteFlowFactory::writeCheckpoint");
+    if (!(isReady() && iterator))
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::writeCheckpoint: Factory not ready"));
+    }
+
+    FlowCheckpoint checkpoint;
+    checkpoint.genus = genus;
+    checkpoint.meshDepth = meshDepth;
+    checkpoint.flowChoice = flowChoice;
+    checkpoint.nbIterations = nbIterationsSinceReset;
+    checkpoint.FNLengthsDomain = FNLengthsDomain;
+    checkpoint.FNTwistsDomain = FNTwistsDomain;
+    checkpoint.FNLengthsImage = FNLengthsImage;
+    checkpoint.FNTwistsImage = FNTwistsImage;
+    checkpoint.values.resize(iterator->getNbPoints());
+    for (uint i=0; i!=iterator->getNbPoints(); ++i)
+    {
+        checkpoint.values[i] = iterator->getValue(i).getDiskCoordinate();
+    }
+    checkpoint.save(checkpointFileName);
+}
+
+template<typename Point, typename Map>
+void DiscreteFlowFactory<Point, Map>::resumeFromCheckpoint(const QString &fileName)
+{
+    FlowCheckpoint checkpoint;
+    checkpoint.load(fileName);
+
+    // The mesh is only built once, by setMeshDepth, after both representations are set
+    isMeshDepthSet = false;
+    setGenus(checkpoint.genus);
+    setRhoDomain(checkpoint.FNLengthsDomain, checkpoint.FNTwistsDomain);
+    setRhoImage(checkpoint.FNLengthsImage, checkpoint.FNTwistsImage);
+    setMeshDepth(checkpoint.meshDepth);
+    setFlowChoice(checkpoint.flowChoice);
+
+    if (checkpoint.values.size() != iterator->getNbPoints())
+    {
+        throw(QString("Error in DiscreteFlowFactory<Point, Map>::resumeFromCheckpoint: number of values does not match the mesh"));
+    }
+    std::vector<Point> values(checkpoint.values.size());
+    for (uint i=0; i!=values.size(); ++i)
+    {
+        values[i].setDiskCoordinate(checkpoint.values[i]);
+    }
+    iterator->setValues(values);
+    nbIterationsSinceReset = checkpoint.nbIterations;
+    nbIterations = 0;
+    refreshImageFunction();
 }
 
 
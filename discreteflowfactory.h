@@ -6,15 +6,19 @@
 #include "tools.h"
 #include "grouprepresentation.h"
 #include "discreteflowiterator.h"
+#include "discreteflowmultigrid.h"
 #include "liftedgraph.h"
+#include "flowprogress.h"
+#include "triplebuffer.h"
 
 
-template <typename Point, typename Map> class LiftedGraphFunctionTriangulated; class H2DiscreteFlowFactoryThread;
+template <typename Point, typename Map> class LiftedGraphFunctionTriangulated; class H2DiscreteFlowFactoryThread; class FlowTelemetry;
 
 template <typename Point, typename Map> class DiscreteFlowFactory
 {
     friend class ActionHandler;
     friend class H2DiscreteFlowFactoryThread;
+    friend class FlowRunner;
 
 public:
     DiscreteFlowFactory(GroupRepresentation<H2Isometry> *rhoDomain,
@@ -32,21 +36,57 @@ public:
     void resetRhoImage();
 
     void resetInitial();
+
+    // Continuation along a path of image representations: the mesh, the iterator and the current values are kept,
+    // only the pairings are refreshed for the new image representation. With usePredictor, the values are first
+    // extrapolated along the geodesics through the values at the two previous points of the path.
+    void continueRhoImage(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists, bool usePredictor);
     bool isDomainFunctionInitialized(uint &nbMeshPointsOut);
 
     double getSupError() const {return supError;}
     double getEnergyError() const {return energyError;}
+    double getEnergy() const {return energy;}
     void updateSupError();
     void updateEnergyError();
+    void updateEnergy();
     double getTolerance() const;
+    void setTolerance(double tolerance);
 
     void setFlowChoice(int flowChoice);
+    void setNbThreads(uint nbThreads);
+    uint getNbThreads() const {return nbThreads;}
+    // Number of previous iterates used by FLOW_CENTROID_ANDERSON
+    void setAndersonMemory(uint andersonMemory);
+    // Over-relaxation factor of FLOW_CENTROID_GAUSS_SEIDEL in [1, 2), or 0 for the automatic estimate
+    void setOverRelaxationFactor(double overRelaxationFactor);
 
     void run();
     void iterate(uint N);
-    void stopRunning();
     uint getNbIterations() const {return nbIterations;}
 
+    // stopRunning() and getProgress() may be called from any thread while run() or iterate(N) is running,
+    // unlike the other getters, which are for the thread running the flow.
+    void stopRunning();
+    FlowProgress::Snapshot getProgress() const {return progress.getSnapshot();}
+
+    // Live display: with setPublishingValues(true) (called before run() or iterate(N)), the values are published after each iteration,
+    // and the flow leaves imageFunction to the thread watching it. That thread copies the latest published values into imageFunction
+    // with refreshImageFunctionFromPublishedValues(), which returns false if none was published since its last call,
+    // and calls refreshImageFunction() once the flow has returned. setPublishingValues() drops the values left unread by the previous run.
+    void setPublishingValues(bool isPublishingValues);
+    bool refreshImageFunctionFromPublishedValues();
+
+    // When fileName is not empty, run() and iterate(N) write a checkpoint every nbIterationsBetweenCheckpoints iterations
+    // and when they return. resumeFromCheckpoint() sets up the factory from the checkpoint and restores the values of the flow;
+    // the state of the accelerations (Anderson history, estimate of the over-relaxation factor) is not saved, and starts again.
+    void setCheckpointFile(const QString &fileName, uint nbIterationsBetweenCheckpoints);
+    void writeCheckpoint() const;
+    void resumeFromCheckpoint(const QString &fileName);
+
+    // When telemetry is not null, run() and iterate(N) record the convergence of the flow every telemetry->getStride() iterations.
+    // The factory does not own the telemetry, which must be open.
+    void setTelemetry(FlowTelemetry *telemetry);
+
 private:
     bool isReady() const;
     void initializeDomainFunction();
@@ -54,12 +94,18 @@ private:
     void initializeRhoDomain();
     void initializeRhoImage();
     void refreshImageFunction();
+    void iterateFlow();
+    void afterIteration();
+    void recordTelemetry();
 
 
     uint genus, meshDepth;
 
     bool isGenusSet, isMeshDepthSet, isRhoDomainSet, isRhoImageSet;
-    bool stop;
+    CancellationToken cancellation;
+    FlowProgress progress;
+    bool isPublishingValues;
+    TripleBuffer< std::vector<Point> > publishedValues;
 
     std::vector<double> FNLengthsDomain, FNTwistsDomain, FNLengthsImage, FNTwistsImage;
 
@@ -69,8 +115,18 @@ private:
     std::unique_ptr<LiftedGraphFunctionTriangulated<Point, Map> > initialImageFunction;
     LiftedGraphFunctionTriangulated<Point, Map> *imageFunction;
     std::unique_ptr<DiscreteFlowIterator<Point, Map> > iterator;
-    uint nbIterations;
-    double minDomainEdgeLength, supError, energyError, tolerance;
+    std::unique_ptr<DiscreteFlowMultigrid<Point, Map> > multigrid;
+    uint nbIterations, nbThreads, andersonMemory;
+    double overRelaxationFactor;
+    uint nbIterationsSinceReset, nbIterationsBetweenCheckpoints;
+    QString checkpointFileName;
+    FlowTelemetry *telemetry;
+    double telemetryEnergy;
+
+    bool isInitialImageFunctionStale;
+    std::vector<Point> previousPathValues;
+    double previousPathStepLength;
+    double minDomainEdgeLength, supError, energyError, energy, tolerance;
 
     int flowChoice;
 
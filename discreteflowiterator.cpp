@@ -1,21 +1,91 @@
 #include "discreteflowiterator.h"
+#include "discreteflowmultigrid.h"
+#include "allocationcounter.h"
 #include "liftedgraph.h"
-#include "outputmenu.h"
+#include "flowchoice.h"
+#include "profiler.h"
 
 
 template <typename Point, typename Map>
-DiscreteFlowIterator<Point, Map>::DiscreteFlowIterator(const LiftedGraphFunction<Point, Map> *initialFunction) :
-    nbBoundaryPoints(initialFunction->nbBoundaryPoints),
-    nbPoints(initialFunction->nbPoints),
-    neighborsIndices(initialFunction->neighborsIndices),
-    neighborsWeightsCentroid(initialFunction->neighborsWeightsCentroid),
-    neighborsWeightsEnergy(initialFunction->neighborsWeightsEnergy),
-    boundaryPointsNeighborsPairingsValues(initialFunction->boundaryPointsNeighborsPairingsValues),
+DiscreteFlowIterator<Point, Map>::DiscreteFlowIterator(const LiftedGraphFunction<Point, Map> *initialFunction, ThreadPool *sharedThreadPool) :
+    topology(initialFunction->topology),
+    nbBoundaryPoints(topology->nbBoundaryPoints),
+    nbPoints(topology->nbPoints),
+    neighborsOffsets(topology->neighborsOffsets),
+    neighborsIndices(topology->neighborsIndices),
+    neighborsWeightsCentroid(topology->neighborsWeightsCentroid),
+    neighborsWeightsEnergy(topology->neighborsWeightsEnergy),
+    boundaryPointsNeighborsPairingsIndices(topology->boundaryPointsNeighborsPairingsIndices),
+    pairingsValues(initialFunction->pairingsValues),
     initialValues(initialFunction->getValues()),
-    outputFunction(initialFunction->cloneCopyConstruct())
+    outputFunction(initialFunction->cloneCopyConstruct()),
+    ownedThreadPool(sharedThreadPool ? nullptr : new ThreadPool(ThreadPool::defaultNbThreads())),
+    threadPool(sharedThreadPool ? *sharedThreadPool : *ownedThreadPool)
 {
     constantStep=0.04;
+    lastStep=0.0;
     newEnergy=0.0;
+    nbAllocationsLastIteration=0;
+    newtonMaxCGIterations=500;
+    andersonMemory=5;
+    andersonNbStored=0;
+    andersonNewest=0;
+    isAndersonStepAccelerated=false;
+    andersonResidualNorm=0.0;
+    overRelaxationFactor=0.0;
+    gaussSeidelFactor=1.0;
+    gaussSeidelFactorMax=1.95;
+    gaussSeidelNbSweeps=0;
+    gaussSeidelWindowDisplacement=0.0;
+    gaussSeidelWindowFactor=1.0;
+
+    uint nbBoundaryNeighbors = boundaryPointsNeighborsPairingsIndices.size();
+    pairingsUx.resize(nbBoundaryNeighbors);
+    pairingsUy.resize(nbBoundaryNeighbors);
+    pairingsAx.resize(nbBoundaryNeighbors);
+    pairingsAy.resize(nbBoundaryNeighbors);
+    refreshPairingsCoordinates();
+
+    pointsX.resize(nbPoints);
+    pointsY.resize(nbPoints);
+    vectorsX.resize(nbPoints);
+    vectorsY.resize(nbPoints);
+    neighborsX.resize(neighborsIndices.size());
+    neighborsY.resize(neighborsIndices.size());
+    neighborsDistances.resize(neighborsIndices.size());
+
+    lineSearchDirections.resize(nbPoints);
+    lineSearchVectors.resize(nbPoints);
+    lineSearchGradient.resize(nbPoints);
+    lineSearchPoints.resize(nbPoints);
+    lineSearchRoots.resize(nbPoints);
+    lineSearchNeighborsKicked.resize(neighborsIndices.size());
+
+    hessianDirectionsX.resize(neighborsIndices.size());
+    hessianDirectionsY.resize(neighborsIndices.size());
+    hessianPushForwards.resize(neighborsIndices.size());
+    hessianCoshCoefficients.resize(neighborsIndices.size());
+    hessianSinhCoefficients.resize(neighborsIndices.size());
+    metricFactors.resize(nbPoints);
+    hessianDiagonals1.resize(nbPoints);
+    hessianDiagonalsI.resize(nbPoints);
+    newtonGradient.resize(nbPoints);
+    newtonStep.resize(nbPoints);
+    newtonStepVectors.resize(nbPoints);
+    cgResidual.resize(nbPoints);
+    cgPreconditionedResidual.resize(nbPoints);
+    cgDirection.resize(nbPoints);
+    cgHessianDirection.resize(nbPoints);
+
+    initializePartnersPairings();
+    initializeColoring();
+
+    liftsWeights.assign(nbPoints, 1.0);
+    for (uint i=0; i!=nbBoundaryPoints; ++i)
+    {
+        liftsWeights[i] = 1.0/(1 + topology->boundaryPointsPartnersIndices[i].size());
+    }
+
     reset();
 }
 
@@ -25,19 +95,310 @@ void DiscreteFlowIterator<Point, Map>::reset()
 {
 
     newValues = initialValues;
+    oldValues = initialValues;
     errors.resize(nbPoints);
+    gradientNormsSquared.resize(nbPoints);
     gradient.resize(this->nbPoints);
-    neighborsValuesKicked.resize(nbPoints);
-    uint i=0;
+    neighborsValuesKicked.resize(neighborsIndices.size());
+    refreshNeighborsValuesKicked();
+    andersonNbStored = 0;
+    gaussSeidelNbSweeps = 0;
+}
 
-    while (i != nbPoints)
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::setValues(const std::vector<Point> &values)
+{
+    if (values.size() != nbPoints)
     {
-        neighborsValuesKicked[i].resize(neighborsIndices[i].size());
-        ++i;
+        throw(QString("Error in DiscreteFlowIterator<Point, Map>::setValues: wrong number of values"));
     }
+    newValues = values;
+    oldValues = values;
     refreshNeighborsValuesKicked();
+    andersonNbStored = 0;
+    gaussSeidelNbSweeps = 0;
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::setRepresentation(const GroupRepresentation<Map> &rho)
+{
+    // The topology is kept, only the pairings change
+    outputFunction->setRepresentation(rho);
+    pairingsValues = outputFunction->pairingsValues;
+    refreshPairingsCoordinates();
+    refreshPartnersValues();
+    oldValues = newValues;
+    refreshNeighborsValuesKicked();
+    andersonNbStored = 0;
+    gaussSeidelNbSweeps = 0;
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::initializePartnersPairings()
+{
+    // The lifts of a point of the surface are related by pairings: lift j is the image of the lift r of smallest index by some g.
+    // If a neighbor is kicked by a in the star of r and by b in the star of j, then g = b*a^{-1}. A neighbor can appear several times
+    // in a star on coarse meshes, so the candidates are checked on the initial values, which are equivariant.
+    partnersRepresentatives.resize(nbBoundaryPoints);
+    partnersPairingsLeft.resize(nbBoundaryPoints);
+    partnersPairingsRight.resize(nbBoundaryPoints);
+    partnersPushForwards.assign(nbBoundaryPoints, Complex(1.0, 0.0));
+    arePartnersPairingsComplete = true;
+
+    uint r;
+    bool found;
+    for (uint j=0; j!=nbBoundaryPoints; ++j)
+    {
+        r = j;
+        for (auto partnerIndex : topology->boundaryPointsPartnersIndices[j])
+        {
+            r = std::min(r, partnerIndex);
+        }
+        partnersRepresentatives[j] = r;
+        if (r == j)
+        {
+            continue;
+        }
+
+        found = false;
+        for (uint k=neighborsOffsets[r]; k!=neighborsOffsets[r+1] && !found; ++k)
+        {
+            for (uint l=neighborsOffsets[j]; l!=neighborsOffsets[j+1] && !found; ++l)
+            {
+                if (neighborsIndices[l] == neighborsIndices[k])
+                {
+                    found = Point::distance((pairingsValues[boundaryPointsNeighborsPairingsIndices[l]]*
+                                             pairingsValues[boundaryPointsNeighborsPairingsIndices[k]].inverse())*initialValues[r],
+                                            initialValues[j]) < 0.000001;
+                    partnersPairingsLeft[j] = l;
+                    partnersPairingsRight[j] = k;
+                }
+            }
+        }
+        if (!found)
+        {
+            partnersRepresentatives[j] = j;
+            arePartnersPairingsComplete = false;
+        }
+    }
+
+    partnersWeights.assign(nbBoundaryPoints, 0.0);
+    for (uint j=0; j!=nbBoundaryPoints; ++j)
+    {
+        partnersWeights[partnersRepresentatives[j]] += 1.0;
+    }
+    for (uint j=0; j!=nbBoundaryPoints; ++j)
+    {
+        if (partnersWeights[j] != 0.0)
+        {
+            partnersWeights[j] = 1.0/partnersWeights[j];
+        }
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::initializeColoring()
+{
+    // Greedy coloring of the graph of the surface, where the lifts of a point are identified with their representative
+    std::vector<uint> representatives(nbPoints);
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        representatives[i] = (i < nbBoundaryPoints) ? partnersRepresentatives[i] : i;
+    }
+    std::vector< std::vector<uint> > adjacentPoints(nbPoints);
+    uint r, s;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        r = representatives[i];
+        for (uint k=neighborsOffsets[i]; k!=neighborsOffsets[i+1]; ++k)
+        {
+            s = representatives[neighborsIndices[k]];
+            if (s != r)
+            {
+                adjacentPoints[r].push_back(s);
+                adjacentPoints[s].push_back(r);
+            }
+        }
+    }
 
+    const uint noColor = nbPoints;
+    pointsColors.assign(nbPoints, noColor);
+    std::vector<bool> isColorUsed;
+    uint nbColors = 0, color;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        if (representatives[i] != i)
+        {
+            continue;
+        }
+        isColorUsed.assign(nbColors + 1, false);
+        for (auto j : adjacentPoints[i])
+        {
+            if (pointsColors[j] != noColor)
+            {
+                isColorUsed[pointsColors[j]] = true;
+            }
+        }
+        color = 0;
+        while (isColorUsed[color])
+        {
+            ++color;
+        }
+        pointsColors[i] = color;
+        nbColors = std::max(nbColors, color + 1);
+    }
 
+    colorsOffsets.assign(nbColors + 1, 0);
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        pointsColors[i] = pointsColors[representatives[i]];
+        ++colorsOffsets[pointsColors[i] + 1];
+    }
+    for (color=0; color!=nbColors; ++color)
+    {
+        colorsOffsets[color + 1] += colorsOffsets[color];
+    }
+    colorsPoints.resize(nbPoints);
+    std::vector<uint> positions(colorsOffsets.begin(), colorsOffsets.end() - 1);
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        colorsPoints[positions[pointsColors[i]]++] = i;
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::refreshPartnersValues()
+{
+    if (!arePartnersPairingsComplete)
+    {
+        throw(QString("Error in DiscreteFlowIterator<Point, Map>::refreshPartnersValues: pairings between partner points not found"));
+    }
+
+    uint r;
+    for (uint j=0; j!=nbBoundaryPoints; ++j)
+    {
+        r = partnersRepresentatives[j];
+        if (r != j)
+        {
+            newValues[j] = (pairingsValues[boundaryPointsNeighborsPairingsIndices[partnersPairingsLeft[j]]]*
+                            pairingsValues[boundaryPointsNeighborsPairingsIndices[partnersPairingsRight[j]]].inverse())*newValues[r];
+        }
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::refreshPartnersPushForwards()
+{
+    Complex u, a, den;
+    uint r;
+    for (uint j=0; j!=nbBoundaryPoints; ++j)
+    {
+        r = partnersRepresentatives[j];
+        if (r != j)
+        {
+            (pairingsValues[boundaryPointsNeighborsPairingsIndices[partnersPairingsLeft[j]]]*
+             pairingsValues[boundaryPointsNeighborsPairingsIndices[partnersPairingsRight[j]]].inverse()).getDiskCoordinates(u, a);
+            den = 1.0 - conj(a)*oldValues[r].getDiskCoordinate();
+            partnersPushForwards[j] = u*(1.0 - norm(a))/(den*den);
+        }
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::projectOnPartnersVectors(std::vector<Complex> &U) const
+{
+    // Orthogonal projection for scalProd on the vector fields at oldValues that are equivariant under the partners pairings:
+    // the vectors of the lifts of a point are pulled back to its representative, averaged there, and pushed forward again
+    uint r, j;
+    for (j=0; j!=nbBoundaryPoints; ++j)
+    {
+        r = partnersRepresentatives[j];
+        if (r != j)
+        {
+            U[r] += U[j]/partnersPushForwards[j];
+        }
+    }
+    for (j=0; j!=nbBoundaryPoints; ++j)
+    {
+        r = partnersRepresentatives[j];
+        if (r == j)
+        {
+            U[j] *= partnersWeights[j];
+        }
+    }
+    for (j=0; j!=nbBoundaryPoints; ++j)
+    {
+        r = partnersRepresentatives[j];
+        if (r != j)
+        {
+            U[j] = partnersPushForwards[j]*U[r];
+        }
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::refreshPairingsCoordinates()
+{
+    // The coordinates are computed once per distinct pairing, then copied for each neighbor of a boundary point,
+    // so that the kicks in refreshNeighborsValuesKicked are computed on contiguous arrays
+    std::vector<Complex> us(pairingsValues.size()), as(pairingsValues.size());
+    for (uint p=0; p!=pairingsValues.size(); ++p)
+    {
+        pairingsValues[p].getDiskCoordinates(us[p], as[p]);
+    }
+    uint p;
+    for (uint k=0; k!=boundaryPointsNeighborsPairingsIndices.size(); ++k)
+    {
+        p = boundaryPointsNeighborsPairingsIndices[k];
+        pairingsUx[k] = real(us[p]);
+        pairingsUy[k] = imag(us[p]);
+        pairingsAx[k] = real(as[p]);
+        pairingsAy[k] = imag(as[p]);
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::setNbThreads(uint nbThreads)
+{
+    threadPool.setNbThreads(nbThreads);
+}
+
+template <typename Point, typename Map>
+uint DiscreteFlowIterator<Point, Map>::getNbThreads() const
+{
+    return threadPool.getNbThreads();
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::setAndersonMemory(uint andersonMemory)
+{
+    if (andersonMemory == 0)
+    {
+        throw(QString("Error in DiscreteFlowIterator<Point, Map>::setAndersonMemory: the memory must be positive"));
+    }
+    // The buffers are allocated by the next iteration of the accelerated flow
+    this->andersonMemory = andersonMemory;
+    andersonResiduals.clear();
+    andersonSteps.clear();
+    andersonNbStored = 0;
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::setOverRelaxationFactor(double overRelaxationFactor)
+{
+    if (overRelaxationFactor != 0.0 && (overRelaxationFactor < 1.0 || overRelaxationFactor >= 2.0))
+    {
+        throw(QString("Error in DiscreteFlowIterator<Point, Map>::setOverRelaxationFactor: the factor must be in [1, 2), or 0 for the automatic estimate"));
+    }
+    this->overRelaxationFactor = overRelaxationFactor;
+    gaussSeidelNbSweeps = 0;
+}
+
+template <typename Point, typename Map>
+unsigned long long DiscreteFlowIterator<Point, Map>::getNbAllocationsLastIteration() const
+{
+    // Always 0 unless compiled with HARMONY_COUNT_ALLOCATIONS
+    return nbAllocationsLastIteration;
 }
 
 template <typename Point, typename Map>
@@ -50,41 +411,92 @@ void DiscreteFlowIterator<Point, Map>::getOutputFunction(LiftedGraphFunction<Poi
 template <typename Point, typename Map>
 double DiscreteFlowIterator<Point, Map>::updateSupDelta()
 {
-    for (uint i=0; i!=nbPoints; ++i)
+    PROFILE_SCOPE("DiscreteFlowIterator::updateSupDelta");
+    auto updateErrors = [&](uint begin, uint end)
     {
-        errors[i] = Point::distance(oldValues[i], newValues[i]);
-    }
+        for (uint i=begin; i!=end; ++i)
+        {
+            errors[i] = Point::distance(oldValues[i], newValues[i]);
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, updateErrors);
 
     supDelta = *std::max_element(errors.begin(), errors.end());
     return supDelta;
 }
 
+template <typename Point, typename Map>
+double DiscreteFlowIterator<Point, Map>::computeGradientNorm()
+{
+    // Norm of the gradient of the energy at newValues, each point of the surface counted once
+    auto computeChunk = [&](uint begin, uint end)
+    {
+        H2TangentVector v;
+        for (uint i=begin; i!=end; ++i)
+        {
+            uint k = neighborsOffsets[i];
+            newValues[i].weightedLogSum(neighborsValuesKicked.data() + k, neighborsWeightsEnergy.data() + k, neighborsOffsets[i + 1] - k, v);
+            gradientNormsSquared[i] = liftsWeights[i]*v.lengthSquared();
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, computeChunk);
+
+    double out = 0.0;
+    for (auto x : gradientNormsSquared)
+    {
+        out += x;
+    }
+    // weightedLogSum gives half the gradient
+    return 2.0*sqrt(out);
+}
+
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::iterate(int flowChoice)
 {
+    PROFILE_SCOPE("DiscreteFlowIterator::iterate");
+    unsigned long long nbAllocationsBefore = AllocationCounter::getNbAllocations();
+    if (flowChoice != FLOW_CENTROID_ANDERSON)
+    {
+        andersonNbStored = 0;
+    }
+
     switch(flowChoice)
     {
-    case OutputMenu::FLOW_CHOICE:
+    case FLOW_CHOICE:
         std::cout << "WARNING: Began flow without choosing method." << std::endl;
         break;
 
-    case OutputMenu::FLOW_CENTROID:
+    case FLOW_CENTROID:
         updateValuesCentroid();
         break;
 
-    case OutputMenu::FLOW_ENERGY_CONSTANT_STEP:
+    case FLOW_ENERGY_CONSTANT_STEP:
         updateValuesEnergyConstantStep();
         break;
 
-    case OutputMenu::FLOW_ENERGY_OPTIMAL_STEP:
+    case FLOW_ENERGY_OPTIMAL_STEP:
         updateValuesEnergyOptimalStep();
         break;
 
+    case FLOW_ENERGY_NEWTON:
+        updateValuesEnergyNewton();
+        break;
+
+    case FLOW_CENTROID_ANDERSON:
+        updateValuesCentroidAnderson();
+        break;
+
+    case FLOW_CENTROID_GAUSS_SEIDEL:
+        updateValuesCentroidGaussSeidel();
+        break;
+
     default:
         throw(QString("Error in DiscreteFlowIterator: No legal flowChoice made."));
         break;
     }
 //    updateEnergy();
+
+    nbAllocationsLastIteration = AllocationCounter::getNbAllocations() - nbAllocationsBefore;
 }
 
 
@@ -107,27 +519,40 @@ void DiscreteFlowIterator<Point, Map>::refreshOutput()
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::refreshNeighborsValuesKicked()
 {
-    uint i=0, j;
-    while(i != nbBoundaryPoints)
+    refreshNeighborsValuesKicked(newValues, neighborsValuesKicked);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::refreshNeighborsValuesKicked(const std::vector<Point> &values, std::vector<Point> &neighborsValuesKickedOut)
+{
+    PROFILE_SCOPE("DiscreteFlowIterator::refreshNeighborsValuesKicked");
+    auto refreshChunk = [&](uint begin, uint end)
     {
-        j=0;
-        for (auto neighborIndex : neighborsIndices[i])
+        uint k = neighborsOffsets[begin];
+        uint kBoundaryEnd = neighborsOffsets[std::max(begin, std::min(end, nbBoundaryPoints))];
+        uint kEnd = neighborsOffsets[end];
+        if (k != kBoundaryEnd)
         {
-            neighborsValuesKicked[i][j] = boundaryPointsNeighborsPairingsValues[i][j]*newValues[neighborIndex];
-            ++j;
+            Complex z;
+            for (uint l=k; l!=kBoundaryEnd; ++l)
+            {
+                z = values[neighborsIndices[l]].getDiskCoordinate();
+                neighborsX[l] = real(z);
+                neighborsY[l] = imag(z);
+            }
+            double *x = neighborsX.data() + k, *y = neighborsY.data() + k;
+            H2Batch::isometryImages(kBoundaryEnd - k, pairingsUx.data() + k, pairingsUy.data() + k, pairingsAx.data() + k, pairingsAy.data() + k,
+                                    x, y, x, y);
+            H2Batch::store(x, y, kBoundaryEnd - k, neighborsValuesKickedOut.data() + k);
+            k = kBoundaryEnd;
         }
-        ++i;
-    }
-    while (i != nbPoints)
-    {
-        j=0;
-        for (auto neighborIndex : neighborsIndices[i])
+        while (k != kEnd)
         {
-            neighborsValuesKicked[i][j] = newValues[neighborIndex];
-            ++j;
+            neighborsValuesKickedOut[k] = values[neighborsIndices[k]];
+            ++k;
         }
-        ++i;
-    }
+    };
+    threadPool.parallelFor(0, nbPoints, refreshChunk);
 }
 
 
@@ -136,48 +561,369 @@ void DiscreteFlowIterator<Point, Map>::refreshNeighborsValuesKicked()
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::updateValuesCentroid()
 {
-    this->oldValues = this->newValues;
+    PROFILE_SCOPE("DiscreteFlowIterator::updateValuesCentroid");
+    std::swap(this->oldValues, this->newValues);
 
-    for (uint i=0; i!=this->nbPoints; ++i)
+    auto updateChunk = [&](uint begin, uint end)
     {
-        this->newValues[i] = H2Point::centroid(this->neighborsValuesKicked[i], this->neighborsWeightsCentroid[i]);
-    }
+        for (uint i=begin; i!=end; ++i)
+        {
+            uint k = neighborsOffsets[i];
+            this->newValues[i] = H2Point::centroid(neighborsValuesKicked.data() + k, neighborsWeightsCentroid.data() + k, neighborsOffsets[i + 1] - k);
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, updateChunk);
+    lastStep = 1.0;
 
     this->refreshNeighborsValuesKicked();
 }
 
 
+// Disk coordinate of the logarithm of y at x, as in H2TangentVector(x, y), with the distance 2 atanh|w| computed from the image w of y
+// by the isometry sending x to 0: for close points, acosh(1 + s) would give the distance up to sqrt(2 DBL_EPSILON) only
+static Complex logarithm(const Complex &x, const Complex &y)
+{
+    Complex numerator = y - x, denominator = 1.0 - conj(x)*y;
+    double r = sqrt(norm(numerator)/norm(denominator));
+    return (r == 0.0) ? Complex(0.0, 0.0) : ((atanh(r)/(r*norm(denominator)))*(1.0 - norm(x)))*(numerator*conj(denominator));
+}
 
+// Solves A x = b for a symmetric positive definite n x n matrix A (row major) by Cholesky factorization, in place:
+// A is overwritten by its factor and b by x. Returns false if A is not numerically positive definite.
+static bool solveSymmetricSystem(std::vector<double> &A, std::vector<double> &b, uint n)
+{
+    uint i, j, k;
+    double sum;
+    for (j=0; j!=n; ++j)
+    {
+        sum = A[j*n + j];
+        for (k=0; k!=j; ++k)
+        {
+            sum -= A[j*n + k]*A[j*n + k];
+        }
+        if (!(sum > 0.0))
+        {
+            return false;
+        }
+        A[j*n + j] = sqrt(sum);
+        for (i=j+1; i!=n; ++i)
+        {
+            sum = A[i*n + j];
+            for (k=0; k!=j; ++k)
+            {
+                sum -= A[i*n + k]*A[j*n + k];
+            }
+            A[i*n + j] = sum/A[j*n + j];
+        }
+    }
+    for (i=0; i!=n; ++i)
+    {
+        sum = b[i];
+        for (k=0; k!=i; ++k)
+        {
+            sum -= A[i*n + k]*b[k];
+        }
+        b[i] = sum/A[i*n + i];
+    }
+    for (i=n; i!=0; --i)
+    {
+        sum = b[i - 1];
+        for (k=i; k!=n; ++k)
+        {
+            sum -= A[k*n + i - 1]*b[k];
+        }
+        b[i - 1] = sum/A[(i - 1)*n + i - 1];
+    }
+    return true;
+}
 
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::updateValuesCentroidAnderson()
+{
+    PROFILE_SCOPE("DiscreteFlowIterator::updateValuesCentroidAnderson");
+    // Anderson acceleration of the fixed point iteration x <- g(x), where g is the centroid step. The coefficients c minimize
+    // |F_k - sum_j c_j (F_{j+1} - F_j)| for the metric at the current iterate x_k, and the next iterate is exp(F_k - sum_j c_j (S_j + F_{j+1} - F_j)) at x_k.
+    // The weights of the centroids are not symmetric, so that the energy is not monotone along the centroid flow: an accelerated step
+    // is instead checked at the next iteration by the norm of the residual. If it increased, the accelerated step is replaced
+    // by the plain centroid step and the previous iterates are forgotten.
+    uint nbSlots = andersonMemory + 1;
+    if (andersonResiduals.size() != nbSlots)
+    {
+        andersonResiduals.assign(nbSlots, std::vector<Complex>(nbPoints));
+        andersonSteps.assign(nbSlots, std::vector<Complex>(nbPoints));
+        andersonCentroids.resize(nbPoints);
+        andersonPreviousCentroids.resize(nbPoints);
+        andersonSlots.resize(nbSlots);
+        andersonWeights.resize(nbPoints);
+        andersonMatrix.resize(andersonMemory*andersonMemory);
+        andersonCoefficients.resize(andersonMemory);
+        andersonNbStored = 0;
+    }
 
+    bool isLastStepChecked = (andersonNbStored != 0 && isAndersonStepAccelerated);
+    std::swap(this->oldValues, this->newValues);
+    std::swap(andersonCentroids, andersonPreviousCentroids);
+    uint previous = andersonNewest;
+    andersonNewest = (andersonNewest + 1) % nbSlots;
+    andersonNbStored = std::min(andersonNbStored + 1, nbSlots);
+    std::vector<Complex> &residual = andersonResiduals[andersonNewest], &step = andersonSteps[andersonNewest];
+    std::vector<Complex> &residualDifference = andersonResiduals[previous];
 
+    auto updateChunk = [&](uint begin, uint end)
+    {
+        double s;
+        for (uint i=begin; i!=end; ++i)
+        {
+            uint k = neighborsOffsets[i];
+            andersonCentroids[i] = H2Point::centroid(neighborsValuesKicked.data() + k, neighborsWeightsCentroid.data() + k, neighborsOffsets[i + 1] - k);
+            residual[i] = logarithm(oldValues[i].getDiskCoordinate(), andersonCentroids[i].getDiskCoordinate());
+            s = 1.0 - norm(oldValues[i].getDiskCoordinate());
+            andersonWeights[i] = liftsWeights[i]*4.0/(s*s);
+            if (andersonNbStored > 1)
+            {
+                residualDifference[i] = residual[i] - residualDifference[i];
+            }
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, updateChunk);
+    lastStep = 1.0;
 
-/*
-template <typename Map, typename Point>
-DiscreteHeatFlowIteratorRecursiveDepth<Point, Map>::DiscreteHeatFlowIteratorRecursiveDepth(const GroupRepresentation<Map> &rhoDomain, const GroupRepresentation<Map> &rhoImage, uint depth) :
-    rhoDomain(rhoDomain), rhoImage(rhoImage), depth(depth)
-{
+    uint i, j;
+    double residualNorm = 0.0;
+    for (i=0; i!=nbPoints; ++i)
+    {
+        residualNorm += andersonWeights[i]*norm(residual[i]);
+    }
+    residualNorm = sqrt(residualNorm);
+    if (isLastStepChecked && residualNorm > andersonResidualNorm)
+    {
+        this->newValues = andersonPreviousCentroids;
+        andersonNbStored = 0;
+        this->refreshNeighborsValuesKicked();
+        PROFILE_COUNTER("Anderson memory", 0);
+        return;
+    }
+    andersonResidualNorm = residualNorm;
+
+    uint nbDifferences = andersonNbStored - 1;
+    for (j=0; j!=nbDifferences; ++j)
+    {
+        andersonSlots[j] = (andersonNewest + nbSlots - nbDifferences + j) % nbSlots;
+    }
+
+    isAndersonStepAccelerated = false;
+    if (nbDifferences != 0)
+    {
+        // Normal equations of the least squares problem, with a small Tikhonov regularization
+        uint a, b;
+        Complex weightedDifference;
+        std::fill(andersonMatrix.begin(), andersonMatrix.begin() + nbDifferences*nbDifferences, 0.0);
+        std::fill(andersonCoefficients.begin(), andersonCoefficients.begin() + nbDifferences, 0.0);
+        for (i=0; i!=nbPoints; ++i)
+        {
+            for (a=0; a!=nbDifferences; ++a)
+            {
+                weightedDifference = andersonWeights[i]*andersonResiduals[andersonSlots[a]][i];
+                andersonCoefficients[a] += real(weightedDifference*conj(residual[i]));
+                for (b=0; b<=a; ++b)
+                {
+                    andersonMatrix[a*nbDifferences + b] += real(weightedDifference*conj(andersonResiduals[andersonSlots[b]][i]));
+                }
+            }
+        }
+        double trace = 0.0;
+        for (a=0; a!=nbDifferences; ++a)
+        {
+            for (b=0; b!=a; ++b)
+            {
+                andersonMatrix[b*nbDifferences + a] = andersonMatrix[a*nbDifferences + b];
+            }
+            trace += andersonMatrix[a*nbDifferences + a];
+        }
+        for (a=0; a!=nbDifferences; ++a)
+        {
+            andersonMatrix[a*nbDifferences + a] += 1e-10*trace;
+        }
+        isAndersonStepAccelerated = (trace > 0.0 && solveSymmetricSystem(andersonMatrix, andersonCoefficients, nbDifferences));
+    }
+
+    if (isAndersonStepAccelerated)
+    {
+        auto stepChunk = [&](uint begin, uint end)
+        {
+            Complex v, z;
+            uint j, t;
+            for (uint i=begin; i!=end; ++i)
+            {
+                v = residual[i];
+                for (j=0; j!=nbDifferences; ++j)
+                {
+                    t = andersonSlots[j];
+                    v -= andersonCoefficients[j]*(andersonSteps[t][i] + andersonResiduals[t][i]);
+                }
+                step[i] = v;
+                z = oldValues[i].getDiskCoordinate();
+                pointsX[i] = real(z);
+                pointsY[i] = imag(z);
+                vectorsX[i] = real(v);
+                vectorsY[i] = imag(v);
+            }
+            double *x = pointsX.data() + begin, *y = pointsY.data() + begin;
+            H2Batch::exponentiate(1.0, end - begin, x, y, vectorsX.data() + begin, vectorsY.data() + begin, x, y);
+            H2Batch::store(x, y, end - begin, this->newValues.data() + begin);
+            // The exponential of a zero vector is not defined by H2Batch::exponentiate
+            for (uint i=begin; i!=end; ++i)
+            {
+                if (step[i] == Complex(0.0, 0.0))
+                {
+                    this->newValues[i] = oldValues[i];
+                }
+            }
+        };
+        threadPool.parallelFor(0, nbPoints, stepChunk);
+    }
+    else
+    {
+        this->newValues = andersonCentroids;
+        step = residual;
+        andersonNbStored = 1;
+    }
+    this->refreshNeighborsValuesKicked();
+    PROFILE_COUNTER("Anderson memory", isAndersonStepAccelerated ? nbDifferences : 0);
 }
 
-template <typename Map, typename Point>
-bool DiscreteHeatFlowIteratorRecursiveDepth<Point, Map>::run()
+// Point at parameter omega on the geodesic from x to y, with the distance computed as in logarithm(x, y).
+// The divisions are written with real denominators, which avoids the slow path of the complex division.
+static Complex geodesicPoint(const Complex &x, const Complex &y, double omega)
 {
-    return (!stop);
-}*/
+    Complex numerator = y - x, denominator = 1.0 - conj(x)*y;
+    double r = sqrt(norm(numerator)/norm(denominator));
+    if (r == 0.0)
+    {
+        return x;
+    }
+    Complex w = (tanh(omega*atanh(r))/(r*norm(denominator)))*(numerator*conj(denominator));
+    denominator = 1.0 + conj(x)*w;
+    return (1.0/norm(denominator))*((w + x)*conj(denominator));
+}
 
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::updateValuesCentroidGaussSeidel()
+{
+    PROFILE_SCOPE("DiscreteFlowIterator::updateValuesCentroidGaussSeidel");
+    // Nonlinear SOR for the fixed point of the centroid step: the colors are updated in turn, each point moving by gaussSeidelFactor
+    // times the geodesic from its value to the centroid of the current values of its neighbors. The neighbors of a point have other
+    // colors, so that the points of a color are updated in parallel.
+    // The automatic factor starts at 1 and is raised every nbRateSweeps sweeps as for linear consistently ordered systems: if the
+    // displacements decay at the rate lambda with the factor omega, the Jacobi iteration has the spectral radius mu with
+    // (lambda + omega - 1)^2 = lambda omega^2 mu^2, and the optimal factor is 2/(1 + sqrt(1 - mu^2)). A rate below omega - 1 means
+    // that omega is already above the optimal factor. When the displacements increase over nbRateSweeps sweeps, the factor
+    // is halved towards 1 and its later values are bounded by 0.9 times the factor that failed, again towards 1.
+    const uint nbRateSweeps = 10;
+    if (overRelaxationFactor != 0.0)
+    {
+        gaussSeidelFactor = overRelaxationFactor;
+    }
+    else if (gaussSeidelNbSweeps == 0)
+    {
+        gaussSeidelFactor = 1.0;
+        gaussSeidelFactorMax = 1.95;
+        gaussSeidelWindowFactor = 1.0;
+    }
 
+    std::copy(this->newValues.begin(), this->newValues.end(), this->oldValues.begin());
+    for (uint c=0; c + 1!=colorsOffsets.size(); ++c)
+    {
+        auto updateChunk = [&](uint begin, uint end)
+        {
+            uint i, k, kEnd, l;
+            Complex z;
+            for (uint j=begin; j!=end; ++j)
+            {
+                i = colorsPoints[j];
+                k = neighborsOffsets[i];
+                kEnd = neighborsOffsets[i + 1];
+                if (i < nbBoundaryPoints)
+                {
+                    // A neighbor with the same color is another lift of the same point, which may be updated concurrently
+                    for (l=k; l!=kEnd; ++l)
+                    {
+                        z = ((pointsColors[neighborsIndices[l]] == c) ? oldValues : this->newValues)[neighborsIndices[l]].getDiskCoordinate();
+                        neighborsX[l] = real(z);
+                        neighborsY[l] = imag(z);
+                    }
+                    double *x = neighborsX.data() + k, *y = neighborsY.data() + k;
+                    H2Batch::isometryImages(kEnd - k, pairingsUx.data() + k, pairingsUy.data() + k, pairingsAx.data() + k, pairingsAy.data() + k,
+                                            x, y, x, y);
+                    H2Batch::store(x, y, kEnd - k, neighborsValuesKicked.data() + k);
+                }
+                else
+                {
+                    for (l=k; l!=kEnd; ++l)
+                    {
+                        neighborsValuesKicked[l] = this->newValues[neighborsIndices[l]];
+                    }
+                }
+                this->newValues[i] = H2Point::centroid(neighborsValuesKicked.data() + k, neighborsWeightsCentroid.data() + k, kEnd - k);
+                if (gaussSeidelFactor != 1.0)
+                {
+                    this->newValues[i].setDiskCoordinate(geodesicPoint(oldValues[i].getDiskCoordinate(), this->newValues[i].getDiskCoordinate(),
+                                                                       gaussSeidelFactor));
+                }
+            }
+        };
+        threadPool.parallelFor(colorsOffsets[c], colorsOffsets[c + 1], updateChunk);
+    }
+    lastStep = gaussSeidelFactor;
 
+    double displacement = 0.0;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        displacement += liftsWeights[i]*norm(this->newValues[i].getDiskCoordinate() - oldValues[i].getDiskCoordinate());
+    }
+    // Approximately the distance to the centroids, so that the displacements with different factors can be compared
+    displacement = sqrt(displacement)/gaussSeidelFactor;
 
+    if (overRelaxationFactor == 0.0 && gaussSeidelNbSweeps % nbRateSweeps == 0)
+    {
+        // The sweeps following a change of the factor are skipped
+        double omega = gaussSeidelFactor;
+        if (gaussSeidelNbSweeps != 0 && gaussSeidelWindowFactor == omega)
+        {
+            double rate = pow(displacement/gaussSeidelWindowDisplacement, 1.0/nbRateSweeps);
+            if (rate >= 1.0)
+            {
+                gaussSeidelFactorMax = std::max(1.0, 1.0 + 0.9*(omega - 1.0));
+                gaussSeidelFactor = 1.0 + 0.5*(omega - 1.0);
+            }
+            else if (rate > omega - 1.0)
+            {
+                double jacobiRateSquared = (rate + omega - 1.0)*(rate + omega - 1.0)/(rate*omega*omega);
+                if (jacobiRateSquared < 1.0)
+                {
+                    gaussSeidelFactor = std::max(omega, std::min(2.0/(1.0 + sqrt(1.0 - jacobiRateSquared)), gaussSeidelFactorMax));
+                }
+            }
+        }
+        gaussSeidelWindowDisplacement = displacement;
+        gaussSeidelWindowFactor = omega;
+    }
+    ++gaussSeidelNbSweeps;
 
+    this->refreshNeighborsValuesKicked();
+    PROFILE_COUNTER("Over-relaxation factor", gaussSeidelFactor);
+}
 
 
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::updateValuesEnergyConstantStep()
 {
-    this->oldValues = this->newValues;
+    PROFILE_SCOPE("DiscreteFlowIterator::updateValuesEnergyConstantStep");
+    std::swap(this->oldValues, this->newValues);
 
     computeGradient();
-    this->newValues = H2TangentVector::exponentiate(-1.0*constantStep,gradient);
+    exponentiate(-1.0*constantStep, gradient, this->newValues);
+    lastStep = constantStep;
     this->refreshNeighborsValuesKicked();
 }
 
@@ -188,12 +934,14 @@ void DiscreteFlowIterator<Point, Map>::updateValuesEnergyConstantStep()
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::updateValuesEnergyOptimalStep()
 {
-    this->oldValues = this->newValues;
+    PROFILE_SCOPE("DiscreteFlowIterator::updateValuesEnergyOptimalStep");
+    std::swap(this->oldValues, this->newValues);
 
     computeGradient();
     lineSearch();
 //    std::cout << "optimalStep = " << optimalStep << std::endl;
-    this->newValues = H2TangentVector::exponentiate(-1.0*optimalStep,gradient);
+    exponentiate(-1.0*optimalStep, gradient, this->newValues);
+    lastStep = optimalStep;
     this->refreshNeighborsValuesKicked();
 }
 
@@ -201,9 +949,12 @@ void DiscreteFlowIterator<Point, Map>::updateValuesEnergyOptimalStep()
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::lineSearch()
 {
-    std::vector<H2Point> yt;
-    std::vector<H2TangentVector> v0 = -1.0*gradient, vt;
-    
+    PROFILE_SCOPE("DiscreteFlowIterator::lineSearch");
+    for (uint j=0; j!=nbPoints; ++j)
+    {
+        lineSearchDirections[j] = -1.0*gradient[j];
+    }
+
     double step = 0.1;
     double dphit,ddphit,t = 0.0;
     double maxError = 0.01, error;
@@ -213,13 +964,13 @@ void DiscreteFlowIterator<Point, Map>::lineSearch()
     do
     {
 
-        yt = H2TangentVector::exponentiate(t,v0);
-        vt = H2TangentVector::parallelTransport(t,v0);
+        parallelTransport(t, lineSearchDirections, lineSearchPoints, lineSearchVectors);
 
-        dphit = H2TangentVector::scalProd(computeEnergyGradient(yt),vt);
+        computeEnergyGradient(lineSearchPoints, lineSearchGradient);
+        dphit = H2TangentVector::scalProd(lineSearchGradient, lineSearchVectors);
 
 
-        ddphit = computeEnergyHessian(vt);
+        ddphit = computeEnergyHessian(lineSearchVectors);
 
 
 
@@ -243,24 +994,44 @@ template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::updateEnergy()
 {
     oldEnergy = newEnergy;
+    newEnergy = computeEnergy(newValues, neighborsValuesKicked);
+    energyError = newEnergy - oldEnergy;
+}
 
-    double out=0.0, weight, d;
-    H2Point Xi, neighbor;
-    for (uint i=0; i!=this->nbPoints; ++i)
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::computeNeighborsDistances(const std::vector<Point> &values, const std::vector<Point> &valuesKicked)
+{
+    auto distancesChunk = [&](uint begin, uint end)
     {
-        Xi = this->newValues[i];
-
-        for (uint j=0; j!=(neighborsValuesKicked[i].size()); ++j)
+        for (uint i=begin; i!=end; ++i)
         {
-            neighbor = this->neighborsValuesKicked[i][j];
-            weight = this->neighborsWeightsEnergy[i][j];
+            H2Batch::distances(values[i], neighborsOffsets[i + 1] - neighborsOffsets[i],
+                               neighborsX.data() + neighborsOffsets[i], neighborsY.data() + neighborsOffsets[i],
+                               neighborsDistances.data() + neighborsOffsets[i]);
+        }
+    };
+    H2Batch::load(valuesKicked.data(), valuesKicked.size(), neighborsX.data(), neighborsY.data());
+    threadPool.parallelFor(0, nbPoints, distancesChunk);
+}
 
-            d = H2Point::distance(Xi,neighbor);
-            out += weight*d*d;
+template <typename Point, typename Map>
+double DiscreteFlowIterator<Point, Map>::computeEnergy(const std::vector<Point> &values, const std::vector<Point> &valuesKicked)
+{
+    PROFILE_SCOPE("DiscreteFlowIterator::computeEnergy");
+    computeNeighborsDistances(values, valuesKicked);
+
+    double out=0.0, sum, d;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        sum = 0.0;
+        for (uint k=neighborsOffsets[i]; k!=neighborsOffsets[i + 1]; ++k)
+        {
+            d = neighborsDistances[k];
+            sum += neighborsWeightsEnergy[k]*d*d;
         }
+        out += liftsWeights[i]*sum;
     }
-    newEnergy = .5*out;
-    energyError = newEnergy - oldEnergy;
+    return .5*out;
 }
 
 
@@ -282,56 +1053,74 @@ double DiscreteFlowIterator<Point, Map>::getEnergyError()
 template <typename Point, typename Map>
 void DiscreteFlowIterator<Point, Map>::computeGradient()
 {
-    H2TangentVector v;
-    for (uint i=0; i!=this->nbPoints; ++i)
+    PROFILE_SCOPE("DiscreteFlowIterator::computeGradient");
+    auto computeChunk = [&](uint begin, uint end)
     {
-        this->oldValues[i].weightedLogSum(this->neighborsValuesKicked[i], this->neighborsWeightsEnergy[i], v);
-        gradient[i]=-1.0*v;
-    }
+        H2TangentVector v;
+        for (uint i=begin; i!=end; ++i)
+        {
+            uint k = neighborsOffsets[i];
+            this->oldValues[i].weightedLogSum(neighborsValuesKicked.data() + k, neighborsWeightsEnergy.data() + k, neighborsOffsets[i + 1] - k, v);
+            gradient[i]=-1.0*v;
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, computeChunk);
 }
 
 template <typename Point, typename Map>
-std::vector<H2TangentVector> DiscreteFlowIterator<Point, Map>::computeEnergyGradient(const std::vector<H2Point> &Y)
+void DiscreteFlowIterator<Point, Map>::exponentiate(double t, const std::vector<H2TangentVector> &V, std::vector<H2Point> &pointsOut)
 {
+    assert(V.size() == nbPoints);
+    pointsOut.resize(nbPoints);
 
-    assert(Y.size() == nbPoints);
-    std::vector<H2TangentVector> out;
-    out.reserve(Y.size());
+    auto exponentiateChunk = [&](uint begin, uint end)
+    {
+        double *x = pointsX.data() + begin, *y = pointsY.data() + begin, *vx = vectorsX.data() + begin, *vy = vectorsY.data() + begin;
+        H2Batch::load(V.data() + begin, end - begin, x, y, vx, vy);
+        H2Batch::exponentiate(t, end - begin, x, y, vx, vy, x, y);
+        H2Batch::store(x, y, end - begin, pointsOut.data() + begin);
+    };
+    threadPool.parallelFor(0, nbPoints, exponentiateChunk);
+}
 
-    std::vector<std::vector<H2Point>> neighborsYKicked = this->neighborsValuesKicked;
-    // Gros porc: we just need neighborsYKicked and neighborsValuesKicked to have the same dimensions
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::parallelTransport(double t, const std::vector<H2TangentVector> &V, std::vector<H2Point> &pointsOut,
+                                                         std::vector<H2TangentVector> &vectorsOut)
+{
+    assert(V.size() == nbPoints);
+    pointsOut.resize(nbPoints);
+    vectorsOut.resize(nbPoints);
 
-    uint i=0, j;
-    while(i != nbBoundaryPoints)
+    auto transportChunk = [&](uint begin, uint end)
     {
-        j=0;
-        for (auto neighborIndex : neighborsIndices[i])
-        {
-            neighborsYKicked[i][j] = boundaryPointsNeighborsPairingsValues[i][j]*Y[neighborIndex];
-            ++j;
-        }
-        ++i;
-    }
-    while (i != nbPoints)
-    {
-        j=0;
-        for (auto neighborIndex : neighborsIndices[i])
-        {
-            neighborsYKicked[i][j] = Y[neighborIndex];
-            ++j;
-        }
-        ++i;
-    }
+        double *x = pointsX.data() + begin, *y = pointsY.data() + begin, *vx = vectorsX.data() + begin, *vy = vectorsY.data() + begin;
+        H2Batch::load(V.data() + begin, end - begin, x, y, vx, vy);
+        H2Batch::parallelTransport(t, end - begin, x, y, vx, vy, x, y, vx, vy);
+        H2Batch::store(x, y, end - begin, pointsOut.data() + begin);
+        H2Batch::store(x, y, vx, vy, end - begin, vectorsOut.data() + begin);
+    };
+    threadPool.parallelFor(0, nbPoints, transportChunk);
+}
 
-    H2TangentVector v;
-    for (uint i=0; i!=this->nbPoints; ++i)
-    {
-        Y[i].weightedLogSum(neighborsYKicked[i], this->neighborsWeightsEnergy[i], v);
-        out.push_back(-1.0*v);
-    }
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::computeEnergyGradient(const std::vector<H2Point> &Y, std::vector<H2TangentVector> &out)
+{
+    assert(Y.size() == nbPoints);
+    assert(out.size() == nbPoints);
 
-    return out;
+    refreshNeighborsValuesKicked(Y, lineSearchNeighborsKicked);
 
+    auto computeChunk = [&](uint begin, uint end)
+    {
+        H2TangentVector v;
+        for (uint i=begin; i!=end; ++i)
+        {
+            uint k = neighborsOffsets[i];
+            Y[i].weightedLogSum(lineSearchNeighborsKicked.data() + k, neighborsWeightsEnergy.data() + k, neighborsOffsets[i + 1] - k, v);
+            out[i] = -1.0*v;
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, computeChunk);
 }
 
 
@@ -341,56 +1130,29 @@ double DiscreteFlowIterator<Point, Map>::computeEnergyHessian(const std::vector<
 
     assert(V.size() == nbPoints);
 
-    std::vector<H2Point> roots;
-    roots.reserve(nbPoints);
-    for (const auto &v : V)
+    for (uint v=0; v!=nbPoints; ++v)
     {
-        roots.push_back(v.getRoot());
-    }
-
-
-    std::vector<std::vector<H2Point>> neighborsRootsKicked = this->neighborsValuesKicked;
-    // Gros porc: we just need neighborsRootsKicked and neighborsValuesKicked to have the same dimensions
-
-    uint i=0, j;
-    while(i != nbBoundaryPoints)
-    {
-        j=0;
-        for (auto neighborIndex : neighborsIndices[i])
-        {
-            neighborsRootsKicked[i][j] = boundaryPointsNeighborsPairingsValues[i][j]*roots[neighborIndex];
-            ++j;
-        }
-        ++i;
-    }
-    while (i != nbPoints)
-    {
-        j=0;
-        for (auto neighborIndex : neighborsIndices[i])
-        {
-            neighborsRootsKicked[i][j] = roots[neighborIndex];
-            ++j;
-        }
-        ++i;
+        lineSearchRoots[v] = V[v].getRoot();
     }
+    refreshNeighborsValuesKicked(lineSearchRoots, lineSearchNeighborsKicked);
 
     H2Point xv, xw;
     H2TangentVector uv, xvxw;
     double d, D, out = 0;
-    uint v, w;
+    uint v, k;
 
 
     for (v = 0; v!=nbPoints; ++v)
     {
-        xv = roots[v];
+        xv = lineSearchRoots[v];
         uv = V[v];
-        for (w=0; w!= neighborsIndices[v].size(); ++w)
+        for (k=neighborsOffsets[v]; k!=neighborsOffsets[v + 1]; ++k)
         {
-            xw = neighborsRootsKicked[v][w];
+            xw = lineSearchNeighborsKicked[k];
             xvxw = H2TangentVector(xv, xw);
             d = H2Point::distance(xv, xw);
             D = d/tanh(d);
-            out += neighborsWeightsEnergy[v][w]*(D*uv.lengthSquared() + (1-D)*(H2TangentVector::scalProd(uv, xvxw))/(d*d));
+            out += neighborsWeightsEnergy[k]*(D*uv.lengthSquared() + (1-D)*(H2TangentVector::scalProd(uv, xvxw))/(d*d));
         }
     }
 
@@ -398,30 +1160,232 @@ double DiscreteFlowIterator<Point, Map>::computeEnergyHessian(const std::vector<
     return out;
 }
 
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::updateValuesEnergyNewton(DiscreteFlowMultigrid<Point, Map> *multigrid)
+{
+    PROFILE_SCOPE("DiscreteFlowIterator::updateValuesEnergyNewton");
+    // Truncated Newton: the step s solves H s = -g approximately by conjugate gradients,
+    // then x_i is moved to exp(t s_i), with t halved until the energy decreases enough.
+    std::swap(this->oldValues, this->newValues);
+    andersonNbStored = 0;
 
+    computeGradient();
+    refreshHessianCoefficients();
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        newtonGradient[i] = gradient[i].getVector();
+    }
+    solveNewtonSystem(multigrid);
 
+    // newtonGradient is half the gradient of the energy
+    double slope = 2.0*scalProd(newtonGradient, newtonStep);
+    double energy = computeEnergy(oldValues, neighborsValuesKicked), trialEnergy;
+    double t = 1.0;
+    uint i, maxTrials = 30;
 
+    for (uint trial=0; trial!=maxTrials; ++trial)
+    {
+        for (i=0; i!=nbPoints; ++i)
+        {
+            newtonStepVectors[i] = H2TangentVector(oldValues[i], t*newtonStep[i]);
+        }
+        exponentiate(1.0, newtonStepVectors, this->newValues);
+        if (arePartnersPairingsComplete)
+        {
+            refreshPartnersValues();
+        }
+        this->refreshNeighborsValuesKicked();
+        trialEnergy = computeEnergy(newValues, neighborsValuesKicked);
+        if (trialEnergy <= energy + 1e-4*t*slope)
+        {
+            lastStep = t;
+            return;
+        }
+        t *= 0.5;
+    }
+
+    // No decrease: we are at the minimum up to rounding errors
+    lastStep = 0.0;
+    this->newValues = this->oldValues;
+    this->refreshNeighborsValuesKicked();
+}
 
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::solveNewtonSystem(DiscreteFlowMultigrid<Point, Map> *multigrid)
+{
+    PROFILE_SCOPE("DiscreteFlowIterator::solveNewtonSystem");
+    // Conjugate gradients, preconditioned by a multigrid V-cycle if multigrid is not null
+    uint i;
+    std::fill(newtonStep.begin(), newtonStep.end(), Complex(0.0, 0.0));
+    for (i=0; i!=nbPoints; ++i)
+    {
+        cgResidual[i] = -1.0*newtonGradient[i];
+    }
+    if (multigrid)
+    {
+        // The V-cycle only acts on the equivariant vectors: the rest of the gradient would stall the conjugate gradients
+        projectOnPartnersVectors(cgResidual);
+        multigrid->precondition(cgResidual, cgPreconditionedResidual);
+    }
+    else
+    {
+        cgPreconditionedResidual = cgResidual;
+    }
+    cgDirection = cgPreconditionedResidual;
 
+    double residualNormSquared = scalProd(cgResidual, cgResidual);
+    double residualScalProd = scalProd(cgResidual, cgPreconditionedResidual), newResidualScalProd;
+    double gradientNorm = sqrt(residualNormSquared);
+    double tolerance = std::min(0.5, sqrt(gradientNorm))*gradientNorm;
+    double curvature, alpha, beta;
 
+    uint iteration;
+    for (iteration=0; iteration!=newtonMaxCGIterations && sqrt(residualNormSquared) > tolerance; ++iteration)
+    {
+        multiplyEnergyHessian(cgDirection, cgHessianDirection);
+        curvature = scalProd(cgDirection, cgHessianDirection);
+        if (curvature <= 0.0)
+        {
+            if (iteration == 0)
+            {
+                newtonStep = cgDirection;
+            }
+            break;
+        }
 
+        alpha = residualScalProd/curvature;
+        for (i=0; i!=nbPoints; ++i)
+        {
+            newtonStep[i] += alpha*cgDirection[i];
+            cgResidual[i] -= alpha*cgHessianDirection[i];
+        }
+        residualNormSquared = scalProd(cgResidual, cgResidual);
 
-/*
-template <typename Map, typename Point>
-DiscreteHeatFlowIteratorRecursiveDepth<Point, Map>::DiscreteHeatFlowIteratorRecursiveDepth(const GroupRepresentation<Map> &rhoDomain, const GroupRepresentation<Map> &rhoImage, uint depth) :
-    rhoDomain(rhoDomain), rhoImage(rhoImage), depth(depth)
-{
+        if (multigrid)
+        {
+            multigrid->precondition(cgResidual, cgPreconditionedResidual);
+        }
+        else
+        {
+            cgPreconditionedResidual = cgResidual;
+        }
+        newResidualScalProd = scalProd(cgResidual, cgPreconditionedResidual);
+        beta = newResidualScalProd/residualScalProd;
+        residualScalProd = newResidualScalProd;
+        for (i=0; i!=nbPoints; ++i)
+        {
+            cgDirection[i] = cgPreconditionedResidual[i] + beta*cgDirection[i];
+        }
+    }
+    PROFILE_COUNTER("conjugate gradient iterations", iteration);
 }
 
-template <typename Map, typename Point>
-bool DiscreteHeatFlowIteratorRecursiveDepth<Point, Map>::run()
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::refreshHessianCoefficients()
 {
-    return (!stop);
-}*/
+    const Complex I(0.0, 1.0);
+    auto refreshChunk = [&](uint begin, uint end)
+    {
+        Complex x, y, z, u, a, den, T, diagonal1, diagonalI;
+        double d, s;
+        for (uint i=begin; i!=end; ++i)
+        {
+            x = oldValues[i].getDiskCoordinate();
+            s = 1.0 - norm(x);
+            metricFactors[i] = 4.0/(s*s);
+            diagonal1 = Complex(0.0, 0.0);
+            diagonalI = Complex(0.0, 0.0);
+
+            for (uint k=neighborsOffsets[i]; k!=neighborsOffsets[i + 1]; ++k)
+            {
+                const Point &neighbor = neighborsValuesKicked[k];
+                y = neighbor.getDiskCoordinate();
+                d = Point::distance(oldValues[i], neighbor);
+                s = 1.0 - norm(y);
+                if (d > 0.0)
+                {
+                    hessianDirectionsX[k] = (metricFactors[i]/d)*H2TangentVector(oldValues[i], neighbor).getVector();
+                    hessianDirectionsY[k] = (-4.0/(s*s*d))*H2TangentVector(neighbor, oldValues[i]).getVector();
+                }
+                else
+                {
+                    hessianDirectionsX[k] = Complex(0.0, 0.0);
+                    hessianDirectionsY[k] = Complex(0.0, 0.0);
+                }
+
+                // d coth(d) and d/sinh(d), with their limits at d = 0
+                hessianCoshCoefficients[k] = (d > 1e-8) ? d/tanh(d) : 1.0;
+                hessianSinhCoefficients[k] = (d > 1e-8) ? d/sinh(d) : 1.0;
+
+                if (k < neighborsOffsets[nbBoundaryPoints])
+                {
+                    u = Complex(pairingsUx[k], pairingsUy[k]);
+                    a = Complex(pairingsAx[k], pairingsAy[k]);
+                    z = oldValues[neighborsIndices[k]].getDiskCoordinate();
+                    den = 1.0 - conj(a)*z;
+                    hessianPushForwards[k] = u*(1.0 - norm(a))/(den*den);
+                }
+                else
+                {
+                    hessianPushForwards[k] = Complex(1.0, 0.0);
+                }
+
+                T = hessianDirectionsX[k]/metricFactors[i];
+                diagonal1 += neighborsWeightsEnergy[k]*(real(conj(hessianDirectionsX[k]))*T
+                                                        + hessianCoshCoefficients[k]*real(conj(I*hessianDirectionsX[k]))*(I*T));
+                diagonalI += neighborsWeightsEnergy[k]*(real(I*conj(hessianDirectionsX[k]))*T
+                                                        + hessianCoshCoefficients[k]*real(I*conj(I*hessianDirectionsX[k]))*(I*T));
+            }
+            hessianDiagonals1[i] = diagonal1;
+            hessianDiagonalsI[i] = diagonalI;
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, refreshChunk);
+    refreshPartnersPushForwards();
+}
 
+template <typename Point, typename Map>
+void DiscreteFlowIterator<Point, Map>::multiplyEnergyHessian(const std::vector<Complex> &U, std::vector<Complex> &out)
+{
+    // Each edge contributes w ((a - c) T + (d coth(d) b - d/sinh(d) e) N) at x, where T is the unit tangent at x of the geodesic from x to y,
+    // N = iT, (a, b) are the coordinates of u_x in (T, N), and (c, e) those of the variation of y in the transported frame at y.
+    const Complex I(0.0, 1.0);
+    auto multiplyChunk = [&](uint begin, uint end)
+    {
+        Complex ux, uy, T, res;
+        double a, b, c, e, metricFactorInverse;
+        for (uint i=begin; i!=end; ++i)
+        {
+            ux = U[i];
+            res = Complex(0.0, 0.0);
+            metricFactorInverse = 1.0/metricFactors[i];
+            for (uint k=neighborsOffsets[i]; k!=neighborsOffsets[i + 1]; ++k)
+            {
+                uy = hessianPushForwards[k]*U[neighborsIndices[k]];
+                a = real(ux*conj(hessianDirectionsX[k]));
+                b = real(ux*conj(I*hessianDirectionsX[k]));
+                c = real(uy*conj(hessianDirectionsY[k]));
+                e = real(uy*conj(I*hessianDirectionsY[k]));
+                T = metricFactorInverse*hessianDirectionsX[k];
+                res += neighborsWeightsEnergy[k]*((a - c)*T + (hessianCoshCoefficients[k]*b - hessianSinhCoefficients[k]*e)*(I*T));
+            }
+            out[i] = res;
+        }
+    };
+    threadPool.parallelFor(0, nbPoints, multiplyChunk);
+}
 
+template <typename Point, typename Map>
+double DiscreteFlowIterator<Point, Map>::scalProd(const std::vector<Complex> &U, const std::vector<Complex> &V) const
+{
+    double out = 0.0;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        out += liftsWeights[i]*metricFactors[i]*real(U[i]*conj(V[i]));
+    }
+    return out;
+}
 
 
 template class DiscreteFlowIterator<H2Point, H2Isometry>;
-//template class DiscreteHeatFlowIteratorRecursiveDepth<H2Point, H2Isometry>;
 
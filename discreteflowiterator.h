@@ -3,25 +3,47 @@
 
 #include "tools.h"
 #include "h2tangentvector.h"
+#include "threadpool.h"
+#include "h2batch.h"
 
 template<typename Point, typename Map> class LiftedGraphFunction;
+struct LiftedGraphTopology;
+template<typename Map> class GroupRepresentation;
+template<typename Point, typename Map> class DiscreteFlowMultigrid;
 
 template<typename Point, typename Map>
 class DiscreteFlowIterator
 {
+    friend class DiscreteFlowMultigrid<Point, Map>;
+
 public:
-    DiscreteFlowIterator(const LiftedGraphFunction<Point, Map> *initialFunction);
+    DiscreteFlowIterator(const LiftedGraphFunction<Point, Map> *initialFunction, ThreadPool *sharedThreadPool = nullptr);
 
     void iterate(int flowChoice);
     void iterate(int flowChoice, uint nbIterations);
     void getOutputFunction(LiftedGraphFunction<Point, Map> *outputFunction);
     double updateSupDelta();
+    double computeGradientNorm();
+    double getLastStep() const {return lastStep;}
 
     void updateEnergy();
     double getEnergy() const;
     double getEnergyError();
 
     void reset();
+    void setValues(const std::vector<Point> &values);
+    void setRepresentation(const GroupRepresentation<Map> &rho);
+
+    void setNbThreads(uint nbThreads);
+    uint getNbThreads() const;
+    void setAndersonMemory(uint andersonMemory);
+    uint getAndersonMemory() const {return andersonMemory;}
+    void setOverRelaxationFactor(double overRelaxationFactor);
+    double getOverRelaxationFactor() const {return overRelaxationFactor;}
+    double getCurrentOverRelaxationFactor() const {return gaussSeidelFactor;}
+    uint getNbColors() const {return colorsOffsets.size() - 1;}
+
+    unsigned long long getNbAllocationsLastIteration() const;
 
 //    double lineSearchTest();
 //    void undoIterate();
@@ -29,66 +51,117 @@ public:
 
 
     Point getValue(uint index) const {return newValues.at(index);}
+    uint getNbPoints() const {return nbPoints;}
+    std::vector<Point> getValues() const {return newValues;}
+    void copyValues(std::vector<Point> &valuesOut) const {valuesOut = newValues;}
 
 protected:
+    void refreshPairingsCoordinates();
+    void initializePartnersPairings();
+    void initializeColoring();
+    void refreshPartnersValues();
+    void refreshPartnersPushForwards();
+    void projectOnPartnersVectors(std::vector<Complex> &U) const;
     void refreshNeighborsValuesKicked();
+    void refreshNeighborsValuesKicked(const std::vector<Point> &values, std::vector<Point> &neighborsValuesKickedOut);
     void updateValuesCentroid();
+    void updateValuesCentroidAnderson();
+    void updateValuesCentroidGaussSeidel();
     void refreshOutput();
     void updateValuesEnergyConstantStep();
     void updateValuesEnergyOptimalStep();
+    void updateValuesEnergyNewton(DiscreteFlowMultigrid<Point, Map> *multigrid = nullptr);
     void computeGradient();
-
+    void exponentiate(double t, const std::vector<H2TangentVector> &V, std::vector<H2Point> &pointsOut);
+    void parallelTransport(double t, const std::vector<H2TangentVector> &V, std::vector<H2Point> &pointsOut,
+                           std::vector<H2TangentVector> &vectorsOut);
 
 
     
-    std::vector<H2TangentVector> computeEnergyGradient(const std::vector<H2Point> &Y);
+    void computeEnergyGradient(const std::vector<H2Point> &Y, std::vector<H2TangentVector> &out);
 
     void lineSearch();
 
     double computeEnergyHessian(const std::vector<H2TangentVector> &V);
 
+    void computeNeighborsDistances(const std::vector<Point> &values, const std::vector<Point> &valuesKicked);
+    double computeEnergy(const std::vector<Point> &values, const std::vector<Point> &valuesKicked);
+    void refreshHessianCoefficients();
+    void multiplyEnergyHessian(const std::vector<Complex> &U, std::vector<Complex> &out);
+    double scalProd(const std::vector<Complex> &U, const std::vector<Complex> &V) const;
+    void solveNewtonSystem(DiscreteFlowMultigrid<Point, Map> *multigrid);
+
     std::vector<H2TangentVector> gradient;
-    double constantStep, optimalStep;
+    double constantStep, optimalStep, lastStep;
 
+    // The topology is shared with the initial function: the references below point into it
+    const std::shared_ptr<const LiftedGraphTopology> topology;
     const uint nbBoundaryPoints;
     const uint nbPoints;
-    const std::vector< std::vector<uint> > neighborsIndices;
-    const std::vector< std::vector<double> > neighborsWeightsCentroid,neighborsWeightsEnergy;
-    const std::vector< std::vector<Map> > boundaryPointsNeighborsPairingsValues;
+    const std::vector<uint> &neighborsOffsets, &neighborsIndices;
+    const std::vector<double> &neighborsWeightsCentroid, &neighborsWeightsEnergy;
+    const std::vector<uint> &boundaryPointsNeighborsPairingsIndices;
+    std::vector<Map> pairingsValues;
 
+    // oldValues and newValues are swapped at the beginning of each iteration, which then overwrites newValues.
+    // All the other vectors are workspaces allocated once, so that iterate() does not allocate memory.
     std::vector<Point> initialValues, oldValues, newValues;
-    std::vector< std::vector<Point> > neighborsValuesKicked;
+    std::vector<Point> neighborsValuesKicked;
+
+    // Line search workspaces
+    std::vector<H2TangentVector> lineSearchDirections, lineSearchVectors, lineSearchGradient;
+    std::vector<H2Point> lineSearchPoints, lineSearchRoots, lineSearchNeighborsKicked;
+
+    // Disk coordinates of the pairings, and workspaces for the H2Batch kernels
+    std::vector<double> pairingsUx, pairingsUy, pairingsAx, pairingsAy;
+    std::vector<double> pointsX, pointsY, vectorsX, vectorsY;
+    std::vector<double> neighborsX, neighborsY, neighborsDistances;
+
+    // Newton flow, with tangent vectors stored by their disk coordinate: the Hessian coefficients of each edge k,
+    // and the images of 1 and i by the diagonal block of the Hessian at each point i.
+    uint newtonMaxCGIterations;
+    std::vector<Complex> hessianDirectionsX, hessianDirectionsY, hessianPushForwards;
+    std::vector<Complex> hessianDiagonals1, hessianDiagonalsI;
+    std::vector<double> hessianCoshCoefficients, hessianSinhCoefficients, metricFactors;
+    // A point of the surface with several lifts on the boundary of the fundamental domain is counted once
+    // in computeEnergy and in scalProd: each lift gets the weight 1/(number of lifts).
+    std::vector<double> liftsWeights;
+    std::vector<Complex> newtonGradient, newtonStep, cgResidual, cgPreconditionedResidual, cgDirection, cgHessianDirection;
+    std::vector<H2TangentVector> newtonStepVectors;
+
+    // Boundary point j is the lift partnersRepresentatives[j] moved by P[partnersPairingsLeft[j]]*P[partnersPairingsRight[j]]^{-1},
+    // whose derivative there is partnersPushForwards[j]; partnersWeights[r] is 1/(number of lifts with representative r).
+    std::vector<uint> partnersRepresentatives, partnersPairingsLeft, partnersPairingsRight;
+    std::vector<Complex> partnersPushForwards;
+    std::vector<double> partnersWeights;
+    bool arePartnersPairingsComplete;
+
+    // Anderson acceleration of the centroid flow: circular buffers of the residuals and steps in disk coordinates,
+    // emptied when the values change by other means.
+    uint andersonMemory, andersonNbStored, andersonNewest;
+    bool isAndersonStepAccelerated;
+    double andersonResidualNorm;
+    std::vector< std::vector<Complex> > andersonResiduals, andersonSteps;
+    std::vector<Point> andersonCentroids, andersonPreviousCentroids;
+    std::vector<uint> andersonSlots;
+    std::vector<double> andersonWeights, andersonMatrix, andersonCoefficients;
+
+    // Gauss-Seidel centroid flow: color c holds colorsPoints[colorsOffsets[c]], ..., colorsPoints[colorsOffsets[c+1] - 1].
+    // overRelaxationFactor is the user's factor (0 to estimate it from the sweeps), and gaussSeidelFactor the factor in use.
+    std::vector<uint> colorsOffsets, colorsPoints, pointsColors;
+    double overRelaxationFactor, gaussSeidelFactor, gaussSeidelFactorMax, gaussSeidelWindowDisplacement, gaussSeidelWindowFactor;
+    uint gaussSeidelNbSweeps;
 
     const std::unique_ptr<LiftedGraphFunction<Point, Map> > outputFunction;
 
     double supDelta, oldEnergy, newEnergy, energyError;
-    std::vector<double> errors;
-};
-
-
-
-
-/*template <typename Point, typename Map> class LiftedGraphFunctionTriangulated; template <typename Map> class GroupRepresentation;
-
-template <typename Point, typename Map> class DiscreteHeatFlowIteratorRecursiveDepth
-{
-public:
-    DiscreteHeatFlowIteratorRecursiveDepth(const GroupRepresentation<Map> &rhoDomain, const GroupRepresentation<Map> &rhoImage, uint depth);
-
-    bool run();
-
-private:
-    GroupRepresentation<Map> rhoDomain, rhoImage;
-    uint depth;
-
-    double tol, subTol;
-
-    std::vector< LiftedGraphFunctionTriangulated<Point, Map> > domainFunctions, imageFunctions;
-
-    bool stop;
-};*/
-
+    unsigned long long nbAllocationsLastIteration;
+    std::vector<double> errors, gradientNormsSquared;
 
+    // The pool is owned unless it is shared with the caller, as for the coarse meshes of a multigrid
+    const std::unique_ptr<ThreadPool> ownedThreadPool;
+    ThreadPool &threadPool;
+};
 
 
 #endif // DISCRETEFLOWITERATOR_H
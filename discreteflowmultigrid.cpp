@@ -0,0 +1,351 @@
+#include "discreteflowmultigrid.h"
+#include "liftedgraph.h"
+#include "allocationcounter.h"
+
+template <typename Point, typename Map>
+DiscreteFlowMultigrid<Point, Map>::DiscreteFlowMultigrid(DiscreteFlowIterator<Point, Map> *fineIterator,
+                                                         const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &fineDomainFunction,
+                                                         const GroupRepresentation<H2Isometry> &rhoDomain, const GroupRepresentation<Map> &rhoImage)
+{
+    if (fineIterator->nbPoints != fineDomainFunction.getNbPoints())
+    {
+        throw(QString("Error in DiscreteFlowMultigrid<Point, Map>::DiscreteFlowMultigrid: iterator and domain function do not match"));
+    }
+
+    nbSmoothingSweeps = 2;
+    smoothingDamping = 0.6;
+    nbFullMultigridIterations = 2;
+    nbCoarsestIterations = 200;
+
+    depth = fineDomainFunction.depth;
+    currentLevel = depth;
+    iterators.resize(depth + 1);
+    coarseIterators.resize(depth);
+    coarseIndicesA.resize(depth + 1);
+    coarseIndicesB.resize(depth + 1);
+    fineIndices.resize(depth + 1);
+
+    std::unique_ptr< LiftedGraphFunctionTriangulated<H2Point, H2Isometry> > coarseDomainFunction, domainFunction;
+    for (uint l=0; l!=depth; ++l)
+    {
+        domainFunction.reset(new LiftedGraphFunctionTriangulated<H2Point, H2Isometry>(rhoDomain, l));
+        LiftedGraphFunctionTriangulated<Point, Map> imageFunction(*domainFunction, rhoImage);
+        coarseIterators[l].reset(new DiscreteFlowIterator<Point, Map>(&imageFunction, &fineIterator->threadPool));
+        iterators[l] = coarseIterators[l].get();
+        if (l != 0)
+        {
+            constructTransfers(l, *coarseDomainFunction, *domainFunction);
+        }
+        coarseDomainFunction = std::move(domainFunction);
+    }
+    iterators[depth] = fineIterator;
+    if (depth != 0)
+    {
+        constructTransfers(depth, *coarseDomainFunction, fineDomainFunction);
+    }
+
+    rightHandSides.resize(depth + 1);
+    solutions.resize(depth + 1);
+    residuals.resize(depth + 1);
+    products.resize(depth + 1);
+    for (uint l=0; l<=depth; ++l)
+    {
+        rightHandSides[l].resize(iterators[l]->nbPoints);
+        solutions[l].resize(iterators[l]->nbPoints);
+        residuals[l].resize(iterators[l]->nbPoints);
+        products[l].resize(iterators[l]->nbPoints);
+    }
+    coarsestDirection.resize(iterators[0]->nbPoints);
+    coarsestProduct.resize(iterators[0]->nbPoints);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::constructTransfers(uint level, const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &coarseDomainFunction,
+                                                           const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &fineDomainFunction)
+{
+    if (coarseDomainFunction.topology->triangles.size() != fineDomainFunction.topology->triangles.size() || coarseDomainFunction.depth + 1 != fineDomainFunction.depth)
+    {
+        throw(QString("Error in DiscreteFlowMultigrid<Point, Map>::constructTransfers: meshes are not nested"));
+    }
+
+    // In a subdivision, the point in line n and position p has index n(n+1)/2 + p. It is the midpoint of the points
+    // (n/2, p/2) and ((n+1)/2, (p+1)/2) of the coarser subdivision (rounded down), which are equal when n and p are even.
+    coarseIndicesA[level].resize(fineDomainFunction.getNbPoints());
+    coarseIndicesB[level].resize(fineDomainFunction.getNbPoints());
+    fineIndices[level].resize(coarseDomainFunction.getNbPoints());
+
+    uint nbLines = TriangularSubdivision<H2Point>::nbLines(fineDomainFunction.depth);
+    uint fineIndex, nA, pA, nB, pB, indexA, indexB;
+    for (uint s=0; s!=fineDomainFunction.topology->subdivisionsPointsIndicesInValues.size(); ++s)
+    {
+        const std::vector<uint> &fineSubdivisionIndices = fineDomainFunction.topology->subdivisionsPointsIndicesInValues[s];
+        const std::vector<uint> &coarseSubdivisionIndices = coarseDomainFunction.topology->subdivisionsPointsIndicesInValues[s];
+        for (uint n=0; n!=nbLines; ++n)
+        {
+            for (uint p=0; p<=n; ++p)
+            {
+                fineIndex = fineSubdivisionIndices[(n*(n+1))/2 + p];
+                nA = n/2;
+                pA = p/2;
+                nB = (n+1)/2;
+                pB = (p+1)/2;
+                indexA = coarseSubdivisionIndices[(nA*(nA+1))/2 + pA];
+                indexB = coarseSubdivisionIndices[(nB*(nB+1))/2 + pB];
+
+                coarseIndicesA[level][fineIndex] = indexA;
+                coarseIndicesB[level][fineIndex] = indexB;
+                if (indexA == indexB)
+                {
+                    fineIndices[level][indexA] = fineIndex;
+                }
+            }
+        }
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::setRepresentation(const GroupRepresentation<Map> &rhoImage)
+{
+    // The finest iterator is not owned, and is updated by the caller
+    for (const auto &coarseIterator : coarseIterators)
+    {
+        coarseIterator->setRepresentation(rhoImage);
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::runFullMultigrid()
+{
+    for (uint l=0; l!=depth; ++l)
+    {
+        if (l != 0)
+        {
+            prolongValues(l);
+        }
+        for (uint n=0; n!=nbFullMultigridIterations; ++n)
+        {
+            iterate(l);
+        }
+    }
+
+    if (depth != 0)
+    {
+        prolongValues(depth);
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::iterate()
+{
+    unsigned long long nbAllocationsBefore = AllocationCounter::getNbAllocations();
+    iterate(depth);
+    iterators[depth]->nbAllocationsLastIteration = AllocationCounter::getNbAllocations() - nbAllocationsBefore;
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::iterate(uint level)
+{
+    refreshCoarseLinearizations(level);
+    currentLevel = level;
+    iterators[level]->updateValuesEnergyNewton(level == 0 ? nullptr : this);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::refreshCoarseLinearizations(uint level)
+{
+    DiscreteFlowIterator<Point, Map> *fine, *coarse;
+    for (uint l=level; l!=0; --l)
+    {
+        fine = iterators[l];
+        coarse = iterators[l - 1];
+        for (uint j=0; j!=coarse->nbPoints; ++j)
+        {
+            coarse->newValues[j] = fine->newValues[fineIndices[l][j]];
+        }
+        coarse->refreshNeighborsValuesKicked();
+        coarse->oldValues = coarse->newValues;
+        coarse->refreshHessianCoefficients();
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::prolongValues(uint level)
+{
+    DiscreteFlowIterator<Point, Map> *fine = iterators[level], *coarse = iterators[level - 1];
+    uint a, b;
+    for (uint i=0; i!=fine->nbPoints; ++i)
+    {
+        a = coarseIndicesA[level][i];
+        b = coarseIndicesB[level][i];
+        fine->newValues[i] = (a == b) ? coarse->newValues[a] : Point::midpoint(coarse->newValues[a], coarse->newValues[b]);
+    }
+    if (fine->arePartnersPairingsComplete)
+    {
+        fine->refreshPartnersValues();
+    }
+    fine->refreshNeighborsValuesKicked();
+    fine->oldValues = fine->newValues;
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::precondition(const std::vector<Complex> &residual, std::vector<Complex> &out)
+{
+    // The lifts of a point of the surface are one unknown: the vectors are projected on the equivariant ones on each mesh,
+    // so that the V-cycle neither breaks the symmetry of the values nor counts a point several times
+    rightHandSides[currentLevel] = residual;
+    iterators[currentLevel]->projectOnPartnersVectors(rightHandSides[currentLevel]);
+    VCycle(currentLevel, rightHandSides[currentLevel], out);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::VCycle(uint level, const std::vector<Complex> &rightHandSide, std::vector<Complex> &solution)
+{
+    DiscreteFlowIterator<Point, Map> *iterator = iterators[level];
+    solution.assign(iterator->nbPoints, Complex(0.0, 0.0));
+    if (level == 0)
+    {
+        solveCoarsest(rightHandSide, solution);
+        iterator->projectOnPartnersVectors(solution);
+        return;
+    }
+
+    smooth(level, rightHandSide, solution, nbSmoothingSweeps);
+    iterator->projectOnPartnersVectors(solution);
+
+    iterator->multiplyEnergyHessian(solution, products[level]);
+    for (uint i=0; i!=iterator->nbPoints; ++i)
+    {
+        residuals[level][i] = rightHandSide[i] - products[level][i];
+    }
+    iterator->projectOnPartnersVectors(residuals[level]);
+    restrictVectors(level, residuals[level], rightHandSides[level - 1]);
+    iterators[level - 1]->projectOnPartnersVectors(rightHandSides[level - 1]);
+    VCycle(level - 1, rightHandSides[level - 1], solutions[level - 1]);
+    prolongAndAddVectors(level, solutions[level - 1], solution);
+    iterator->projectOnPartnersVectors(solution);
+
+    smooth(level, rightHandSide, solution, nbSmoothingSweeps);
+    iterator->projectOnPartnersVectors(solution);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::smooth(uint level, const std::vector<Complex> &rightHandSide, std::vector<Complex> &solution, uint nbSweeps)
+{
+    // Damped Jacobi, with the 2x2 diagonal blocks of the Hessian
+    DiscreteFlowIterator<Point, Map> *iterator = iterators[level];
+    std::vector<Complex> &product = products[level];
+    auto smoothChunk = [&](uint begin, uint end)
+    {
+        Complex residual;
+        double p1, q1, pI, qI, determinant;
+        for (uint i=begin; i!=end; ++i)
+        {
+            p1 = real(iterator->hessianDiagonals1[i]);
+            q1 = imag(iterator->hessianDiagonals1[i]);
+            pI = real(iterator->hessianDiagonalsI[i]);
+            qI = imag(iterator->hessianDiagonalsI[i]);
+            determinant = p1*qI - pI*q1;
+            if (p1 > 0.0 && determinant > 0.0)
+            {
+                residual = rightHandSide[i] - product[i];
+                solution[i] += (smoothingDamping/determinant)*Complex(qI*real(residual) - pI*imag(residual), p1*imag(residual) - q1*real(residual));
+            }
+        }
+    };
+
+    for (uint sweep=0; sweep!=nbSweeps; ++sweep)
+    {
+        iterator->multiplyEnergyHessian(solution, product);
+        iterator->threadPool.parallelFor(0, iterator->nbPoints, smoothChunk);
+    }
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::restrictVectors(uint level, const std::vector<Complex> &fineVectors, std::vector<Complex> &coarseVectors)
+{
+    // Adjoint of the prolongation: the point j of level - 1 collects its own value and half of the values at its neighbors,
+    // which are the midpoints of the coarse edges from j. Vectors are compared in orthonormal frames, multiplying by 2/(1-|z|^2).
+    DiscreteFlowIterator<Point, Map> *fine = iterators[level], *coarse = iterators[level - 1];
+    auto restrictChunk = [&](uint begin, uint end)
+    {
+        Complex sum;
+        uint i;
+        for (uint j=begin; j!=end; ++j)
+        {
+            i = fineIndices[level][j];
+            sum = sqrt(fine->metricFactors[i])*fineVectors[i];
+            for (uint k=fine->neighborsOffsets[i]; k!=fine->neighborsOffsets[i + 1]; ++k)
+            {
+                sum += (fine->hessianPushForwards[k]/(1.0 - norm(fine->neighborsValuesKicked[k].getDiskCoordinate())))*fineVectors[fine->neighborsIndices[k]];
+            }
+            coarseVectors[j] = sum/sqrt(coarse->metricFactors[j]);
+        }
+    };
+    coarse->threadPool.parallelFor(0, coarse->nbPoints, restrictChunk);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::prolongAndAddVectors(uint level, const std::vector<Complex> &coarseVectors, std::vector<Complex> &fineVectors)
+{
+    DiscreteFlowIterator<Point, Map> *fine = iterators[level], *coarse = iterators[level - 1];
+    auto prolongChunk = [&](uint begin, uint end)
+    {
+        uint a, b;
+        for (uint i=begin; i!=end; ++i)
+        {
+            a = coarseIndicesA[level][i];
+            b = coarseIndicesB[level][i];
+            if (a == b)
+            {
+                fineVectors[i] += coarseVectors[a];
+            }
+            else
+            {
+                fineVectors[i] += 0.5*(sqrt(coarse->metricFactors[a])*coarseVectors[a] + sqrt(coarse->metricFactors[b])*coarseVectors[b])
+                        /sqrt(fine->metricFactors[i]);
+            }
+        }
+    };
+    fine->threadPool.parallelFor(0, fine->nbPoints, prolongChunk);
+}
+
+template <typename Point, typename Map>
+void DiscreteFlowMultigrid<Point, Map>::solveCoarsest(const std::vector<Complex> &rightHandSide, std::vector<Complex> &solution)
+{
+    DiscreteFlowIterator<Point, Map> *iterator = iterators[0];
+    uint i, nbPoints = iterator->nbPoints;
+    std::vector<Complex> &residual = residuals[0];
+    residual = rightHandSide;
+    coarsestDirection = rightHandSide;
+
+    double residualNormSquared = iterator->scalProd(residual, residual), newResidualNormSquared;
+    double tolerance = 0.0000000001*residualNormSquared;
+    double curvature, alpha, beta;
+    for (uint iteration=0; iteration!=nbCoarsestIterations && residualNormSquared > tolerance; ++iteration)
+    {
+        iterator->multiplyEnergyHessian(coarsestDirection, coarsestProduct);
+        curvature = iterator->scalProd(coarsestDirection, coarsestProduct);
+        if (curvature <= 0.0)
+        {
+            break;
+        }
+
+        alpha = residualNormSquared/curvature;
+        for (i=0; i!=nbPoints; ++i)
+        {
+            solution[i] += alpha*coarsestDirection[i];
+            residual[i] -= alpha*coarsestProduct[i];
+        }
+
+        newResidualNormSquared = iterator->scalProd(residual, residual);
+        beta = newResidualNormSquared/residualNormSquared;
+        residualNormSquared = newResidualNormSquared;
+        for (i=0; i!=nbPoints; ++i)
+        {
+            coarsestDirection[i] = residual[i] + beta*coarsestDirection[i];
+        }
+    }
+}
+
+
+template class DiscreteFlowMultigrid<H2Point, H2Isometry>;
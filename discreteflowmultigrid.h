@@ -0,0 +1,60 @@
+#ifndef DISCRETEFLOWMULTIGRID_H
+#define DISCRETEFLOWMULTIGRID_H
+
+#include "tools.h"
+#include "discreteflowiterator.h"
+
+template <typename Point, typename Map> class LiftedGraphFunctionTriangulated; template <typename Map> class GroupRepresentation;
+class H2Point; class H2Isometry;
+
+
+// Multigrid solver on the hierarchy of meshes of depths 0, ..., depth: the mesh of depth l+1 refines the mesh of depth l by midpoints.
+// Each iteration is a Newton step on the finest mesh, whose linear system is solved by conjugate gradients preconditioned by a V-cycle:
+// residuals are restricted to the coarser meshes, where the Hessian is linearized at the restriction of the current values,
+// and corrections are prolonged back, with damped block Jacobi smoothing on each mesh.
+// runFullMultigrid() first makes a few Newton steps on each coarser mesh, each result being prolonged as the initial guess on the next mesh.
+// All the meshes share the thread pool of the finest iterator.
+
+template <typename Point, typename Map> class DiscreteFlowMultigrid
+{
+public:
+    DiscreteFlowMultigrid(DiscreteFlowIterator<Point, Map> *fineIterator,
+                          const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &fineDomainFunction,
+                          const GroupRepresentation<H2Isometry> &rhoDomain, const GroupRepresentation<Map> &rhoImage);
+    DiscreteFlowMultigrid(const DiscreteFlowMultigrid &) = delete;
+    DiscreteFlowMultigrid & operator=(DiscreteFlowMultigrid) = delete;
+
+    void runFullMultigrid();
+    void iterate();
+    void precondition(const std::vector<Complex> &residual, std::vector<Complex> &out);
+
+    void setRepresentation(const GroupRepresentation<Map> &rhoImage);
+
+private:
+    void constructTransfers(uint level, const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &coarseDomainFunction,
+                            const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &fineDomainFunction);
+    void iterate(uint level);
+    void refreshCoarseLinearizations(uint level);
+    void prolongValues(uint level);
+    void restrictVectors(uint level, const std::vector<Complex> &fineVectors, std::vector<Complex> &coarseVectors);
+    void prolongAndAddVectors(uint level, const std::vector<Complex> &coarseVectors, std::vector<Complex> &fineVectors);
+    void smooth(uint level, const std::vector<Complex> &rightHandSide, std::vector<Complex> &solution, uint nbSweeps);
+    void VCycle(uint level, const std::vector<Complex> &rightHandSide, std::vector<Complex> &solution);
+    void solveCoarsest(const std::vector<Complex> &rightHandSide, std::vector<Complex> &solution);
+
+    uint depth, currentLevel;
+    std::vector< std::unique_ptr< DiscreteFlowIterator<Point, Map> > > coarseIterators;
+    std::vector< DiscreteFlowIterator<Point, Map> *> iterators;
+
+    // For level l > 0, point i of level l is the midpoint of the points coarseIndicesA[l][i] and coarseIndicesB[l][i] of level l - 1,
+    // which are equal when point i is a point of level l - 1. That point j of level l - 1 is the point fineIndices[l][j] of level l.
+    std::vector< std::vector<uint> > coarseIndicesA, coarseIndicesB, fineIndices;
+
+    std::vector< std::vector<Complex> > rightHandSides, solutions, residuals, products;
+    std::vector<Complex> coarsestDirection, coarsestProduct;
+
+    uint nbSmoothingSweeps, nbFullMultigridIterations, nbCoarsestIterations;
+    double smoothingDamping;
+};
+
+#endif // DISCRETEFLOWMULTIGRID_H
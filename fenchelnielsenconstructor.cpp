@@ -1,6 +1,5 @@
 #include "fenchelnielsenconstructor.h"
-#include "canvas.h"
-#include "h2canvasdelegate.h"
+#include "profiler.h"
 
 
 PantsTree::PantsTree(uint index, const std::vector<double> &CoshHalfLengthsAugmented,
@@ -113,6 +112,7 @@ GroupRepresentation<H2Isometry> PantsTreeLeaf::getRepresentation(H2Isometry &tot
 
 FenchelNielsenConstructor::FenchelNielsenConstructor(const std::vector<double> &lengths, const std::vector<double> &twists)
 {
+    PROFILE_SCOPE("FenchelNielsenConstructor");
     this->lengths = lengths;
     this->twists = twists;
     genus=lengths.size()/3 + 1;
@@ -262,6 +262,7 @@ GroupRepresentation<H2Isometry> FenchelNielsenConstructor::getUnnormalizedRepres
 
 GroupRepresentation<H2Isometry> FenchelNielsenConstructor::getRepresentation()
 {
+    PROFILE_SCOPE("FenchelNielsenConstructor::getRepresentation");
     GroupRepresentation<H2Isometry> rhoU = getUnnormalizedRepresentation();
 
     GroupRepresentation<H2Isometry> rho(DiscreteGroup(TopologicalSurface(genus, 0)));
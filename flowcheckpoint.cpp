@@ -0,0 +1,126 @@
+#include "flowcheckpoint.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+
+const quint32 FlowCheckpoint::magicNumber = 0x48524d43;
+const quint32 FlowCheckpoint::formatVersion = 1;
+
+static void writeDoubles(QDataStream &out, const std::vector<double> &V)
+{
+    out << quint32(V.size());
+    for (const auto & x : V)
+    {
+        out << x;
+    }
+}
+
+static void readDoubles(QDataStream &in, std::vector<double> &V, const QString &fileName)
+{
+    quint32 size;
+    in >> size;
+    if (in.status() != QDataStream::Ok || quint64(size)*sizeof(double) > quint64(in.device()->bytesAvailable()))
+    {
+        throw(QString("Error in FlowCheckpoint::load: %1 is truncated").arg(fileName));
+    }
+    V.resize(size);
+    for (auto & x : V)
+    {
+        in >> x;
+    }
+}
+
+FlowCheckpoint::FlowCheckpoint() : genus(0), meshDepth(0), flowChoice(0), nbIterations(0)
+{
+}
+
+void FlowCheckpoint::save(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        throw(QString("Error in FlowCheckpoint::save: cannot open %1 (%2)").arg(fileName, file.errorString()));
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    out << magicNumber << formatVersion;
+    out << quint32(genus) << quint32(meshDepth) << qint32(flowChoice) << quint32(nbIterations);
+    writeDoubles(out, FNLengthsDomain);
+    writeDoubles(out, FNTwistsDomain);
+    writeDoubles(out, FNLengthsImage);
+    writeDoubles(out, FNTwistsImage);
+    out << quint32(values.size());
+    for (const auto & z : values)
+    {
+        out << real(z) << imag(z);
+    }
+
+    if (out.status() != QDataStream::Ok)
+    {
+        file.cancelWriting();
+        throw(QString("Error in FlowCheckpoint::save: failed to write %1").arg(fileName));
+    }
+    if (!file.commit())
+    {
+        throw(QString("Error in FlowCheckpoint::save: cannot replace %1 (%2)").arg(fileName, file.errorString()));
+    }
+}
+
+void FlowCheckpoint::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        throw(QString("Error in FlowCheckpoint::load: cannot open %1 (%2)").arg(fileName, file.errorString()));
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    in.setByteOrder(QDataStream::LittleEndian);
+    in.setFloatingPointPrecision(QDataStream::DoublePrecision);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != magicNumber)
+    {
+        throw(QString("Error in FlowCheckpoint::load: %1 is not a checkpoint file").arg(fileName));
+    }
+    if (version != formatVersion)
+    {
+        throw(QString("Error in FlowCheckpoint::load: unsupported checkpoint version %1 in %2").arg(version).arg(fileName));
+    }
+
+    quint32 genusIn, meshDepthIn, nbIterationsIn, nbValues;
+    qint32 flowChoiceIn;
+    in >> genusIn >> meshDepthIn >> flowChoiceIn >> nbIterationsIn;
+    readDoubles(in, FNLengthsDomain, fileName);
+    readDoubles(in, FNTwistsDomain, fileName);
+    readDoubles(in, FNLengthsImage, fileName);
+    readDoubles(in, FNTwistsImage, fileName);
+    in >> nbValues;
+    if (in.status() != QDataStream::Ok || quint64(nbValues)*2*sizeof(double) > quint64(file.bytesAvailable()))
+    {
+        throw(QString("Error in FlowCheckpoint::load: %1 is truncated").arg(fileName));
+    }
+    values.resize(nbValues);
+    double x, y;
+    for (auto & z : values)
+    {
+        in >> x >> y;
+        z = Complex(x, y);
+    }
+    if (in.status() != QDataStream::Ok)
+    {
+        throw(QString("Error in FlowCheckpoint::load: %1 is truncated").arg(fileName));
+    }
+
+    genus = genusIn;
+    meshDepth = meshDepthIn;
+    flowChoice = flowChoiceIn;
+    nbIterations = nbIterationsIn;
+}
@@ -0,0 +1,33 @@
+#ifndef FLOWCHECKPOINT_H
+#define FLOWCHECKPOINT_H
+
+#include "tools.h"
+
+
+// State of a flow run, saved in a versioned binary file:
+// the Fenchel-Nielsen coordinates of the domain and image representations, the genus, the mesh depth,
+// the flow choice, the number of iterations already made and the disk coordinates of the current values.
+// The state of the accelerations of the flows is not saved: they start again from the saved values.
+// save() writes to a temporary file which replaces fileName only once it is complete, so that an interrupted write
+// leaves the previous checkpoint intact.
+
+class FlowCheckpoint
+{
+public:
+    FlowCheckpoint();
+
+    void save(const QString &fileName) const;
+    void load(const QString &fileName);
+
+    uint genus, meshDepth;
+    int flowChoice;
+    uint nbIterations;
+    std::vector<double> FNLengthsDomain, FNTwistsDomain, FNLengthsImage, FNTwistsImage;
+    std::vector<Complex> values;
+
+private:
+    static const quint32 magicNumber;
+    static const quint32 formatVersion;
+};
+
+#endif // FLOWCHECKPOINT_H
@@ -0,0 +1,10 @@
+#ifndef FLOWCHOICE_H
+#define FLOWCHOICE_H
+
+
+// Flow methods of DiscreteFlowIterator and DiscreteFlowFactory. They are also the indices of the flow combo box of OutputMenu.
+
+enum FlowChoice {FLOW_CHOICE, FLOW_CENTROID, FLOW_ENERGY_CONSTANT_STEP, FLOW_ENERGY_OPTIMAL_STEP, FLOW_ENERGY_NEWTON, FLOW_MULTIGRID,
+                 FLOW_CENTROID_ANDERSON, FLOW_CENTROID_GAUSS_SEIDEL};
+
+#endif // FLOWCHOICE_H
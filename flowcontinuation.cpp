@@ -0,0 +1,177 @@
+#include "flowcontinuation.h"
+
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include "flowchoice.h"
+#include "flowrunner.h"
+#include "threadpool.h"
+
+FlowContinuation::FlowContinuation(uint genus, uint meshDepth, int flowChoice) :
+    genus(genus), meshDepth(meshDepth), flowChoice(flowChoice)
+{
+    if (genus < 2)
+    {
+        throw(QString("Error in FlowContinuation::FlowContinuation: genus must be at least 2"));
+    }
+    maxNbIterations = 100000;
+    nbThreads = ThreadPool::defaultNbThreads();
+    andersonMemory = 5;
+    overRelaxationFactor = 0.0;
+    tolerance = 0.0000000001;
+    wallTime = 0.0;
+    warmStart = true;
+    usePredictor = false;
+}
+
+void FlowContinuation::setRhoDomain(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists)
+{
+    FNLengthsDomain = FNLengths;
+    FNTwistsDomain = FNTwists;
+}
+
+void FlowContinuation::setTolerance(double tolerance)
+{
+    this->tolerance = tolerance;
+}
+
+void FlowContinuation::setMaxNbIterations(uint maxNbIterations)
+{
+    this->maxNbIterations = maxNbIterations;
+}
+
+void FlowContinuation::setNbThreads(uint nbThreads)
+{
+    this->nbThreads = nbThreads;
+}
+
+void FlowContinuation::setAndersonMemory(uint andersonMemory)
+{
+    this->andersonMemory = andersonMemory;
+}
+
+void FlowContinuation::setOverRelaxationFactor(double overRelaxationFactor)
+{
+    this->overRelaxationFactor = overRelaxationFactor;
+}
+
+void FlowContinuation::setWarmStart(bool warmStart)
+{
+    this->warmStart = warmStart;
+}
+
+void FlowContinuation::setUsePredictor(bool usePredictor)
+{
+    this->usePredictor = usePredictor;
+}
+
+void FlowContinuation::addPathPoint(const std::vector<double> &FNLengthsImage, const std::vector<double> &FNTwistsImage)
+{
+    if ((3*genus != 3 + FNLengthsImage.size()) || (3*genus != 3 + FNTwistsImage.size()))
+    {
+        throw(QString("Error in FlowContinuation::addPathPoint: genus does not match number of FN coordinates"));
+    }
+    pathLengths.push_back(FNLengthsImage);
+    pathTwists.push_back(FNTwistsImage);
+}
+
+void FlowContinuation::addLinearPath(const std::vector<double> &FNLengthsImageStart, const std::vector<double> &FNTwistsImageStart,
+                                     const std::vector<double> &FNLengthsImageEnd, const std::vector<double> &FNTwistsImageEnd, uint nbSteps)
+{
+    // nbSteps + 1 equally spaced points, from start to end
+    if (nbSteps == 0)
+    {
+        throw(QString("Error in FlowContinuation::addLinearPath: need at least one step"));
+    }
+    if (FNLengthsImageStart.size() != FNLengthsImageEnd.size() || FNTwistsImageStart.size() != FNTwistsImageEnd.size())
+    {
+        throw(QString("Error in FlowContinuation::addLinearPath: start and end do not have the same number of FN coordinates"));
+    }
+
+    std::vector<double> FNLengths(FNLengthsImageStart.size()), FNTwists(FNTwistsImageStart.size());
+    double t;
+    for (uint n=0; n<=nbSteps; ++n)
+    {
+        t = n*1.0/nbSteps;
+        for (uint k=0; k!=FNLengths.size(); ++k)
+        {
+            FNLengths[k] = (1.0 - t)*FNLengthsImageStart[k] + t*FNLengthsImageEnd[k];
+        }
+        for (uint k=0; k!=FNTwists.size(); ++k)
+        {
+            FNTwists[k] = (1.0 - t)*FNTwistsImageStart[k] + t*FNTwistsImageEnd[k];
+        }
+        addPathPoint(FNLengths, FNTwists);
+    }
+}
+
+void FlowContinuation::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    results.clear();
+    std::unique_ptr<FlowRunner> runner;
+    Result result;
+    for (uint n=0; n!=pathLengths.size(); ++n)
+    {
+        if (n == 0 || !warmStart)
+        {
+            runner.reset(new FlowRunner);
+            runner->setGenus(genus);
+            runner->setMeshDepth(meshDepth);
+            runner->setRhoDomain(FNLengthsDomain, FNTwistsDomain);
+            runner->setRhoImage(pathLengths[n], pathTwists[n]);
+            runner->setFlowChoice(flowChoice);
+            runner->setTolerance(tolerance);
+            runner->setMaxNbIterations(maxNbIterations);
+            runner->setNbThreads(nbThreads);
+            runner->setAndersonMemory(andersonMemory);
+            runner->setOverRelaxationFactor(overRelaxationFactor);
+            runner->run();
+        }
+        else
+        {
+            runner->continueRhoImage(pathLengths[n], pathTwists[n], usePredictor);
+        }
+
+        result.FNLengthsImage = pathLengths[n];
+        result.FNTwistsImage = pathTwists[n];
+        result.hasConverged = runner->hasConverged();
+        result.nbIterations = runner->getNbIterations();
+        result.energy = runner->getEnergy();
+        result.supError = runner->getSupError();
+        result.setupTime = runner->getSetupTime();
+        result.flowTime = runner->getFlowTime();
+        results.push_back(result);
+    }
+
+    wallTime = timer.nsecsElapsed()*1e-9;
+}
+
+void FlowContinuation::writeTable(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        throw(QString("Error in FlowContinuation::writeTable: cannot open %1").arg(fileName));
+    }
+    QTextStream out(&file);
+    out.setRealNumberPrecision(17);
+
+    // Tab separated, one row per point of the path. The FN coordinates are comma separated.
+    out << "index\timage FN lengths\timage FN twists\tenergy\titerations\tsup error\tconverged\tsetup time (s)\tflow time (s)\n";
+    for (uint i=0; i!=results.size(); ++i)
+    {
+        const Result &result = results[i];
+        out << i << "\t" << Tools::joinNumbers(result.FNLengthsImage) << "\t" << Tools::joinNumbers(result.FNTwistsImage) << "\t"
+            << result.energy << "\t" << result.nbIterations << "\t" << result.supError << "\t"
+            << (result.hasConverged ? "yes" : "no") << "\t" << result.setupTime << "\t" << result.flowTime << "\n";
+    }
+
+    if (!file.commit())
+    {
+        throw(QString("Error in FlowContinuation::writeTable: cannot write %1").arg(fileName));
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef FLOWCONTINUATION_H
+#define FLOWCONTINUATION_H
+
+#include "tools.h"
+
+
+// Computes the harmonic maps along a path of image representations, for a fixed domain representation.
+// By default each point of the path starts from the values computed at the previous point (see DiscreteFlowFactory::continueRhoImage),
+// optionally extrapolated by a predictor step. With setWarmStart(false), each point starts from the piecewise linear initial values,
+// for comparison.
+
+class FlowContinuation
+{
+public:
+    struct Result
+    {
+        std::vector<double> FNLengthsImage, FNTwistsImage;
+        bool hasConverged;
+        uint nbIterations;
+        double energy, supError, setupTime, flowTime;
+    };
+
+    FlowContinuation(uint genus, uint meshDepth, int flowChoice);
+    FlowContinuation(const FlowContinuation &) = delete;
+    FlowContinuation & operator=(FlowContinuation) = delete;
+
+    void setRhoDomain(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists);
+    void setTolerance(double tolerance);
+    void setMaxNbIterations(uint maxNbIterations);
+    void setNbThreads(uint nbThreads);
+    void setAndersonMemory(uint andersonMemory);
+    void setOverRelaxationFactor(double overRelaxationFactor);
+    void setWarmStart(bool warmStart);
+    void setUsePredictor(bool usePredictor);
+
+    void addPathPoint(const std::vector<double> &FNLengthsImage, const std::vector<double> &FNTwistsImage);
+    void addLinearPath(const std::vector<double> &FNLengthsImageStart, const std::vector<double> &FNTwistsImageStart,
+                       const std::vector<double> &FNLengthsImageEnd, const std::vector<double> &FNTwistsImageEnd, uint nbSteps);
+    uint getNbPathPoints() const {return pathLengths.size();}
+
+    void run();
+    const std::vector<Result> & getResults() const {return results;}
+    double getWallTime() const {return wallTime;}
+    void writeTable(const QString &fileName) const;
+
+private:
+    uint genus, meshDepth, maxNbIterations, nbThreads, andersonMemory;
+    int flowChoice;
+    double tolerance, wallTime, overRelaxationFactor;
+    bool warmStart, usePredictor;
+    std::vector<double> FNLengthsDomain, FNTwistsDomain;
+
+    std::vector< std::vector<double> > pathLengths, pathTwists;
+    std::vector<Result> results;
+};
+
+#endif // FLOWCONTINUATION_H
@@ -0,0 +1,116 @@
+#include "flowprogress.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+CancellationToken::CancellationToken() : cancelled(false)
+{
+}
+
+void CancellationToken::cancel()
+{
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+void CancellationToken::reset()
+{
+    cancelled.store(false, std::memory_order_relaxed);
+}
+
+bool CancellationToken::isCancelled() const
+{
+    return cancelled.load(std::memory_order_relaxed);
+}
+
+
+FlowProgress::FlowProgress() : sequence(0), isRunning(false), nbIterations(0), supError(0.0), tolerance(0.0), elapsedTime(0.0), remainingTime(-1.0)
+{
+    startTime = std::chrono::steady_clock::now();
+    isRateKnown = false;
+    isReferenceSet = false;
+    referenceNbIterations = 0;
+    referenceSupError = 0.0;
+    lastSupError = 0.0;
+    logRate = 0.0;
+    lastTolerance = 0.0;
+}
+
+void FlowProgress::start(double supError, double tolerance)
+{
+    startTime = std::chrono::steady_clock::now();
+    isRateKnown = false;
+    isReferenceSet = false;
+    lastSupError = supError;
+    lastTolerance = tolerance;
+    publish(true, 0, supError);
+}
+
+void FlowProgress::update(uint nbIterations, double supError)
+{
+    // The sup error is only refreshed every few iterations: the rate is measured between two refreshes
+    if (supError != lastSupError && supError > 0.0)
+    {
+        if (isReferenceSet && nbIterations > referenceNbIterations)
+        {
+            double rate = (log(supError) - log(referenceSupError))/(nbIterations - referenceNbIterations);
+            logRate = isRateKnown ? 0.5*(logRate + rate) : rate;
+            isRateKnown = true;
+        }
+        isReferenceSet = true;
+        referenceNbIterations = nbIterations;
+        referenceSupError = supError;
+    }
+    lastSupError = supError;
+    publish(true, nbIterations, supError);
+}
+
+void FlowProgress::finish(uint nbIterations, double supError)
+{
+    lastSupError = supError;
+    publish(false, nbIterations, supError);
+}
+
+FlowProgress::Snapshot FlowProgress::getSnapshot() const
+{
+    Snapshot out;
+    uint before, after;
+    do
+    {
+        before = sequence.load(std::memory_order_acquire);
+        out.isRunning = isRunning.load(std::memory_order_relaxed);
+        out.nbIterations = nbIterations.load(std::memory_order_relaxed);
+        out.supError = supError.load(std::memory_order_relaxed);
+        out.tolerance = tolerance.load(std::memory_order_relaxed);
+        out.elapsedTime = elapsedTime.load(std::memory_order_relaxed);
+        out.remainingTime = remainingTime.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence.load(std::memory_order_relaxed);
+    }
+    while ((before & 1) || before != after);
+    return out;
+}
+
+void FlowProgress::publish(bool isRunning, uint nbIterations, double supError)
+{
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(), remaining = -1.0;
+    if (!isRunning)
+    {
+        remaining = 0.0;
+    }
+    else if (isRateKnown && logRate < 0.0 && supError > 0.0 && lastTolerance > 0.0 && nbIterations != 0)
+    {
+        remaining = std::max(0.0, (log(lastTolerance) - log(supError))/logRate)*elapsed/nbIterations;
+    }
+
+    uint s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    this->isRunning.store(isRunning, std::memory_order_relaxed);
+    this->nbIterations.store(nbIterations, std::memory_order_relaxed);
+    this->supError.store(supError, std::memory_order_relaxed);
+    tolerance.store(lastTolerance, std::memory_order_relaxed);
+    elapsedTime.store(elapsed, std::memory_order_relaxed);
+    remainingTime.store(remaining, std::memory_order_relaxed);
+    sequence.store(s + 2, std::memory_order_release);
+}
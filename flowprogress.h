@@ -0,0 +1,68 @@
+#ifndef FLOWPROGRESS_H
+#define FLOWPROGRESS_H
+
+#include <atomic>
+#include <chrono>
+
+#include "types.h"
+
+
+// Cancellation and progress of a flow run, shared between the thread running the flow and the threads watching it
+// (the GUI thread, or any headless caller). Neither depends on Qt, and no method takes a lock.
+
+// cancel() may be called from any thread (or a signal handler): the flow checks isCancelled() between two iterations.
+class CancellationToken
+{
+public:
+    CancellationToken();
+    CancellationToken(const CancellationToken &) = delete;
+    CancellationToken & operator=(CancellationToken) = delete;
+
+    void cancel();
+    void reset();
+    bool isCancelled() const;
+
+private:
+    std::atomic<bool> cancelled;
+};
+
+
+// start(), update() and finish() are called by the thread running the flow only, getSnapshot() by any thread.
+// The snapshots are published under a sequence lock: the sequence number is odd while a snapshot is written,
+// and a reader retries until it reads the same even number before and after the fields, so that it never sees a torn snapshot.
+// The remaining time is estimated from the decay rate of the sup error towards the tolerance, and is negative while unknown.
+class FlowProgress
+{
+public:
+    struct Snapshot
+    {
+        bool isRunning;
+        uint nbIterations;
+        double supError, tolerance, elapsedTime, remainingTime;
+    };
+
+    FlowProgress();
+    FlowProgress(const FlowProgress &) = delete;
+    FlowProgress & operator=(FlowProgress) = delete;
+
+    void start(double supError, double tolerance);
+    void update(uint nbIterations, double supError);
+    void finish(uint nbIterations, double supError);
+    Snapshot getSnapshot() const;
+
+private:
+    void publish(bool isRunning, uint nbIterations, double supError);
+
+    std::atomic<uint> sequence;
+    std::atomic<bool> isRunning;
+    std::atomic<uint> nbIterations;
+    std::atomic<double> supError, tolerance, elapsedTime, remainingTime;
+
+    // Writer state
+    std::chrono::steady_clock::time_point startTime;
+    bool isRateKnown, isReferenceSet;
+    uint referenceNbIterations;
+    double referenceSupError, lastSupError, logRate, lastTolerance;
+};
+
+#endif // FLOWPROGRESS_H
@@ -0,0 +1,320 @@
+#include "flowrunner.h"
+
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include "flowchoice.h"
+
+FlowRunner::FlowRunner() : factory(&rhoDomain, &rhoImage, &domainFunction, &imageFunction)
+{
+    genus = 0;
+    meshDepth = 0;
+    maxNbIterations = 100000;
+    flowChoice = FLOW_CHOICE;
+    hasRun = false;
+    nbIterations = 0;
+    supError = 0.0;
+    energy = 0.0;
+    setupTime = 0.0;
+    flowTime = 0.0;
+    telemetryFormat = FlowTelemetry::FORMAT_CSV;
+}
+
+void FlowRunner::setGenus(uint genus)
+{
+    if (genus < 2)
+    {
+        throw(QString("Error in FlowRunner::setGenus: genus must be at least 2"));
+    }
+    this->genus = genus;
+}
+
+void FlowRunner::setMeshDepth(uint meshDepth)
+{
+    this->meshDepth = meshDepth;
+}
+
+void FlowRunner::setRhoDomain(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists)
+{
+    FNLengthsDomain = FNLengths;
+    FNTwistsDomain = FNTwists;
+}
+
+void FlowRunner::setRhoImage(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists)
+{
+    FNLengthsImage = FNLengths;
+    FNTwistsImage = FNTwists;
+}
+
+void FlowRunner::setFlowChoice(int flowChoice)
+{
+    if (flowChoice <= FLOW_CHOICE || flowChoice > FLOW_CENTROID_GAUSS_SEIDEL)
+    {
+        throw(QString("Error in FlowRunner::setFlowChoice: no legal flow choice"));
+    }
+    this->flowChoice = flowChoice;
+}
+
+void FlowRunner::setTolerance(double tolerance)
+{
+    factory.setTolerance(tolerance);
+}
+
+void FlowRunner::setMaxNbIterations(uint maxNbIterations)
+{
+    this->maxNbIterations = maxNbIterations;
+}
+
+void FlowRunner::setNbThreads(uint nbThreads)
+{
+    factory.setNbThreads(nbThreads);
+}
+
+void FlowRunner::setAndersonMemory(uint andersonMemory)
+{
+    factory.setAndersonMemory(andersonMemory);
+}
+
+void FlowRunner::setOverRelaxationFactor(double overRelaxationFactor)
+{
+    factory.setOverRelaxationFactor(overRelaxationFactor);
+}
+
+void FlowRunner::setCheckpointFile(const QString &fileName, uint nbIterationsBetweenCheckpoints)
+{
+    factory.setCheckpointFile(fileName, nbIterationsBetweenCheckpoints);
+}
+
+void FlowRunner::setResumeFile(const QString &fileName)
+{
+    resumeFileName = fileName;
+}
+
+void FlowRunner::setTelemetryFile(const QString &fileName, uint stride, FlowTelemetry::Format format)
+{
+    telemetry.setStride(stride);
+    telemetryFileName = fileName;
+    telemetryFormat = format;
+}
+
+void FlowRunner::setUp()
+{
+    if (!resumeFileName.isEmpty())
+    {
+        // The checkpoint gives the genus, the representations, the mesh depth and the flow choice,
+        // but a flow choice set explicitly overrides the one of the checkpoint
+        factory.resumeFromCheckpoint(resumeFileName);
+        genus = factory.genus;
+        meshDepth = factory.meshDepth;
+        FNLengthsDomain = factory.FNLengthsDomain;
+        FNTwistsDomain = factory.FNTwistsDomain;
+        FNLengthsImage = factory.FNLengthsImage;
+        FNTwistsImage = factory.FNTwistsImage;
+        if (flowChoice == FLOW_CHOICE)
+        {
+            flowChoice = factory.flowChoice;
+        }
+    }
+    else
+    {
+        if (genus == 0)
+        {
+            throw(QString("Error in FlowRunner::setUp: genus not set"));
+        }
+        factory.setGenus(genus);
+        factory.setRhoDomain(FNLengthsDomain, FNTwistsDomain);
+        factory.setRhoImage(FNLengthsImage, FNTwistsImage);
+        factory.setMeshDepth(meshDepth);
+    }
+
+    if (flowChoice == FLOW_CHOICE)
+    {
+        throw(QString("Error in FlowRunner::setUp: flow method not chosen"));
+    }
+    factory.setFlowChoice(flowChoice);
+}
+
+void FlowRunner::run()
+{
+    QElapsedTimer timer;
+
+    timer.start();
+    setUp();
+    setupTime = timer.nsecsElapsed()*1e-9;
+
+    // If the flow throws, the telemetry is closed by its destructor
+    if (!telemetryFileName.isEmpty())
+    {
+        telemetry.open(telemetryFileName, telemetryFormat);
+        factory.setTelemetry(&telemetry);
+    }
+
+    iterateFlow();
+
+    if (!telemetryFileName.isEmpty())
+    {
+        factory.setTelemetry(nullptr);
+        telemetry.close();
+    }
+}
+
+void FlowRunner::continueRhoImage(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists, bool usePredictor)
+{
+    if (!hasRun)
+    {
+        throw(QString("Error in FlowRunner::continueRhoImage: the flow has not been run"));
+    }
+
+    QElapsedTimer timer;
+
+    timer.start();
+    factory.continueRhoImage(FNLengths, FNTwists, usePredictor);
+    FNLengthsImage = FNLengths;
+    FNTwistsImage = FNTwists;
+    setupTime = timer.nsecsElapsed()*1e-9;
+
+    iterateFlow();
+}
+
+void FlowRunner::cancel()
+{
+    factory.stopRunning();
+}
+
+FlowProgress::Snapshot FlowRunner::getProgress() const
+{
+    return factory.getProgress();
+}
+
+void FlowRunner::iterateFlow()
+{
+    QElapsedTimer timer;
+
+    timer.start();
+    factory.iterate(maxNbIterations);
+    flowTime = timer.nsecsElapsed()*1e-9;
+
+    nbIterations = factory.getNbIterations();
+    supError = factory.getSupError();
+    factory.updateEnergy();
+    energy = factory.getEnergy();
+    hasRun = true;
+}
+
+uint FlowRunner::getNbPoints() const
+{
+    return domainFunction.getNbPoints();
+}
+
+bool FlowRunner::hasConverged() const
+{
+    return hasRun && supError < factory.getTolerance();
+}
+
+void FlowRunner::writeValues(const QString &fileName) const
+{
+    if (!hasRun)
+    {
+        throw(QString("Error in FlowRunner::writeValues: the flow has not been run"));
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        throw(QString("Error in FlowRunner::writeValues: cannot open %1").arg(fileName));
+    }
+    QTextStream out(&file);
+    out.setRealNumberPrecision(17);
+
+    // One line per mesh point: disk coordinates of the point in the domain and of its image
+    out << "# x y f(x) f(y)\n";
+    std::vector<H2Point> domainValues = domainFunction.getValues();
+    std::vector<H2Point> imageValues = imageFunction.getValues();
+    Complex z, w;
+    for (uint i=0; i!=domainValues.size(); ++i)
+    {
+        z = domainValues[i].getDiskCoordinate();
+        w = imageValues[i].getDiskCoordinate();
+        out << real(z) << " " << imag(z) << " " << real(w) << " " << imag(w) << "\n";
+    }
+
+    if (!file.commit())
+    {
+        throw(QString("Error in FlowRunner::writeValues: cannot write %1").arg(fileName));
+    }
+}
+
+void FlowRunner::writeSummary(const QString &fileName) const
+{
+    if (!hasRun)
+    {
+        throw(QString("Error in FlowRunner::writeSummary: the flow has not been run"));
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        throw(QString("Error in FlowRunner::writeSummary: cannot open %1").arg(fileName));
+    }
+    QTextStream out(&file);
+    out.setRealNumberPrecision(17);
+
+    out << "genus = " << genus << "\n";
+    out << "mesh depth = " << meshDepth << "\n";
+    out << "domain FN lengths = " << Tools::joinNumbers(FNLengthsDomain) << "\n";
+    out << "domain FN twists = " << Tools::joinNumbers(FNTwistsDomain) << "\n";
+    out << "image FN lengths = " << Tools::joinNumbers(FNLengthsImage) << "\n";
+    out << "image FN twists = " << Tools::joinNumbers(FNTwistsImage) << "\n";
+    out << "flow = " << flowName(flowChoice) << "\n";
+    out << "mesh points = " << getNbPoints() << "\n";
+    out << "threads = " << factory.getNbThreads() << "\n";
+    out << "tolerance = " << factory.getTolerance() << "\n";
+    out << "max iterations = " << maxNbIterations << "\n";
+    out << "iterations = " << nbIterations << "\n";
+    out << "sup error = " << supError << "\n";
+    out << "energy = " << energy << "\n";
+    out << "converged = " << (hasConverged() ? "yes" : "no") << "\n";
+    out << "setup time (s) = " << setupTime << "\n";
+    out << "flow time (s) = " << flowTime << "\n";
+
+    if (!file.commit())
+    {
+        throw(QString("Error in FlowRunner::writeSummary: cannot write %1").arg(fileName));
+    }
+}
+
+int FlowRunner::flowChoiceFromName(const QString &name)
+{
+    for (int flowChoice=FLOW_CENTROID; flowChoice<=FLOW_CENTROID_GAUSS_SEIDEL; ++flowChoice)
+    {
+        if (name == flowName(flowChoice))
+        {
+            return flowChoice;
+        }
+    }
+    throw(QString("Error in FlowRunner::flowChoiceFromName: unknown flow method %1").arg(name));
+}
+
+QString FlowRunner::flowName(int flowChoice)
+{
+    switch(flowChoice)
+    {
+    case FLOW_CENTROID:
+        return "centroid";
+    case FLOW_ENERGY_CONSTANT_STEP:
+        return "constant-step";
+    case FLOW_ENERGY_OPTIMAL_STEP:
+        return "optimal-step";
+    case FLOW_ENERGY_NEWTON:
+        return "newton";
+    case FLOW_MULTIGRID:
+        return "multigrid";
+    case FLOW_CENTROID_ANDERSON:
+        return "centroid-anderson";
+    case FLOW_CENTROID_GAUSS_SEIDEL:
+        return "centroid-gauss-seidel";
+    default:
+        return "none";
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef FLOWRUNNER_H
+#define FLOWRUNNER_H
+
+#include "tools.h"
+#include "grouprepresentation.h"
+#include "liftedgraph.h"
+#include "discreteflowfactory.h"
+#include "flowtelemetry.h"
+
+
+// Runs DiscreteFlowFactory without any widget, for the command line executable HarmonyCli.
+// The setters only record the parameters: run() builds the representations and the mesh, then iterates the flow
+// until the sup error is below the tolerance or maxNbIterations iterations are made.
+
+class FlowRunner
+{
+public:
+    FlowRunner();
+    FlowRunner(const FlowRunner &) = delete;
+    FlowRunner & operator=(FlowRunner) = delete;
+
+    void setGenus(uint genus);
+    void setMeshDepth(uint meshDepth);
+    void setRhoDomain(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists);
+    void setRhoImage(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists);
+    void setFlowChoice(int flowChoice);
+    void setTolerance(double tolerance);
+    void setMaxNbIterations(uint maxNbIterations);
+    void setNbThreads(uint nbThreads);
+    void setAndersonMemory(uint andersonMemory);
+    void setOverRelaxationFactor(double overRelaxationFactor);
+    void setCheckpointFile(const QString &fileName, uint nbIterationsBetweenCheckpoints);
+    void setResumeFile(const QString &fileName);
+    // Records the convergence of the flow made by run() in fileName, every stride iterations (see FlowTelemetry)
+    void setTelemetryFile(const QString &fileName, uint stride, FlowTelemetry::Format format);
+
+    void run();
+    // After run(), moves the image representation to the given coordinates and iterates the flow again from the current values
+    void continueRhoImage(const std::vector<double> &FNLengths, const std::vector<double> &FNTwists, bool usePredictor);
+    // Can be called from any thread while run() or continueRhoImage() is running: cancel() stops the flow after the current
+    // iteration (the results are those of the last iteration), and getProgress() reads the iterations, error and remaining time.
+    void cancel();
+    FlowProgress::Snapshot getProgress() const;
+
+    uint getNbPoints() const;
+    uint getNbIterations() const {return nbIterations;}
+    double getSupError() const {return supError;}
+    double getEnergy() const {return energy;}
+    bool hasConverged() const;
+    double getSetupTime() const {return setupTime;}
+    double getFlowTime() const {return flowTime;}
+
+    void writeValues(const QString &fileName) const;
+    void writeSummary(const QString &fileName) const;
+
+    static int flowChoiceFromName(const QString &name);
+    static QString flowName(int flowChoice);
+
+private:
+    void setUp();
+    void iterateFlow();
+
+    GroupRepresentation<H2Isometry> rhoDomain, rhoImage;
+    LiftedGraphFunctionTriangulated<H2Point, H2Isometry> domainFunction, imageFunction;
+    DiscreteFlowFactory<H2Point, H2Isometry> factory;
+
+    uint genus, meshDepth, maxNbIterations;
+    int flowChoice;
+    std::vector<double> FNLengthsDomain, FNTwistsDomain, FNLengthsImage, FNTwistsImage;
+    QString resumeFileName;
+    FlowTelemetry telemetry;
+    QString telemetryFileName;
+    FlowTelemetry::Format telemetryFormat;
+
+    bool hasRun;
+    uint nbIterations;
+    double supError, energy, setupTime, flowTime;
+};
+
+#endif // FLOWRUNNER_H
@@ -0,0 +1,154 @@
+#include "flowtelemetry.h"
+
+#include <chrono>
+#include <QDataStream>
+#include <QTextStream>
+
+const quint32 FlowTelemetry::magicNumber = 0x48524d54;
+const quint32 FlowTelemetry::formatVersion = 1;
+
+FlowTelemetry::FlowTelemetry(uint bufferCapacity) : buffer(bufferCapacity), stride(1), format(FORMAT_CSV),
+    stopping(false), hasWriteFailed(false), nbDropped(0)
+{
+}
+
+FlowTelemetry::~FlowTelemetry()
+{
+    try
+    {
+        close();
+    }
+    catch(QString errorMessage)
+    {
+        qDebug() << "Error caught (by FlowTelemetry::~FlowTelemetry): " << errorMessage;
+    }
+}
+
+void FlowTelemetry::setStride(uint stride)
+{
+    if (stride == 0)
+    {
+        throw(QString("Error in FlowTelemetry::setStride: the stride must be positive"));
+    }
+    this->stride = stride;
+}
+
+void FlowTelemetry::open(const QString &fileName, Format format)
+{
+    if (isOpen())
+    {
+        throw(QString("Error in FlowTelemetry::open: already open"));
+    }
+
+    file.setFileName(fileName);
+    if (!file.open(format == FORMAT_CSV ? (QIODevice::WriteOnly | QIODevice::Text) : QIODevice::WriteOnly))
+    {
+        throw(QString("Error in FlowTelemetry::open: cannot open %1 (%2)").arg(fileName, file.errorString()));
+    }
+    this->fileName = fileName;
+    this->format = format;
+    stopping = false;
+    hasWriteFailed = false;
+    nbDropped = 0;
+    timer.start();
+    writer = std::thread(&FlowTelemetry::writerLoop, this);
+}
+
+void FlowTelemetry::close()
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    stopping = true;
+    writer.join();
+    file.close();
+
+    if (hasWriteFailed)
+    {
+        throw(QString("Error in FlowTelemetry::close: failed to write %1").arg(fileName));
+    }
+    if (nbDropped != 0)
+    {
+        qDebug() << "Warning in FlowTelemetry::close: " << nbDropped << " records dropped (buffer full)";
+    }
+}
+
+void FlowTelemetry::record(Record record)
+{
+    record.time = timer.nsecsElapsed()*1e-9;
+    if (!buffer.push(record))
+    {
+        ++nbDropped;
+    }
+}
+
+FlowTelemetry::Format FlowTelemetry::formatFromName(const QString &name)
+{
+    if (name == "csv")
+    {
+        return FORMAT_CSV;
+    }
+    if (name == "binary")
+    {
+        return FORMAT_BINARY;
+    }
+    throw(QString("Error in FlowTelemetry::formatFromName: unknown format %1").arg(name));
+}
+
+void FlowTelemetry::writerLoop()
+{
+    QTextStream textOut;
+    QDataStream dataOut;
+    if (format == FORMAT_CSV)
+    {
+        textOut.setDevice(&file);
+        textOut.setRealNumberPrecision(17);
+        textOut << "iteration,energy,energy delta,sup delta,gradient norm,step,time (s)\n";
+    }
+    else
+    {
+        dataOut.setDevice(&file);
+        dataOut.setVersion(QDataStream::Qt_5_0);
+        dataOut.setByteOrder(QDataStream::LittleEndian);
+        dataOut.setFloatingPointPrecision(QDataStream::DoublePrecision);
+        dataOut << magicNumber << formatVersion;
+    }
+
+    Record record;
+    bool isStopping;
+    while (true)
+    {
+        // stopping is read before draining, so that the records pushed before close() are all written
+        isStopping = stopping;
+        while (buffer.pop(record))
+        {
+            if (format == FORMAT_CSV)
+            {
+                textOut << record.iteration << "," << record.energy << "," << record.energyDelta << "," << record.supDelta << ","
+                        << record.gradientNorm << "," << record.step << "," << record.time << "\n";
+            }
+            else
+            {
+                dataOut << quint32(record.iteration) << record.energy << record.energyDelta << record.supDelta
+                        << record.gradientNorm << record.step << record.time;
+            }
+        }
+        if (isStopping)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    if (format == FORMAT_CSV)
+    {
+        textOut.flush();
+        hasWriteFailed = (textOut.status() != QTextStream::Ok);
+    }
+    else
+    {
+        hasWriteFailed = (dataOut.status() != QDataStream::Ok);
+    }
+}
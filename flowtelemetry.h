@@ -0,0 +1,64 @@
+#ifndef FLOWTELEMETRY_H
+#define FLOWTELEMETRY_H
+
+#include <thread>
+#include <atomic>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include "tools.h"
+#include "ringbuffer.h"
+
+
+// Convergence telemetry of a flow (see DiscreteFlowFactory::setTelemetry): every stride iterations, the flow thread
+// records the iteration number, the energy and its change since the previous record (NaN for the first one), the sup delta, the norm of the gradient of the energy,
+// the step of the last iteration and the time since open(). Records go through a RingBuffer, drained by a writer thread
+// into a CSV file or a binary file (magic number, format version, then one quint32 and six doubles per record, little-endian).
+// The flow never waits for the writer: records that do not fit in the buffer are dropped and counted.
+
+class FlowTelemetry
+{
+public:
+    enum Format {FORMAT_CSV, FORMAT_BINARY};
+
+    struct Record
+    {
+        uint iteration;
+        double energy, energyDelta, supDelta, gradientNorm, step, time;
+    };
+
+    explicit FlowTelemetry(uint bufferCapacity = 4096);
+    FlowTelemetry(const FlowTelemetry &) = delete;
+    FlowTelemetry & operator=(FlowTelemetry) = delete;
+    ~FlowTelemetry();
+
+    void setStride(uint stride);
+    uint getStride() const {return stride;}
+
+    void open(const QString &fileName, Format format);
+    void close();
+    bool isOpen() const {return writer.joinable();}
+
+    void record(Record record);
+    unsigned long long getNbDropped() const {return nbDropped;}
+
+    static Format formatFromName(const QString &name);
+
+private:
+    void writerLoop();
+
+    RingBuffer<Record> buffer;
+    uint stride;
+    Format format;
+    QString fileName;
+    QFile file;
+    QElapsedTimer timer;
+    std::thread writer;
+    std::atomic<bool> stopping, hasWriteFailed;
+    std::atomic<unsigned long long> nbDropped;
+
+    static const quint32 magicNumber;
+    static const quint32 formatVersion;
+};
+
+#endif // FLOWTELEMETRY_H
@@ -0,0 +1,498 @@
+#include "h2batch.h"
+#include "h2point.h"
+#include "h2tangentvector.h"
+#include "h2isometry.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define H2BATCH_X86_DISPATCH
+// The Pack helpers are only ever inlined into the AVX2/AVX-512 entry points, so their by-value calling convention does not matter
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// Fused multiply-adds (available with AVX-512) would make the results depend on the instruction set
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+
+namespace
+{
+
+// A Pack holds consecutive values of a buffer; the kernels below only use +, -, *, / and lane-wise square roots on Packs,
+// so with Pack = double they are exactly the scalar code.
+#ifdef H2BATCH_X86_DISPATCH
+typedef double Pack4 __attribute__((vector_size(32)));
+typedef double Pack8 __attribute__((vector_size(64)));
+#endif
+
+// Exponentials and parallel transports are computed by blocks of this many values
+const uint blockSize = 256;
+
+template <typename Pack> inline Pack packLoad(const double *p)
+{
+    Pack out;
+    std::memcpy(&out, p, sizeof(Pack));
+    return out;
+}
+
+template <typename Pack> inline Pack packBroadcast(double value)
+{
+    Pack out;
+    for (uint l=0; l!=sizeof(Pack)/sizeof(double); ++l)
+    {
+        out[l] = value;
+    }
+    return out;
+}
+
+template <> inline double packBroadcast<double>(double value)
+{
+    return value;
+}
+
+template <typename Pack> inline void packStore(double *p, const Pack &value)
+{
+    std::memcpy(p, &value, sizeof(Pack));
+}
+
+template <typename Pack> inline Pack packSqrt(Pack value)
+{
+    for (uint l=0; l!=sizeof(Pack)/sizeof(double); ++l)
+    {
+        value[l] = std::sqrt(value[l]);
+    }
+    return value;
+}
+
+template <> inline double packSqrt<double>(double value)
+{
+    return std::sqrt(value);
+}
+
+
+enum KernelChoice {KERNEL_DISTANCES, KERNEL_DISTANCES_TO_POINT, KERNEL_ISOMETRY_IMAGES, KERNEL_ISOMETRY_IMAGES_ONE_ISOMETRY,
+                   KERNEL_LENGTHS, KERNEL_EXPONENTIATE, KERNEL_PARALLEL_TRANSPORT};
+
+struct KernelArguments
+{
+    uint nbPoints;
+    double t, x0, y0;
+    const double *x1, *y1, *x2, *y2, *ux, *uy, *ax, *ay;
+    double *xOut, *yOut, *vxOut, *vyOut;
+    double *lengths, *coshs, *sinhs;
+};
+
+
+template <typename Pack> struct Kernels
+{
+    static const uint width = sizeof(Pack)/sizeof(double);
+
+    // Both of the following compute s such that d = acosh(1 + s), as in H2Point::distance
+    static void distancesAlgebraic(uint i, const KernelArguments &args)
+    {
+        Pack x1 = packLoad<Pack>(args.x1 + i), y1 = packLoad<Pack>(args.y1 + i);
+        Pack x2 = packLoad<Pack>(args.x2 + i), y2 = packLoad<Pack>(args.y2 + i);
+        Pack dx = x1 - x2, dy = y1 - y2;
+        packStore(args.xOut + i, 2.0 * ((dx*dx + dy*dy) / ((1.0 - (x1*x1 + y1*y1))*(1.0 - (x2*x2 + y2*y2)))));
+    }
+
+    static void distancesToPointAlgebraic(uint i, const KernelArguments &args)
+    {
+        Pack x1 = packBroadcast<Pack>(args.x0), y1 = packBroadcast<Pack>(args.y0);
+        Pack x2 = packLoad<Pack>(args.x2 + i), y2 = packLoad<Pack>(args.y2 + i);
+        Pack dx = x1 - x2, dy = y1 - y2;
+        packStore(args.xOut + i, 2.0 * ((dx*dx + dy*dy) / ((1.0 - (x1*x1 + y1*y1))*(1.0 - (x2*x2 + y2*y2)))));
+    }
+
+    // zOut = u*((z - a)/(1 - conj(a)*z)), as in operator*(const H2Isometry &, const H2Point &)
+    static void isometryImages(uint i, const KernelArguments &args, const Pack &ux, const Pack &uy, const Pack &ax, const Pack &ay)
+    {
+        Pack x = packLoad<Pack>(args.x1 + i), y = packLoad<Pack>(args.y1 + i);
+        Pack numX = x - ax, numY = y - ay;
+        Pack denX = 1.0 - (ax*x + ay*y), denY = -1.0*(ax*y - ay*x);
+        Pack denNorm = denX*denX + denY*denY;
+        Pack qX = (numX*denX + numY*denY)/denNorm, qY = (numY*denX - numX*denY)/denNorm;
+        packStore(args.xOut + i, ux*qX - uy*qY);
+        packStore(args.yOut + i, ux*qY + uy*qX);
+    }
+
+    // L = |t| ||v||, as in H2TangentVector::exponentiate (the sign of t is restored for H2TangentVector::parallelTransport)
+    static void lengths(uint i, const KernelArguments &args)
+    {
+        Pack x = packLoad<Pack>(args.x1 + i), y = packLoad<Pack>(args.y1 + i);
+        Pack vx = packLoad<Pack>(args.x2 + i), vy = packLoad<Pack>(args.y2 + i);
+        packStore(args.lengths + i, std::abs(args.t)*((2.0/(1.0 - (x*x + y*y)))*packSqrt(vx*vx + vy*vy)));
+    }
+
+    // args.lengths holds E = exp(-L), see H2TangentVector::exponentiate
+    static void exponentiateAlgebraic(uint i, const KernelArguments &args, Pack &xOut, Pack &yOut)
+    {
+        Pack x = packLoad<Pack>(args.x1 + i), y = packLoad<Pack>(args.y1 + i);
+        Pack vx = packLoad<Pack>(args.x2 + i), vy = packLoad<Pack>(args.y2 + i);
+        Pack E = packLoad<Pack>(args.lengths + i);
+        Pack absZ = packSqrt(x*x + y*y), absV = packSqrt(vx*vx + vy*vy);
+        double sign = args.t >= 0 ? 1.0 : -1.0;
+        Pack uX = (sign*vx)/absV, uY = (sign*vy)/absV;
+
+        Pack lambda = ((1.0 - absZ) - ((1.0 + absZ)*E))/((1.0 - absZ) + ((1.0 + absZ)*E));
+        Pack a = lambda*absZ + 1.0, b = lambda + absZ;
+        Pack numX = x*a + uX*b, numY = y*a + uY*b;
+        Pack denX = a + (uX*x + uY*y)*b, denY = (uY*x - uX*y)*b;
+        Pack denNorm = denX*denX + denY*denY;
+        xOut = (numX*denX + numY*denY)/denNorm;
+        yOut = (numY*denX - numX*denY)/denNorm;
+    }
+
+    // vOut = v/(cosh(L/2) + u*conj(z)*sinh(L/2))^2, see H2TangentVector::parallelTransport
+    static void parallelTransportAlgebraic(uint i, const KernelArguments &args, Pack &vxOut, Pack &vyOut)
+    {
+        Pack x = packLoad<Pack>(args.x1 + i), y = packLoad<Pack>(args.y1 + i);
+        Pack vx = packLoad<Pack>(args.x2 + i), vy = packLoad<Pack>(args.y2 + i);
+        Pack c = packLoad<Pack>(args.coshs + i), s = packLoad<Pack>(args.sinhs + i);
+        Pack absV = packSqrt(vx*vx + vy*vy);
+        Pack uX = vx/absV, uY = vy/absV;
+
+        Pack thingX = c + (uX*x + uY*y)*s, thingY = (uY*x - uX*y)*s;
+        Pack denX = thingX*thingX - thingY*thingY, denY = 2.0*thingX*thingY;
+        Pack denNorm = denX*denX + denY*denY;
+        vxOut = (vx*denX + vy*denY)/denNorm;
+        vyOut = (vy*denX - vx*denY)/denNorm;
+    }
+};
+
+
+// Runs Kernels<Pack> on the full packs of [begin, end), and the scalar kernels on the remainder
+template <typename Pack, typename PackFunction, typename ScalarFunction>
+inline void forEachPack(uint begin, uint end, PackFunction packFunction, ScalarFunction scalarFunction)
+{
+    uint i = begin;
+    while (i + Kernels<Pack>::width <= end)
+    {
+        packFunction(i);
+        i += Kernels<Pack>::width;
+    }
+    while (i != end)
+    {
+        scalarFunction(i);
+        ++i;
+    }
+}
+
+template <typename Pack> inline void exponentiateAndTransport(uint i, const KernelArguments &args, bool transport)
+{
+    Pack xOut, yOut, vxOut, vyOut;
+    Kernels<Pack>::exponentiateAlgebraic(i, args, xOut, yOut);
+    if (transport)
+    {
+        Kernels<Pack>::parallelTransportAlgebraic(i, args, vxOut, vyOut);
+        packStore(args.vxOut + i, vxOut);
+        packStore(args.vyOut + i, vyOut);
+    }
+    packStore(args.xOut + i, xOut);
+    packStore(args.yOut + i, yOut);
+}
+
+// Algebraic part of the kernels; the transcendental functions are applied by the callers, outside of the AVX code
+template <typename Pack> void runKernel(KernelChoice kernel, const KernelArguments &args)
+{
+    switch (kernel)
+    {
+    case KERNEL_DISTANCES:
+        forEachPack<Pack>(0, args.nbPoints, [&](uint i) {Kernels<Pack>::distancesAlgebraic(i, args);},
+                                            [&](uint i) {Kernels<double>::distancesAlgebraic(i, args);});
+        break;
+
+    case KERNEL_DISTANCES_TO_POINT:
+        forEachPack<Pack>(0, args.nbPoints, [&](uint i) {Kernels<Pack>::distancesToPointAlgebraic(i, args);},
+                                            [&](uint i) {Kernels<double>::distancesToPointAlgebraic(i, args);});
+        break;
+
+    case KERNEL_ISOMETRY_IMAGES:
+        forEachPack<Pack>(0, args.nbPoints,
+                          [&](uint i) {Kernels<Pack>::isometryImages(i, args, packLoad<Pack>(args.ux + i), packLoad<Pack>(args.uy + i),
+                                                                     packLoad<Pack>(args.ax + i), packLoad<Pack>(args.ay + i));},
+                          [&](uint i) {Kernels<double>::isometryImages(i, args, args.ux[i], args.uy[i], args.ax[i], args.ay[i]);});
+        break;
+
+    case KERNEL_ISOMETRY_IMAGES_ONE_ISOMETRY:
+    {
+        Pack ux = packBroadcast<Pack>(*args.ux), uy = packBroadcast<Pack>(*args.uy);
+        Pack ax = packBroadcast<Pack>(*args.ax), ay = packBroadcast<Pack>(*args.ay);
+        forEachPack<Pack>(0, args.nbPoints, [&](uint i) {Kernels<Pack>::isometryImages(i, args, ux, uy, ax, ay);},
+                                            [&](uint i) {Kernels<double>::isometryImages(i, args, *args.ux, *args.uy, *args.ax, *args.ay);});
+        break;
+    }
+
+    case KERNEL_LENGTHS:
+        forEachPack<Pack>(0, args.nbPoints, [&](uint i) {Kernels<Pack>::lengths(i, args);},
+                                            [&](uint i) {Kernels<double>::lengths(i, args);});
+        break;
+
+    case KERNEL_EXPONENTIATE:
+    case KERNEL_PARALLEL_TRANSPORT:
+    {
+        bool transport = (kernel == KERNEL_PARALLEL_TRANSPORT);
+        forEachPack<Pack>(0, args.nbPoints, [&](uint i) {exponentiateAndTransport<Pack>(i, args, transport);},
+                                            [&](uint i) {exponentiateAndTransport<double>(i, args, transport);});
+        break;
+    }
+    }
+}
+
+#ifdef H2BATCH_X86_DISPATCH
+__attribute__((target("avx2"), flatten)) void runKernelAvx2(KernelChoice kernel, const KernelArguments &args)
+{
+    runKernel<Pack4>(kernel, args);
+}
+
+__attribute__((target("avx512f"), flatten)) void runKernelAvx512(KernelChoice kernel, const KernelArguments &args)
+{
+    runKernel<Pack8>(kernel, args);
+}
+#endif
+
+void dispatch(KernelChoice kernel, const KernelArguments &args)
+{
+    switch (H2Batch::getInstructionSet())
+    {
+#ifdef H2BATCH_X86_DISPATCH
+    case H2Batch::INSTRUCTION_SET_AVX512:
+        runKernelAvx512(kernel, args);
+        break;
+
+    case H2Batch::INSTRUCTION_SET_AVX2:
+        runKernelAvx2(kernel, args);
+        break;
+#endif
+
+    default:
+        runKernel<double>(kernel, args);
+        break;
+    }
+}
+
+KernelArguments emptyArguments(uint nbPoints)
+{
+    KernelArguments args = KernelArguments();
+    args.nbPoints = nbPoints;
+    return args;
+}
+
+void distancesFromAlgebraic(const KernelArguments &args)
+{
+    for (uint i=0; i!=args.nbPoints; ++i)
+    {
+        args.xOut[i] = acosh(1.0 + args.xOut[i]);
+    }
+}
+
+void exponentiateOrTransport(KernelChoice kernel, const KernelArguments &args)
+{
+    double lengths[blockSize], coshs[blockSize], sinhs[blockSize];
+    KernelArguments blockArgs = args;
+    blockArgs.lengths = lengths;
+    blockArgs.coshs = coshs;
+    blockArgs.sinhs = sinhs;
+
+    for (uint blockBegin=0; blockBegin < args.nbPoints; blockBegin += blockSize)
+    {
+        blockArgs.nbPoints = std::min(blockSize, args.nbPoints - blockBegin);
+        blockArgs.x1 = args.x1 + blockBegin;
+        blockArgs.y1 = args.y1 + blockBegin;
+        blockArgs.x2 = args.x2 + blockBegin;
+        blockArgs.y2 = args.y2 + blockBegin;
+        blockArgs.xOut = args.xOut + blockBegin;
+        blockArgs.yOut = args.yOut + blockBegin;
+        if (kernel == KERNEL_PARALLEL_TRANSPORT)
+        {
+            blockArgs.vxOut = args.vxOut + blockBegin;
+            blockArgs.vyOut = args.vyOut + blockBegin;
+        }
+
+        dispatch(KERNEL_LENGTHS, blockArgs);
+        for (uint i=0; i!=blockArgs.nbPoints; ++i)
+        {
+            if (kernel == KERNEL_PARALLEL_TRANSPORT)
+            {
+                // L = t ||v|| is signed here
+                coshs[i] = cosh((args.t >= 0 ? lengths[i] : -lengths[i])/2);
+                sinhs[i] = sinh((args.t >= 0 ? lengths[i] : -lengths[i])/2);
+            }
+            lengths[i] = exp(-1.0*lengths[i]);
+        }
+        dispatch(kernel, blockArgs);
+    }
+}
+
+} // namespace
+
+
+
+
+H2Batch::InstructionSet H2Batch::getBestSupportedInstructionSet()
+{
+#ifdef H2BATCH_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return INSTRUCTION_SET_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return INSTRUCTION_SET_AVX2;
+    }
+#endif
+    return INSTRUCTION_SET_SCALAR;
+}
+
+H2Batch::InstructionSet & H2Batch::instructionSetReference()
+{
+    static InstructionSet instructionSet = getBestSupportedInstructionSet();
+    return instructionSet;
+}
+
+H2Batch::InstructionSet H2Batch::getInstructionSet()
+{
+    return instructionSetReference();
+}
+
+void H2Batch::setInstructionSet(InstructionSet instructionSet)
+{
+    if (instructionSet > getBestSupportedInstructionSet())
+    {
+        throw(QString("Error in H2Batch::setInstructionSet: instruction set not supported by this processor"));
+    }
+    instructionSetReference() = instructionSet;
+}
+
+void H2Batch::load(const H2Point *points, uint nbPoints, double *x, double *y)
+{
+    Complex z;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        z = points[i].getDiskCoordinate();
+        x[i] = real(z);
+        y[i] = imag(z);
+    }
+}
+
+void H2Batch::load(const H2TangentVector *vectors, uint nbVectors, double *x, double *y, double *vx, double *vy)
+{
+    Complex z, v;
+    for (uint i=0; i!=nbVectors; ++i)
+    {
+        z = vectors[i].getRoot().getDiskCoordinate();
+        v = vectors[i].getVector();
+        x[i] = real(z);
+        y[i] = imag(z);
+        vx[i] = real(v);
+        vy[i] = imag(v);
+    }
+}
+
+void H2Batch::store(const double *x, const double *y, uint nbPoints, H2Point *pointsOut)
+{
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        pointsOut[i].setDiskCoordinate(Complex(x[i], y[i]));
+    }
+}
+
+void H2Batch::store(const double *x, const double *y, const double *vx, const double *vy, uint nbVectors, H2TangentVector *vectorsOut)
+{
+    for (uint i=0; i!=nbVectors; ++i)
+    {
+        vectorsOut[i] = H2TangentVector(H2Point::fromDiskCoordinate(Complex(x[i], y[i])), Complex(vx[i], vy[i]));
+    }
+}
+
+void H2Batch::distances(uint nbPoints, const double *x1, const double *y1, const double *x2, const double *y2, double *distancesOut)
+{
+    KernelArguments args = emptyArguments(nbPoints);
+    args.x1 = x1;
+    args.y1 = y1;
+    args.x2 = x2;
+    args.y2 = y2;
+    args.xOut = distancesOut;
+    dispatch(KERNEL_DISTANCES, args);
+    distancesFromAlgebraic(args);
+}
+
+void H2Batch::distances(const H2Point &p, uint nbPoints, const double *x, const double *y, double *distancesOut)
+{
+    Complex z = p.getDiskCoordinate();
+    KernelArguments args = emptyArguments(nbPoints);
+    args.x0 = real(z);
+    args.y0 = imag(z);
+    args.x2 = x;
+    args.y2 = y;
+    args.xOut = distancesOut;
+    dispatch(KERNEL_DISTANCES_TO_POINT, args);
+    distancesFromAlgebraic(args);
+}
+
+void H2Batch::isometryImages(uint nbPoints, const double *ux, const double *uy, const double *ax, const double *ay,
+                             const double *x, const double *y, double *xOut, double *yOut)
+{
+    KernelArguments args = emptyArguments(nbPoints);
+    args.ux = ux;
+    args.uy = uy;
+    args.ax = ax;
+    args.ay = ay;
+    args.x1 = x;
+    args.y1 = y;
+    args.xOut = xOut;
+    args.yOut = yOut;
+    dispatch(KERNEL_ISOMETRY_IMAGES, args);
+}
+
+void H2Batch::isometryImages(const H2Isometry &f, uint nbPoints, const double *x, const double *y, double *xOut, double *yOut)
+{
+    Complex u, a;
+    f.getDiskCoordinates(u, a);
+    double ux = real(u), uy = imag(u), ax = real(a), ay = imag(a);
+    KernelArguments args = emptyArguments(nbPoints);
+    args.ux = &ux;
+    args.uy = &uy;
+    args.ax = &ax;
+    args.ay = &ay;
+    args.x1 = x;
+    args.y1 = y;
+    args.xOut = xOut;
+    args.yOut = yOut;
+    dispatch(KERNEL_ISOMETRY_IMAGES_ONE_ISOMETRY, args);
+}
+
+void H2Batch::exponentiate(double t, uint nbVectors, const double *x, const double *y, const double *vx, const double *vy,
+                           double *xOut, double *yOut)
+{
+    KernelArguments args = emptyArguments(nbVectors);
+    args.t = t;
+    args.x1 = x;
+    args.y1 = y;
+    args.x2 = vx;
+    args.y2 = vy;
+    args.xOut = xOut;
+    args.yOut = yOut;
+    exponentiateOrTransport(KERNEL_EXPONENTIATE, args);
+}
+
+void H2Batch::parallelTransport(double t, uint nbVectors, const double *x, const double *y, const double *vx, const double *vy,
+                                double *xOut, double *yOut, double *vxOut, double *vyOut)
+{
+    KernelArguments args = emptyArguments(nbVectors);
+    args.t = t;
+    args.x1 = x;
+    args.y1 = y;
+    args.x2 = vx;
+    args.y2 = vy;
+    args.xOut = xOut;
+    args.yOut = yOut;
+    args.vxOut = vxOut;
+    args.vyOut = vyOut;
+    exponentiateOrTransport(KERNEL_PARALLEL_TRANSPORT, args);
+}
@@ -0,0 +1,53 @@
+#ifndef H2BATCH_H
+#define H2BATCH_H
+
+#include "tools.h"
+
+class H2Point;
+class H2TangentVector;
+class H2Isometry;
+
+
+// Batched versions of the H2Point, H2Isometry and H2TangentVector primitives.
+// Points and tangent vectors are passed as structure-of-arrays buffers of disk coordinates (x[i] + I y[i]).
+// The algebraic part of each kernel runs on AVX2 or AVX-512 registers when the processor supports it, chosen at runtime;
+// transcendental functions are evaluated with the standard library on each lane.
+// All instruction sets give bit-identical results. Output buffers may alias input buffers with the same index.
+
+class H2Batch
+{
+public:
+    enum InstructionSet {INSTRUCTION_SET_SCALAR, INSTRUCTION_SET_AVX2, INSTRUCTION_SET_AVX512};
+
+    static InstructionSet getInstructionSet();
+    static InstructionSet getBestSupportedInstructionSet();
+    static void setInstructionSet(InstructionSet instructionSet);
+
+    static void load(const H2Point *points, uint nbPoints, double *x, double *y);
+    static void load(const H2TangentVector *vectors, uint nbVectors, double *x, double *y, double *vx, double *vy);
+    static void store(const double *x, const double *y, uint nbPoints, H2Point *pointsOut);
+    static void store(const double *x, const double *y, const double *vx, const double *vy, uint nbVectors, H2TangentVector *vectorsOut);
+
+    // distancesOut[i] = d(z1[i], z2[i])
+    static void distances(uint nbPoints, const double *x1, const double *y1, const double *x2, const double *y2, double *distancesOut);
+    // distancesOut[i] = d(p, z[i])
+    static void distances(const H2Point &p, uint nbPoints, const double *x, const double *y, double *distancesOut);
+
+    // zOut[i] = f[i]*z[i], where f[i] has disk coordinates (u[i], a[i])
+    static void isometryImages(uint nbPoints, const double *ux, const double *uy, const double *ax, const double *ay,
+                               const double *x, const double *y, double *xOut, double *yOut);
+    // zOut[i] = f*z[i]
+    static void isometryImages(const H2Isometry &f, uint nbPoints, const double *x, const double *y, double *xOut, double *yOut);
+
+    // zOut[i] = exp(t v[i]), where v[i] is rooted at z[i]
+    static void exponentiate(double t, uint nbVectors, const double *x, const double *y, const double *vx, const double *vy,
+                             double *xOut, double *yOut);
+    // (zOut[i], vOut[i]) = parallel transport of v[i] along t -> exp(t v[i])
+    static void parallelTransport(double t, uint nbVectors, const double *x, const double *y, const double *vx, const double *vy,
+                                  double *xOut, double *yOut, double *vxOut, double *vyOut);
+
+private:
+    static InstructionSet & instructionSetReference();
+};
+
+#endif // H2BATCH_H
@@ -1,17 +1,21 @@
 #include "h2canvasdelegateliftedgraph.h"
 
+#include <cmath>
+
 #include <QMouseEvent>
 #include <QPen>
 #include <QPainter>
+#include <QImage>
 
 #include "h2canvasdelegate.h"
 #include "canvasdelegate.h"
 #include "liftedgraph.h"
 #include "actionhandler.h"
+#include "profiler.h"
 
 
 H2CanvasDelegateLiftedGraph::H2CanvasDelegateLiftedGraph(uint sizeX, uint sizeY, bool leftCanvas, bool rightCanvas, ActionHandler *handler) :
-    H2CanvasDelegate(sizeX, sizeY, leftCanvas, rightCanvas, handler)
+    H2CanvasDelegate(sizeX, sizeY, leftCanvas, rightCanvas, handler), tileCache(nbBackLayers)
 {
     graphColor = "red";
 
@@ -72,16 +76,21 @@ void H2CanvasDelegateLiftedGraph::setRhoPointer(GroupRepresentation<H2Isometry>
 void H2CanvasDelegateLiftedGraph::setGraphPointer(LiftedGraphFunctionTriangulated<H2Point, H2Isometry> *graph)
 {
     this->graph = graph;
+    isTriangleLocatorUpToDate = false;
+    invalidateGraphLayers();
 }
 
 void H2CanvasDelegateLiftedGraph::setIsGraphEmpty(bool isGraphEmpty)
 {
     this->isGraphEmpty = isGraphEmpty;
+    isTriangleLocatorUpToDate = false;
+    invalidateGraphLayers();
 }
 
 void H2CanvasDelegateLiftedGraph::setIsRhoEmpty(bool isRhoEmpty)
 {
     this->isRhoEmpty = isRhoEmpty;
+    tileCache.invalidateLayer(uint(BackLayer::RHO_AXES));
 }
 
 void H2CanvasDelegateLiftedGraph::resetHighlighted()
@@ -102,50 +111,163 @@ void H2CanvasDelegateLiftedGraph::getGraphTriangleIndicesHighlighted(bool &highl
 
 void H2CanvasDelegateLiftedGraph::redrawBack()
 {
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::redrawBack");
     H2CanvasDelegate::redrawBack();
 
-    if (!isGraphEmpty)
+    // The tiles grid has integer coordinates in the plane scaled to pixels, and canvas pixel (0, 0) is grid pixel (gridX, gridY).
+    // Pans only move the canvas along the grid. The subpixel offset of the grid is rounded, so that it stays the same across pans.
+    double x = xMin*scaleX, y = -yMax*scaleY;
+    int gridX = int(std::floor(x)), gridY = int(std::floor(y));
+    double offsetX = Tools::intRound(256.0*(x - gridX))/256.0, offsetY = Tools::intRound(256.0*(y - gridY))/256.0;
+    if (offsetX == 1.0)
+    {
+        ++gridX;
+        offsetX = 0.0;
+    }
+    if (offsetY == 1.0)
     {
-        redrawGraph();
+        ++gridY;
+        offsetY = 0.0;
     }
 
-    if (!isRhoEmpty)
+    Complex u, a;
+    mobius.getDiskCoordinates(u, a);
+    tileCache.setView({scaleX, scaleY, offsetX, offsetY, real(u), imag(u), real(a), imag(a)});
+
+    QRect area(gridX, gridY, sizeX, sizeY);
+    for (auto layer : {BackLayer::GRAPH_TRANSLATES, BackLayer::GRAPH, BackLayer::RHO_AXES})
     {
-        for (const auto & geodesic : rhoAxes)
+        if (isBackLayerShown(layer))
         {
-            drawH2Geodesic(geodesic, "blue", 2);
+            for (const auto &region : tileCache.getRegionsToRender(uint(layer), area))
+            {
+                renderBackLayer(layer, region, offsetX, offsetY);
+            }
+            tileCache.drawLayer(uint(layer), area, *painterBack);
         }
     }
 }
 
-void H2CanvasDelegateLiftedGraph::redrawGraph()
+bool H2CanvasDelegateLiftedGraph::isBackLayerShown(BackLayer layer) const
 {
+    switch(layer)
+    {
+    case BackLayer::GRAPH_TRANSLATES:
+    case BackLayer::GRAPH:
+        return !isGraphEmpty;
 
-    if (filledTriangles)
+    case BackLayer::RHO_AXES:
+        return !isRhoEmpty;
+    }
+    return false;
+}
+
+class H2CanvasDelegateLiftedGraph::RegionView
+{
+public:
+    RegionView(H2CanvasDelegateLiftedGraph &delegate, double xMinRegion, double yMaxRegion, uint sizeXRegion, uint sizeYRegion, QPainter &painter) :
+        delegate(delegate), xMinCanvas(delegate.xMin), yMaxCanvas(delegate.yMax),
+        sizeXCanvas(delegate.sizeX), sizeYCanvas(delegate.sizeY), painterCanvas(delegate.painterBack)
     {
-        redrawFilledGraph();
+        delegate.xMin = xMinRegion;
+        delegate.yMax = yMaxRegion;
+        delegate.sizeX = sizeXRegion;
+        delegate.sizeY = sizeYRegion;
+        delegate.painterBack = &painter;
     }
-    else
+    RegionView(const RegionView &) = delete;
+    RegionView & operator=(RegionView) = delete;
+
+    ~RegionView()
     {
-        redrawNonFilledGraph();
+        delegate.xMin = xMinCanvas;
+        delegate.yMax = yMaxCanvas;
+        delegate.sizeX = sizeXCanvas;
+        delegate.sizeY = sizeYCanvas;
+        delegate.painterBack = painterCanvas;
     }
-}
 
-void H2CanvasDelegateLiftedGraph::redrawNonFilledGraph()
+private:
+    H2CanvasDelegateLiftedGraph &delegate;
+    const double xMinCanvas, yMaxCanvas;
+    const uint sizeXCanvas, sizeYCanvas;
+    QPainter *const painterCanvas;
+};
+
+void H2CanvasDelegateLiftedGraph::renderBackLayer(BackLayer layer, const QRect &region, double offsetX, double offsetY)
 {
-    resetPenBack = false;
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::renderBackLayer");
+    QImage image(region.width(), region.height(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    double xMinRegion = (region.left() + offsetX)/scaleX, yMaxRegion = -(region.top() + offsetY)/scaleY;
 
-    if (showTranslatesAroundVerticesStar)
+    // Filled triangles are rasterized first, straight into the image
+    if (filledTriangles && layer == BackLayer::GRAPH_TRANSLATES)
     {
-        painterBack->setPen(graphColor);
+        rasterizeFilledGraphTranslates(image, xMinRegion, yMaxRegion);
+    }
+    else if (filledTriangles && layer == BackLayer::GRAPH)
+    {
+        rasterizeFilledGraph(image, xMinRegion, yMaxRegion);
     }
 
-    if (showTranslatesAroundVertices)
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    painter.setPen(*penBack);
+    RegionView regionView(*this, xMinRegion, yMaxRegion, region.width(), region.height(), painter);
+
+    switch(layer)
     {
-        if (!showTranslatesAroundVerticesStar)
+    case BackLayer::GRAPH_TRANSLATES:
+        if (!filledTriangles)
+        {
+            redrawNonFilledGraphTranslates();
+        }
+        break;
+
+    case BackLayer::GRAPH:
+        if (filledTriangles)
+        {
+            redrawFilledGraphSides();
+        }
+        else
         {
-            painterBack->setPen(graphTranslatesColor);
+            redrawNonFilledGraph();
         }
+        break;
+
+    case BackLayer::RHO_AXES:
+        redrawRhoAxes();
+        break;
+    }
+
+    painter.end();
+    tileCache.insertTiles(uint(layer), image, region.topLeft());
+}
+
+void H2CanvasDelegateLiftedGraph::invalidateGraphLayers()
+{
+    tileCache.invalidateLayer(uint(BackLayer::GRAPH_TRANSLATES));
+    tileCache.invalidateLayer(uint(BackLayer::GRAPH));
+}
+
+void H2CanvasDelegateLiftedGraph::redrawRhoAxes()
+{
+    for (const auto & geodesic : rhoAxes)
+    {
+        drawH2Geodesic(geodesic, "blue", 2);
+    }
+}
+
+void H2CanvasDelegateLiftedGraph::redrawNonFilledGraphTranslates()
+{
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::redrawNonFilledGraphTranslates");
+    resetPenBack = false;
+
+    painterBack->setPen(showTranslatesAroundVerticesStar ? graphColor : graphTranslatesColor);
+
+    if (showTranslatesAroundVertices)
+    {
         for (const auto & graphArcTranslate : graphArcsTranslatesAroundVertices)
         {
             drawH2GeodesicArc(graphArcTranslate);
@@ -154,20 +276,21 @@ void H2CanvasDelegateLiftedGraph::redrawNonFilledGraph()
 
     if (showTranslatesAroundVertex)
     {
-        if (!showTranslatesAroundVerticesStar)
-        {
-            painterBack->setPen(graphTranslatesColor);
-        }
         for (const auto & graphArcTranslate : graphArcsTranslatesAroundVertex)
         {
             drawH2GeodesicArc(graphArcTranslate);
         }
     }
 
-    if (!showTranslatesAroundVerticesStar)
-    {
-        painterBack->setPen(graphSidesTranslatesColor);
-    }
+    resetPenBack = true;
+}
+
+void H2CanvasDelegateLiftedGraph::redrawNonFilledGraph()
+{
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::redrawNonFilledGraph");
+    resetPenBack = false;
+
+    painterBack->setPen(showTranslatesAroundVerticesStar ? graphColor : graphSidesTranslatesColor);
     if (rightCanvas)
     {
         for (const auto & sideTranslate : graphSidesTranslates)
@@ -216,134 +339,90 @@ void H2CanvasDelegateLiftedGraph::redrawNonFilledGraph()
     resetPenBack = true;
 }
 
-void H2CanvasDelegateLiftedGraph::redrawFilledGraph()
+void H2CanvasDelegateLiftedGraph::rasterizeFilledGraphTranslates(QImage &image, double xMinImage, double yMaxImage)
 {
-    resetPenBack = false;
-
-    QBrush brush;
-    brush.setStyle(Qt::SolidPattern);
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::rasterizeFilledGraphTranslates");
+    triangleRasterizer.clear();
 
-    if (showTranslatesAroundVerticesStar)
+    if (showTranslatesAroundVertices)
     {
-        painterBack->setPen(graphColor);
-        brush.setColor(graphColor);
-        painterBack->setBrush(brush);
+        addFilledTranslates(graphTrianglesTranslatesAroundVertices, xMinImage, yMaxImage);
     }
 
-    if (showTranslatesAroundVertices)
+    if (showTranslatesAroundVertex)
     {
-        if (leftCanvas)
-        {
-            if (!showTranslatesAroundVerticesStar)
-            {
-                painterBack->setPen(graphTranslatesColor);
-                brush.setColor(graphTranslatesColor);
-                painterBack->setBrush(brush);
-            }
-            for (const auto &triangle : graphTrianglesTranslatesAroundVertices)
-            {
-                drawStraightFilledH2Triangle(triangle);
-            }
-        }
+        addFilledTranslates(graphTrianglesTranslatesAroundVertex, xMinImage, yMaxImage);
+    }
 
-        if (rightCanvas)
+    triangleRasterizer.rasterize(reinterpret_cast<uint *>(image.bits()), image.width(), image.height(), image.bytesPerLine()/4);
+}
+
+void H2CanvasDelegateLiftedGraph::rasterizeFilledGraph(QImage &image, double xMinImage, double yMaxImage)
+{
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::rasterizeFilledGraph");
+    triangleRasterizer.clear();
+    triangleRasterizer.reserve(graphTriangles.size());
+
+    if (leftCanvas)
+    {
+        for (const auto &triangle : graphTriangles)
         {
-            if (showTranslatesAroundVerticesStar)
-            {
-                for (uint i=0; i!=graphTrianglesTranslatesAroundVertices.size(); ++i)
-                {
-                    painterBack->setPen(graphTrianglesColors[i % graphTriangles.size()]);
-                    brush.setColor(graphTrianglesColors[i % graphTriangles.size()]);
-                    painterBack->setBrush(brush);
-                    drawStraightFilledH2Triangle(graphTrianglesTranslatesAroundVertices[i]);
-                }
-            }
-            else
-            {
-                for (uint i=0; i!=graphTrianglesTranslatesAroundVertices.size(); ++i)
-                {
-                    painterBack->setPen(graphTrianglesTranslatesColors[i % graphTriangles.size()]);
-                    brush.setColor(graphTrianglesTranslatesColors[i % graphTriangles.size()]);
-                    painterBack->setBrush(brush);
-                    drawStraightFilledH2Triangle(graphTrianglesTranslatesAroundVertices[i]);
-                }
-            }
+            addFilledTriangle(triangle, graphColor, xMinImage, yMaxImage);
         }
     }
 
-    if (showTranslatesAroundVertex)
+    if (rightCanvas)
     {
-        if (leftCanvas)
+        for (uint i=0; i!=graphTriangles.size(); ++i)
         {
-            if (!showTranslatesAroundVerticesStar)
-            {
-                painterBack->setPen(graphTranslatesColor);
-                brush.setColor(graphTranslatesColor);
-                painterBack->setBrush(brush);
-            }
-            for (const auto &triangle : graphTrianglesTranslatesAroundVertex)
-            {
-                drawStraightFilledH2Triangle(triangle);
-            }
+            addFilledTriangle(graphTriangles[i], graphTrianglesColors[i], xMinImage, yMaxImage);
         }
+    }
 
-        if (rightCanvas)
-        {
-            if (showTranslatesAroundVerticesStar)
-            {
-                for (uint i=0; i!=graphTrianglesTranslatesAroundVertex.size(); ++i)
-                {
-                    painterBack->setPen(graphTrianglesColors[i % graphTriangles.size()]);
-                    brush.setColor(graphTrianglesColors[i % graphTriangles.size()]);
-                    painterBack->setBrush(brush);
-                    drawStraightFilledH2Triangle(graphTrianglesTranslatesAroundVertex[i]);
-                }
-            }
-            else
-            {
-                for (uint i=0; i!=graphTrianglesTranslatesAroundVertex.size(); ++i)
-                {
-                    painterBack->setPen(graphTrianglesTranslatesColors[i % graphTriangles.size()]);
-                    brush.setColor(graphTrianglesTranslatesColors[i % graphTriangles.size()]);
-                    painterBack->setBrush(brush);
-                    drawStraightFilledH2Triangle(graphTrianglesTranslatesAroundVertex[i]);
-                }
-            }
-        }
+    triangleRasterizer.rasterize(reinterpret_cast<uint *>(image.bits()), image.width(), image.height(), image.bytesPerLine()/4);
+}
 
-    }
+void H2CanvasDelegateLiftedGraph::addFilledTranslates(const std::vector<H2Triangle> &trianglesTranslates, double xMinImage, double yMaxImage)
+{
+    triangleRasterizer.reserve(triangleRasterizer.getNbTriangles() + trianglesTranslates.size());
 
     if (leftCanvas)
     {
-        if (!showTranslatesAroundVerticesStar)
-        {
-            painterBack->setPen(graphColor);
-            brush.setColor(graphColor);
-            painterBack->setBrush(brush);
-        }
-        for (const auto &triangle : graphTriangles)
+        for (const auto &triangle : trianglesTranslates)
         {
-            drawStraightFilledH2Triangle(triangle);
+            addFilledTriangle(triangle, showTranslatesAroundVerticesStar ? graphColor : graphTranslatesColor, xMinImage, yMaxImage);
         }
     }
 
     if (rightCanvas)
     {
-        for (uint i=0; i!=graphTriangles.size(); ++i)
+        const std::vector<QColor> &colors = showTranslatesAroundVerticesStar ? graphTrianglesColors : graphTrianglesTranslatesColors;
+        for (uint i=0; i!=trianglesTranslates.size(); ++i)
         {
-            brush.setColor(graphTrianglesColors[i]);
-            painterBack->setPen(graphTrianglesColors[i]);
-            painterBack->setBrush(brush);
-            drawStraightFilledH2Triangle(graphTriangles[i]);
+            addFilledTriangle(trianglesTranslates[i], colors[i % graphTriangles.size()], xMinImage, yMaxImage);
         }
     }
+}
 
-    painterBack->setBrush(Qt::NoBrush);
+void H2CanvasDelegateLiftedGraph::addFilledTriangle(const H2Triangle &triangle, const QColor &color, double xMinImage, double yMaxImage)
+{
+    H2Point A, B, C;
+    (mobius*triangle).getPoints(A, B, C);
+    Complex zA = A.getDiskCoordinate();
+    Complex zB = B.getDiskCoordinate();
+    Complex zC = C.getDiskCoordinate();
+    triangleRasterizer.addTriangle((real(zA) - xMinImage)*scaleX, (yMaxImage - imag(zA))*scaleY,
+                                   (real(zB) - xMinImage)*scaleX, (yMaxImage - imag(zB))*scaleY,
+                                   (real(zC) - xMinImage)*scaleX, (yMaxImage - imag(zC))*scaleY, color.rgb());
+}
 
+void H2CanvasDelegateLiftedGraph::redrawFilledGraphSides()
+{
     if (!showTranslatesAroundVerticesStar)
     {
-        painterBack->setPen(graphSidesTranslatesColor);
+        resetPenBack = false;
 
+        painterBack->setPen(graphSidesTranslatesColor);
         for (const auto & straightSideTranslate : graphSidesTranslates)
         {
             drawStraightH2GeodesicArc(straightSideTranslate);
@@ -354,13 +433,14 @@ void H2CanvasDelegateLiftedGraph::redrawFilledGraph()
         {
             drawStraightH2GeodesicArc(side);
         }
-    }
 
-    resetPenBack = true;
+        resetPenBack = true;
+    }
 }
 
 void H2CanvasDelegateLiftedGraph::redrawTop()
 {
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::redrawTop");
     H2CanvasDelegate::redrawTop();
 
     if (isTriangleHighlighted)
@@ -411,9 +491,14 @@ void H2CanvasDelegateLiftedGraph::decideHighlighting(const H2Point &pointUnderMo
     bool update = false;
     if (!isGraphEmpty)
     {
+        if (!isTriangleLocatorUpToDate)
+        {
+            triangleLocator.reset(graph->getValues(), graph->getTrianglesVerticesIndices());
+            isTriangleLocatorUpToDate = true;
+        }
+
         uint index1, index2, index3;
-        H2Triangle triangle;
-        if (graph->triangleContaining(pointUnderMouse, triangle, index1, index2, index3))
+        if (triangleLocator.triangleContaining(pointUnderMouse, index1, index2, index3))
         {
             decideHighlightingTriangle(true, update, index1, index2, index3);
         }
@@ -442,21 +527,27 @@ void H2CanvasDelegateLiftedGraph::setShowTranslates(bool showTranslatesAroundVer
     this->showTranslatesAroundVertex = showTranslatesAroundVertex;
     this->showTranslatesAroundVertices = showTranslatesAroundVertices;
     this->showTranslatesAroundVerticesStar = showTranslatesAroundVerticesStar;
+    invalidateGraphLayers();
 }
 
 void H2CanvasDelegateLiftedGraph::setFilledTriangles(bool filledTriangles)
 {
     this->filledTriangles = filledTriangles;
+    invalidateGraphLayers();
 }
 
 void H2CanvasDelegateLiftedGraph::setGraphColor(const QColor &color)
 {
     graphColor = color;
     initializeColors(color);
+    invalidateGraphLayers();
 }
 
 void H2CanvasDelegateLiftedGraph::updateGraph(bool refreshSidesTranslates)
 {
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::updateGraph");
+    isTriangleLocatorUpToDate = false;
+    invalidateGraphLayers();
     if (!isGraphEmpty)
     {
         updateDomainTrianglesAreas();
@@ -666,11 +757,14 @@ void H2CanvasDelegateLiftedGraph::updateTrianglesTranslatesColors()
 
 void H2CanvasDelegateLiftedGraph::refreshRho()
 {
+    PROFILE_SCOPE("H2CanvasDelegateLiftedGraph::refreshRho");
     if (isRhoEmpty)
     {
         throw(QString("Error in H2CanvasDelegateLiftedGraph::refreshRho::refreshRho: rho empty?"));
     }
 
+    tileCache.invalidateLayer(uint(BackLayer::RHO_AXES));
+
     H2Geodesic axis;
     std::vector<H2Isometry> generatorImages = rho->getGeneratorImages();
     rhoAxes.clear();
@@ -4,6 +4,9 @@
 #include "tools.h"
 #include "canvasdelegate.h"
 #include "h2canvasdelegate.h"
+#include "h2trianglelocator.h"
+#include "canvastilecache.h"
+#include "trianglerasterizer.h"
 
 
 template<typename Point, typename Map> class LiftedGraphFunctionTriangulated;
@@ -23,13 +26,29 @@ private:
 
     void initializeColors(const QColor &graphColor);
 
+    // Layers of the back buffer, from bottom to top, each rendered in cached tiles
+    enum class BackLayer : uint {GRAPH_TRANSLATES, GRAPH, RHO_AXES};
+    static const uint nbBackLayers = 3;
+
+    // Points the drawing functions, which draw in the view of the canvas, at a region of the tiles grid while it lives;
+    // the filled triangles are given the corner (xMinImage, yMaxImage) of the image explicitly
+    class RegionView;
+
     virtual void redrawBack() override;
     virtual void redrawTop() override;
     virtual void resetView() override;
-    void redrawGraph();
+    bool isBackLayerShown(BackLayer layer) const;
+    void renderBackLayer(BackLayer layer, const QRect &region, double offsetX, double offsetY);
+    void invalidateGraphLayers();
+    void redrawNonFilledGraphTranslates();
     void redrawNonFilledGraph();
-    void redrawFilledGraph();
+    void rasterizeFilledGraphTranslates(QImage &image, double xMinImage, double yMaxImage);
+    void rasterizeFilledGraph(QImage &image, double xMinImage, double yMaxImage);
+    void addFilledTriangle(const H2Triangle &triangle, const QColor &color, double xMinImage, double yMaxImage);
+    void addFilledTranslates(const std::vector<H2Triangle> &trianglesTranslates, double xMinImage, double yMaxImage);
+    void redrawFilledGraphSides();
     void redrawFilledGraph2Colors();
+    void redrawRhoAxes();
 
     virtual void mouseMove(int x, int y, Qt::MouseButton button, Qt::MouseButtons buttons) override;
     virtual void enter() override;
@@ -65,8 +84,14 @@ private:
     bool isTriangleHighlighted;
     uint triangleGraphIndex1, triangleGraphIndex2, triangleGraphIndex3;
     H2Triangle triangleHighlighted;
+    // Rebuilt on the first mouse move after the graph is updated
+    H2TriangleLocator triangleLocator;
+    bool isTriangleLocatorUpToDate;
     QColor highlightColor;
 
+    CanvasTileCache tileCache;
+    TriangleRasterizer triangleRasterizer;
+
     bool showTranslatesAroundVertex, showTranslatesAroundVertices, showTranslatesAroundVerticesStar;
     bool filledTriangles;
 
@@ -1,6 +1,7 @@
 #include "h2discreteflowfactorythread.h"
 #include "discreteflowfactory.h"
 #include "actionhandler.h"
+#include "profiler.h"
 
 
 H2DiscreteFlowFactoryThread::H2DiscreteFlowFactoryThread(GroupRepresentation<H2Isometry> *rhoDomain,
@@ -13,6 +14,7 @@ H2DiscreteFlowFactoryThread::H2DiscreteFlowFactoryThread(GroupRepresentation<H2I
 }
 void H2DiscreteFlowFactoryThread::run()
 {
+    Profiler::setThreadName("flow thread");
     factory.run();
 }
 
@@ -36,6 +38,11 @@ uint H2DiscreteFlowFactoryThread::getNbIterations() const
     return factory.getNbIterations();
 }
 
+FlowProgress::Snapshot H2DiscreteFlowFactoryThread::getProgress() const
+{
+    return factory.getProgress();
+}
+
 double H2DiscreteFlowFactoryThread::getSupError() const
 {
     return factory.getSupError();
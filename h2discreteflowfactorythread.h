@@ -28,6 +28,8 @@ public:
     double getSupError() const;
     double getTolerance() const;
     void setFlowChoice(int flowChoice);
+    // Can be called while the flow is running
+    FlowProgress::Snapshot getProgress() const;
 
 public slots:
     void run();
@@ -111,7 +111,7 @@ bool H2Mesh::triangleContaining(const H2Point &point, H2Triangle &outputTriangle
 
 H2Point H2Mesh::getH2Point(uint index) const
 {
-    return subdivisions[meshPoints.at(index)->subdivisionIndex].points->at(meshPoints.at(index)->indexInSubdivision);
+    return subdivisions[meshPoints.at(index)->subdivisionIndex].points.at(meshPoints.at(index)->indexInSubdivision);
 }
 
 H2Triangle H2Mesh::getH2Triangle(uint index1, uint index2, uint index3) const
@@ -1,5 +1,6 @@
 #include "h2meshconstructor.h"
 #include "triangularsubdivision.h"
+#include "profiler.h"
 //#include <Eigen/Dense>
 //#include <Eigen/LU>
 
@@ -12,6 +13,7 @@ H2MeshConstructor::H2MeshConstructor(H2Mesh *mesh) :
     boundaryPoints(&(mesh->boundaryPoints)), vertexPoints(&(mesh->vertexPoints)), steinerPoints(&(mesh->steinerPoints)),
     triangulater(H2PolygonTriangulater(&(mesh->fundamentalDomain)))
 {
+    PROFILE_SCOPE("H2MeshConstructor");
     mesh->fundamentalSteinerDomain = triangulater.steinerPolygon;
     nbVertices = mesh->fundamentalDomain.nbVertices();
     nbSteinerPoints = mesh->fundamentalSteinerDomain.getTotalNbSteinerPoints();
@@ -38,6 +40,7 @@ H2MeshConstructor::H2MeshConstructor(H2Mesh *mesh) :
 
 void H2MeshConstructor::createPoints()
 {
+    PROFILE_SCOPE("H2MeshConstructor::createPoints");
     createRegularPoints();
     createCutPoints();
     createBoundaryPoints();
@@ -47,6 +50,7 @@ void H2MeshConstructor::createPoints()
 
 void H2MeshConstructor::createNeighbors()
 {
+    PROFILE_SCOPE("H2MeshConstructor::createNeighbors");
     createInteriorNeighbors();
     createCutNeighbors();
     createSideNeighbors();
@@ -57,6 +61,7 @@ void H2MeshConstructor::createNeighbors()
 
 void H2MeshConstructor::createSubdivisions()
 {
+    PROFILE_SCOPE("H2MeshConstructor::createSubdivisions");
     std::vector<H2Triangle> triangles = triangulater.getTriangles();
     mesh->triangles = triangulater.getTriangulationTriangles();
 
@@ -453,6 +458,7 @@ void H2MeshConstructor::createExteriorNeighbors()
 
 void H2MeshConstructor::reorganizeNeighbors()
 {
+    PROFILE_SCOPE("H2MeshConstructor::reorganizeNeighbors");
     std::vector<std::tuple< H2Point, H2Point, uint> > triples;
     uint index,i;
     std::vector<uint> indicesOld, indicesNew;
@@ -558,6 +564,7 @@ void H2MeshConstructor::reorganizeNeighbors()
 
 void H2MeshConstructor::createWeightsCentroid()
 {
+    PROFILE_SCOPE("H2MeshConstructor::createWeightsCentroid");
     uint i=0;
     H2Point basept;
     std::vector<H2Point> neighbors;
@@ -586,6 +593,7 @@ void H2MeshConstructor::createWeightsCentroidNaive()
 
 void H2MeshConstructor::createWeightsEnergy()
 {
+    PROFILE_SCOPE("H2MeshConstructor::createWeightsEnergy");
     uint i=0;
     H2Point basept;
     std::vector<H2Point> neighbors;
@@ -819,6 +827,7 @@ void H2MeshConstructor::createMeshExteriorIndices()
 
 bool H2MeshConstructor::runTests() const
 {
+    PROFILE_SCOPE("H2MeshConstructor::runTests");
     bool b1 = checkNumberOfMeshPoints();
     bool b2 = checkForDuplicateNeighbors();
     bool b4 = checkNumberOfNeighbors();
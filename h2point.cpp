@@ -1,6 +1,7 @@
 #include "h2point.h"
 #include "h2isometry.h"
 #include "h2tangentvector.h"
+#include "h2batch.h"
 //#include <Eigen/Dense>
 
 H2Point::H2Point()
@@ -138,12 +139,28 @@ double H2Point::cotangentAngle(const H2Point &previous, const H2Point &point, co
     return x/y;
 }
 
+void H2Point::distancesToNeighbors(const std::vector<H2Point> &neighbors, std::vector<double> &outputDistances) const
+{
+    // The coordinates are loaded by blocks on the stack, so that the only allocation is the output
+    const uint blockSize = 32;
+    double X[blockSize], Y[blockSize];
+    uint nbNeighbors = neighbors.size(), n;
+    outputDistances.resize(nbNeighbors);
+    for (uint begin=0; begin<nbNeighbors; begin+=blockSize)
+    {
+        n = std::min(blockSize, nbNeighbors - begin);
+        H2Batch::load(neighbors.data() + begin, n, X, Y);
+        H2Batch::distances(*this, n, X, Y, outputDistances.data() + begin);
+    }
+}
+
 void H2Point::computeWeightsCentroid(const std::vector<H2Point> &neighbors, std::vector<double> &outputWeights) const
 {
     H2Point previous, current, next;
     std::vector<double> preNeighborWeights;
     double r, tan1, tan2, sum;
     std::vector<double> distances;
+    distancesToNeighbors(neighbors, distances);
 
     outputWeights.clear();
     previous = neighbors.back();
@@ -151,8 +168,7 @@ void H2Point::computeWeightsCentroid(const std::vector<H2Point> &neighbors, std:
     next = neighbors[1];
     for(std::vector<H2Point>::size_type j=1; j+1<neighbors.size(); ++j)
     {
-        r=H2Point::distance(*this, current);
-        distances.push_back(r);
+        r=distances[j-1];
         tan1=H2Point::tanHalfAngle(current, *this, next);
         tan2=H2Point::tanHalfAngle(previous, *this, current);
         preNeighborWeights.push_back((1.0/(3*M_PI*r))*(tan1 + tan2));
@@ -160,16 +176,14 @@ void H2Point::computeWeightsCentroid(const std::vector<H2Point> &neighbors, std:
         current = next;
         next = neighbors[j+1];
     }
-    r=H2Point::distance(*this, current);
-    distances.push_back(r);
+    r=distances[neighbors.size()-2];
     tan1=H2Point::tanHalfAngle(current, *this, next);
     tan2=H2Point::tanHalfAngle(previous, *this, current);
     preNeighborWeights.push_back((1.0/(3*M_PI*r))*(tan1 + tan2));
     previous = current;
     current = next;
     next = neighbors.front();
-    r=H2Point::distance(*this, current);
-    distances.push_back(r);
+    r=distances.back();
     tan1=H2Point::tanHalfAngle(current, *this, next);
     tan2=H2Point::tanHalfAngle(previous, *this, current);
     preNeighborWeights.push_back((1.0/(3*M_PI*r))*(tan1 + tan2));
@@ -190,8 +204,9 @@ void H2Point::computeWeightsCentroid(const std::vector<H2Point> &neighbors, std:
 void H2Point::computeWeightsCentroidNaive(const std::vector<H2Point> &neighbors, std::vector<double> &outputWeights) const
 {
     H2Point previous, current, next;
-    double r, sum;
+    double sum;
     std::vector<double> distances, angles;
+    distancesToNeighbors(neighbors, distances);
 
     outputWeights.clear();
     previous = neighbors.back();
@@ -199,23 +214,17 @@ void H2Point::computeWeightsCentroidNaive(const std::vector<H2Point> &neighbors,
     next = neighbors[1];
     for(std::vector<H2Point>::size_type j=1; j+1<neighbors.size(); ++j)
     {
-        r=H2Point::distance(*this, current);
-        distances.push_back(r);
         angles.push_back(H2Point::angle(previous, *this, next)/2.0);
 
         previous = current;
         current = next;
         next = neighbors[j+1];
     }
-    r=H2Point::distance(*this, current);
-    distances.push_back(r);
     angles.push_back(H2Point::angle(previous, *this, next)/2.0);
 
     previous = current;
     current = next;
     next = neighbors.front();
-    r=H2Point::distance(*this, current);
-    distances.push_back(r);
     angles.push_back(H2Point::angle(previous, *this, next)/2.0);
 
     for (std::vector<double>::size_type l=0; l<angles.size(); ++l)
@@ -287,27 +296,20 @@ H2Point H2Point::centroid(const std::vector<H2Point> &points, const std::vector<
     {
         throw(QString("Error in  H2Point::centroid: number of points does not match number of weights"));
     }
+    return centroid(points.data(), weights.data(), points.size());
+}
 
-    std::vector<double> X, Y, Z;
+H2Point H2Point::centroid(const H2Point *points, const double *weights, uint nbPoints)
+{
     double a, b, c, xOut=0.0, yOut=0.0, zOut=0.0;
     H2Point out;
-    X.reserve(points.size());
-    Y.reserve(points.size());
-    Z.reserve(points.size());
-
-    for(const auto & p: points)
-    {
-        p.getHyperboloidCoordinate(a,b,c);
-        X.push_back(a);
-        Y.push_back(b);
-        Z.push_back(c);
-    }
 
-    for(unsigned int j=0; j<points.size(); ++j)
+    for(uint j=0; j!=nbPoints; ++j)
     {
-        xOut += weights[j]*X[j];
-        yOut += weights[j]*Y[j];
-        zOut += weights[j]*Z[j];
+        points[j].getHyperboloidCoordinate(a,b,c);
+        xOut += weights[j]*a;
+        yOut += weights[j]*b;
+        zOut += weights[j]*c;
     }
 
     double s = 1/ sqrt(zOut*zOut - xOut*xOut - yOut*yOut);
@@ -320,44 +322,23 @@ H2Point H2Point::centroid(const std::vector<H2Point> &points, const std::vector<
 void H2Point::weightedLogSum(const std::vector<H2Point> &points, const std::vector<double> &weights, H2TangentVector &output) const
 {
     assert (points.size() == weights.size());
-    output = H2TangentVector(*this);
-
-    std::vector<double> distancesToNeighbors;
-    std::vector<Complex> directionsToNeighbors;
+    weightedLogSum(points.data(), weights.data(), points.size(), output);
+}
 
+void H2Point::weightedLogSum(const H2Point *points, const double *weights, uint nbPoints, H2TangentVector &output) const
+{
+    // Same arithmetic as summing weights[i]*H2TangentVector(*this, points[i]), in a single pass and without allocation
+    Complex out(0.0, 0.0), u;
+    double scale = 1.0 - norm(z), d;
 
-    for (uint i=0; i<points.size(); ++i)
+    for (uint i=0; i!=nbPoints; ++i)
     {
-        output = output + weights[i]*H2TangentVector(*this,points[i]);
-        distancesToNeighbors.push_back(H2Point::distance(*this, points[i]));
-        directionsToNeighbors.push_back((H2TangentVector(*this,points[i])).getVector());
+        u = (points[i].z - z)/(1.0 - conj(z)*points[i].z);
+        d = distance(*this, points[i]);
+        out = out + weights[i]*(d*u*scale/(2.0*std::abs(u)));
     }
 
-
-    std::vector<double> affineWeights, energyWeights;
-    this->computeWeightsEnergy(points, energyWeights);
-    this->computeWeightsCentroid(points, affineWeights);
-
-/*
-    std::cout << std::endl;
-    std::cout << "point =" << *this << std::endl;
-
-    std::cout << "weights = " << weights << std::endl;
-    std::cout << "affine weights = " << affineWeights << std::endl;
-    std::cout << "energy weights = " << energyWeights << std::endl;
-
-    std::cout << "distances to neighbors = " << distancesToNeighbors << std::endl;
-    std::cout << "directions to neighbors = " << directionsToNeighbors << std::endl;
-
-    std::cout << "output length = " << output.length() << std::endl;
-    std::cout << "output direction = " << output.getVector() << std::endl;
-
-    H2Point C = centroid(points, affineWeights);
-    H2TangentVector toC(*this, C);
-    std::cout << "distance to centroid = " << toC.length() << std::endl;
-    std::cout << "direction to centroid = " << toC.getVector() << std::endl;
-    */
-
+    output = H2TangentVector(*this, out);
 }
 
 bool H2Point::compareAngles(const H2Point &p1, const H2Point &p2)
@@ -24,6 +24,7 @@ public:
     void setHyperboloidProjection(Complex z);
     void setKleinCoordinate(Complex z);
     void weightedLogSum(const std::vector<H2Point> & points, const std::vector<double> & weights, H2TangentVector & output) const;
+    void weightedLogSum(const H2Point *points, const double *weights, uint nbPoints, H2TangentVector & output) const;
 
     static double distance(const H2Point & p1, const H2Point & p2);
     static H2Point midpoint(const H2Point & p1, const H2Point & p2);
@@ -31,6 +32,7 @@ public:
     static double tanHalfAngle(const H2Point &previous, const H2Point &point, const H2Point &next);
     static double cotangentAngle(const H2Point &previous, const H2Point &point, const H2Point &next);
     static H2Point centroid(const std::vector<H2Point> & points, const std::vector<double> & weights);
+    static H2Point centroid(const H2Point *points, const double *weights, uint nbPoints);
 
     static H2Point proportionalPoint(const H2Point & p1, const H2Point & p2, const double & s);
     static H2Point exponentialMap(const H2Point &p0, const Complex &u, const double &t);
@@ -43,6 +45,8 @@ public:
 
     bool compareAngles(const H2Point &p1, const H2Point &p2);
 private:
+    void distancesToNeighbors(const std::vector<H2Point> &neighbors, std::vector<double> &outputDistances) const;
+
     Complex z;
 };
 
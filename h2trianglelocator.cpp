@@ -0,0 +1,177 @@
+#include "h2trianglelocator.h"
+
+#include <cmath>
+
+#include "h2point.h"
+
+
+H2TriangleLocator::H2TriangleLocator()
+{
+    clear();
+}
+
+void H2TriangleLocator::clear()
+{
+    pointsX.clear();
+    pointsY.clear();
+    trianglesVerticesIndices.clear();
+    cellsOffsets.clear();
+    cellsTriangles.clear();
+    xMin = 0.0;
+    yMin = 0.0;
+    xMax = 0.0;
+    yMax = 0.0;
+    cellsScale = 0.0;
+    nbCellsX = 0;
+    nbCellsY = 0;
+}
+
+bool H2TriangleLocator::isEmpty() const
+{
+    return trianglesVerticesIndices.empty();
+}
+
+void H2TriangleLocator::reset(const std::vector<H2Point> &points, const std::vector<uint> &trianglesVerticesIndices)
+{
+    if (trianglesVerticesIndices.size() % 3 != 0)
+    {
+        throw(QString("Error in H2TriangleLocator::reset: the number of vertices indices is not a multiple of 3"));
+    }
+
+    clear();
+    if (trianglesVerticesIndices.empty())
+    {
+        return;
+    }
+    this->trianglesVerticesIndices = trianglesVerticesIndices;
+
+    uint nbPoints = points.size();
+    pointsX.resize(nbPoints);
+    pointsY.resize(nbPoints);
+    Complex z;
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        z = points[i].getKleinCoordinate();
+        pointsX[i] = real(z);
+        pointsY[i] = imag(z);
+    }
+
+    xMin = yMin = 1.0;
+    xMax = yMax = -1.0;
+    for (auto index : trianglesVerticesIndices)
+    {
+        if (index >= nbPoints)
+        {
+            throw(QString("Error in H2TriangleLocator::reset: vertex index out of range"));
+        }
+        xMin = std::min(xMin, pointsX[index]);
+        xMax = std::max(xMax, pointsX[index]);
+        yMin = std::min(yMin, pointsY[index]);
+        yMax = std::max(yMax, pointsY[index]);
+    }
+
+    // Square cells, about as many as triangles
+    uint nbTriangles = trianglesVerticesIndices.size()/3;
+    double width = std::max(xMax - xMin, yMax - yMin);
+    double cellSize = (width > 0.0) ? width/std::ceil(std::sqrt(nbTriangles)) : 1.0;
+    cellsScale = 1.0/cellSize;
+    nbCellsX = 1 + uint((xMax - xMin)*cellsScale);
+    nbCellsY = 1 + uint((yMax - yMin)*cellsScale);
+
+    // Count the triangles of each cell, then fill the cells in increasing order of triangles
+    uint t, i, j, iMin, iMax, jMin, jMax, a, b, c;
+    std::vector<uint> trianglesCells(4*nbTriangles);
+    cellsOffsets.assign(nbCellsX*nbCellsY + 1, 0);
+    for (t=0; t!=nbTriangles; ++t)
+    {
+        a = trianglesVerticesIndices[3*t];
+        b = trianglesVerticesIndices[3*t + 1];
+        c = trianglesVerticesIndices[3*t + 2];
+        iMin = cellX(std::min(pointsX[a], std::min(pointsX[b], pointsX[c])));
+        iMax = cellX(std::max(pointsX[a], std::max(pointsX[b], pointsX[c])));
+        jMin = cellY(std::min(pointsY[a], std::min(pointsY[b], pointsY[c])));
+        jMax = cellY(std::max(pointsY[a], std::max(pointsY[b], pointsY[c])));
+        trianglesCells[4*t] = iMin;
+        trianglesCells[4*t + 1] = iMax;
+        trianglesCells[4*t + 2] = jMin;
+        trianglesCells[4*t + 3] = jMax;
+        for (j=jMin; j<=jMax; ++j)
+        {
+            for (i=iMin; i<=iMax; ++i)
+            {
+                ++cellsOffsets[j*nbCellsX + i + 1];
+            }
+        }
+    }
+    for (i=0; i!=nbCellsX*nbCellsY; ++i)
+    {
+        cellsOffsets[i + 1] += cellsOffsets[i];
+    }
+
+    cellsTriangles.resize(cellsOffsets.back());
+    std::vector<uint> cellsNextPositions(cellsOffsets.begin(), cellsOffsets.end() - 1);
+    for (t=0; t!=nbTriangles; ++t)
+    {
+        for (j=trianglesCells[4*t + 2]; j<=trianglesCells[4*t + 3]; ++j)
+        {
+            for (i=trianglesCells[4*t]; i<=trianglesCells[4*t + 1]; ++i)
+            {
+                cellsTriangles[cellsNextPositions[j*nbCellsX + i]++] = t;
+            }
+        }
+    }
+}
+
+uint H2TriangleLocator::cellX(double x) const
+{
+    return std::min(uint((x - xMin)*cellsScale), nbCellsX - 1);
+}
+
+uint H2TriangleLocator::cellY(double y) const
+{
+    return std::min(uint((y - yMin)*cellsScale), nbCellsY - 1);
+}
+
+bool H2TriangleLocator::triangleContainsInKleinModel(uint triangleIndex, double x, double y) const
+{
+    uint a = trianglesVerticesIndices[3*triangleIndex];
+    uint b = trianglesVerticesIndices[3*triangleIndex + 1];
+    uint c = trianglesVerticesIndices[3*triangleIndex + 2];
+
+    // The point is inside (or on a side) if it is not strictly on both sides of the lines through the sides
+    double d1 = (pointsX[b] - pointsX[a])*(y - pointsY[a]) - (pointsY[b] - pointsY[a])*(x - pointsX[a]);
+    double d2 = (pointsX[c] - pointsX[b])*(y - pointsY[b]) - (pointsY[c] - pointsY[b])*(x - pointsX[b]);
+    double d3 = (pointsX[a] - pointsX[c])*(y - pointsY[c]) - (pointsY[a] - pointsY[c])*(x - pointsX[c]);
+    bool hasNegative = (d1 < 0.0) || (d2 < 0.0) || (d3 < 0.0);
+    bool hasPositive = (d1 > 0.0) || (d2 > 0.0) || (d3 > 0.0);
+    return !(hasNegative && hasPositive);
+}
+
+bool H2TriangleLocator::triangleContaining(const H2Point &point, uint &index1Out, uint &index2Out, uint &index3Out) const
+{
+    if (isEmpty())
+    {
+        return false;
+    }
+
+    Complex z = point.getKleinCoordinate();
+    double x = real(z), y = imag(z);
+    if (x < xMin || x > xMax || y < yMin || y > yMax)
+    {
+        return false;
+    }
+
+    uint cell = cellY(y)*nbCellsX + cellX(x), t;
+    for (uint k=cellsOffsets[cell]; k!=cellsOffsets[cell + 1]; ++k)
+    {
+        t = cellsTriangles[k];
+        if (triangleContainsInKleinModel(t, x, y))
+        {
+            index1Out = trianglesVerticesIndices[3*t];
+            index2Out = trianglesVerticesIndices[3*t + 1];
+            index3Out = trianglesVerticesIndices[3*t + 2];
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,40 @@
+#ifndef H2TRIANGLELOCATOR_H
+#define H2TRIANGLELOCATOR_H
+
+#include "tools.h"
+
+class H2Point;
+
+
+// Point location among many small triangles of H^2, e.g. all the triangles of a lifted graph.
+// Geodesic triangles are Euclidean triangles in the Klein model: the triangles are sorted into a uniform grid over
+// the bounding box of their vertices in the Klein model, with about one triangle per cell, and a query only tests
+// the triangles of the cell of the point. Each cell lists its triangles in increasing order, so that a point on a
+// common side is found in the first triangle containing it.
+class H2TriangleLocator
+{
+public:
+    H2TriangleLocator();
+
+    // Triangle t has vertices points[trianglesVerticesIndices[3t]], points[trianglesVerticesIndices[3t+1]], points[trianglesVerticesIndices[3t+2]]
+    void reset(const std::vector<H2Point> &points, const std::vector<uint> &trianglesVerticesIndices);
+    void clear();
+    bool isEmpty() const;
+
+    bool triangleContaining(const H2Point &point, uint &index1Out, uint &index2Out, uint &index3Out) const;
+
+private:
+    uint cellX(double x) const;
+    uint cellY(double y) const;
+    bool triangleContainsInKleinModel(uint triangleIndex, double x, double y) const;
+
+    std::vector<double> pointsX, pointsY;
+    std::vector<uint> trianglesVerticesIndices;
+
+    // The triangles meeting cell (i, j) are cellsTriangles[cellsOffsets[c]], ..., cellsTriangles[cellsOffsets[c+1] - 1], with c = j*nbCellsX + i
+    double xMin, yMin, xMax, yMax, cellsScale;
+    uint nbCellsX, nbCellsY;
+    std::vector<uint> cellsOffsets, cellsTriangles;
+};
+
+#endif // H2TRIANGLELOCATOR_H
@@ -0,0 +1,296 @@
+#include <random>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#include <fstream>
+#endif
+
+#include "tools.h"
+#include "h2point.h"
+#include "h2isometry.h"
+#include "h2tangentvector.h"
+#include "h2mesh.h"
+#include "fenchelnielsenconstructor.h"
+#include "liftedgraph.h"
+#include "discreteflowiterator.h"
+#include "discreteflowmultigrid.h"
+#include "allocationcounter.h"
+#include "flowchoice.h"
+#include "flowrunner.h"
+
+// Microbenchmarks of the geometry kernels, of one iteration of each flow and of the mesh construction,
+// for each genus and mesh depth in the given ranges. Writes one tab separated row per benchmark on the standard output:
+// name, genus, depth, number of mesh points, number of repetitions, nanoseconds per operation, mesh points per second,
+// heap allocations per operation (only when compiled with HARMONY_COUNT_ALLOCATIONS, "-" otherwise), resident memory in kB (Linux only).
+// The kernels do not depend on the mesh and have genus and depth 0.
+// Example: HarmonyBenchmark --genus-max 2 --depth-min 4 --depth-max 6 > benchmark.txt
+
+static double minTime = 0.5;
+
+static double getResidentMemory()
+{
+#ifdef Q_OS_LINUX
+    std::ifstream statm("/proc/self/statm");
+    unsigned long long size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident*(sysconf(_SC_PAGESIZE)/1024.0);
+#else
+    return 0.0;
+#endif
+}
+
+static void writeRow(const std::string &name, uint genus, uint depth, uint nbPoints, unsigned long long nbRepetitions,
+                     double totalTime, unsigned long long nbAllocations)
+{
+    double timePerOperation = totalTime/nbRepetitions;
+    std::cout << name << "\t" << genus << "\t" << depth << "\t" << nbPoints << "\t" << nbRepetitions << "\t"
+              << timePerOperation*1e9 << "\t" << (nbPoints == 0 ? 0.0 : nbPoints/timePerOperation) << "\t";
+    if (AllocationCounter::isEnabled())
+    {
+        std::cout << double(nbAllocations)/nbRepetitions;
+    }
+    else
+    {
+        std::cout << "-";
+    }
+    std::cout << "\t" << getResidentMemory() << std::endl;
+}
+
+// Calls f() until minTime is elapsed; each call makes nbOperationsPerCall operations
+template <typename Function> static void benchmarkKernel(const std::string &name, Function f, uint nbOperationsPerCall)
+{
+    QElapsedTimer timer;
+    unsigned long long nbCalls = 0, nbAllocationsBefore = AllocationCounter::getNbAllocations();
+    timer.start();
+    do
+    {
+        f();
+        ++nbCalls;
+    } while (timer.nsecsElapsed()*1e-9 < minTime);
+    double totalTime = timer.nsecsElapsed()*1e-9;
+    writeRow(name, 0, 0, 0, nbCalls*nbOperationsPerCall, totalTime, AllocationCounter::getNbAllocations() - nbAllocationsBefore);
+}
+
+static void benchmarkKernels()
+{
+    const uint nbItems = 1024, nbNeighbors = 6;
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> radius(0.0, 0.9), angle(0.0, 2*M_PI);
+
+    std::vector<H2Point> points(nbItems + nbNeighbors);
+    std::vector<H2Isometry> isometries(nbItems);
+    std::vector<double> weights(nbNeighbors);
+    for (auto & point : points)
+    {
+        point.setDiskCoordinate(std::polar(radius(generator), angle(generator)));
+    }
+    for (auto & isometry : isometries)
+    {
+        isometry.setDiskCoordinates(std::polar(1.0, angle(generator)), std::polar(radius(generator), angle(generator)));
+    }
+    for (auto & weight : weights)
+    {
+        weight = 0.5 + radius(generator);
+    }
+
+    // The results are accumulated in sink so that the computations are not optimized away
+    volatile double sink = 0.0;
+    double sum;
+    H2TangentVector v;
+
+    benchmarkKernel("H2Point::distance", [&]()
+    {
+        sum = 0.0;
+        for (uint i=0; i!=nbItems; ++i)
+        {
+            sum += H2Point::distance(points[i], points[i + 1]);
+        }
+        sink = sink + sum;
+    }, nbItems);
+
+    benchmarkKernel("H2Isometry composition", [&]()
+    {
+        H2Isometry f = isometries[0];
+        for (uint i=1; i!=nbItems; ++i)
+        {
+            f = isometries[i]*f;
+        }
+        sink = sink + real((f*points[0]).getDiskCoordinate());
+    }, nbItems - 1);
+
+    benchmarkKernel("H2Isometry action", [&]()
+    {
+        sum = 0.0;
+        for (uint i=0; i!=nbItems; ++i)
+        {
+            sum += real((isometries[i]*points[i]).getDiskCoordinate());
+        }
+        sink = sink + sum;
+    }, nbItems);
+
+    benchmarkKernel("H2Point::weightedLogSum (6 points)", [&]()
+    {
+        sum = 0.0;
+        for (uint i=0; i!=nbItems; ++i)
+        {
+            points[i].weightedLogSum(points.data() + i + 1, weights.data(), nbNeighbors, v);
+            sum += v.lengthSquared();
+        }
+        sink = sink + sum;
+    }, nbItems);
+
+    benchmarkKernel("H2Point::centroid (6 points)", [&]()
+    {
+        sum = 0.0;
+        for (uint i=0; i!=nbItems; ++i)
+        {
+            sum += real(H2Point::centroid(points.data() + i, weights.data(), nbNeighbors).getDiskCoordinate());
+        }
+        sink = sink + sum;
+    }, nbItems);
+}
+
+static void coordinates(uint genus, bool isImage, std::vector<double> &FNLengthsOut, std::vector<double> &FNTwistsOut)
+{
+    FNLengthsOut.resize(3*genus - 3);
+    FNTwistsOut.resize(3*genus - 3);
+    for (uint k=0; k!=FNLengthsOut.size(); ++k)
+    {
+        FNLengthsOut[k] = isImage ? 1.5 + 0.5*(k % 3) : 2.0 + 0.25*(k % 3);
+        FNTwistsOut[k] = isImage ? 0.3 - 0.1*(k % 2) : 0.1*(k % 2);
+    }
+}
+
+static void benchmarkMesh(uint genus, uint depth, uint nbThreads)
+{
+    std::vector<double> FNLengths, FNTwists;
+    coordinates(genus, false, FNLengths, FNTwists);
+    FenchelNielsenConstructor FNDomain(FNLengths, FNTwists);
+    GroupRepresentation<H2Isometry> rhoDomain = FNDomain.getRepresentation();
+    coordinates(genus, true, FNLengths, FNTwists);
+    FenchelNielsenConstructor FNImage(FNLengths, FNTwists);
+    GroupRepresentation<H2Isometry> rhoImage = FNImage.getRepresentation();
+
+    QElapsedTimer timer;
+    unsigned long long nbRepetitions = 0, nbAllocationsBefore = AllocationCounter::getNbAllocations();
+    uint nbPoints = 0;
+    timer.start();
+    do
+    {
+        H2Mesh mesh(rhoDomain, depth);
+        nbPoints = mesh.nbPoints();
+        ++nbRepetitions;
+    } while (timer.nsecsElapsed()*1e-9 < minTime);
+    writeRow("H2Mesh construction", genus, depth, nbPoints, nbRepetitions, timer.nsecsElapsed()*1e-9,
+             AllocationCounter::getNbAllocations() - nbAllocationsBefore);
+
+    LiftedGraphFunctionTriangulated<H2Point, H2Isometry> domainFunction(rhoDomain, depth);
+    LiftedGraphFunctionTriangulated<H2Point, H2Isometry> imageFunction(domainFunction, rhoImage);
+    DiscreteFlowIterator<H2Point, H2Isometry> iterator(&imageFunction);
+    iterator.setNbThreads(nbThreads);
+    DiscreteFlowMultigrid<H2Point, H2Isometry> multigrid(&iterator, domainFunction, rhoDomain, rhoImage);
+    nbPoints = domainFunction.getNbPoints();
+
+    // Each repetition is the first iteration from the piecewise linear initial values, so that the cost does not depend on the convergence.
+    // The workspaces are allocated by a first iteration that is not counted.
+    double totalTime;
+    unsigned long long nbAllocations;
+    int flowChoice;
+    auto iterateOnce = [&]()
+    {
+        iterator.reset();
+        nbAllocationsBefore = AllocationCounter::getNbAllocations();
+        timer.start();
+        if (flowChoice == FLOW_MULTIGRID)
+        {
+            multigrid.iterate();
+        }
+        else
+        {
+            iterator.iterate(flowChoice);
+        }
+    };
+    for (flowChoice=FLOW_CENTROID; flowChoice<=FLOW_CENTROID_GAUSS_SEIDEL; ++flowChoice)
+    {
+        iterateOnce();
+        totalTime = 0.0;
+        nbRepetitions = 0;
+        nbAllocations = 0;
+        do
+        {
+            iterateOnce();
+            totalTime += timer.nsecsElapsed()*1e-9;
+            nbAllocations += AllocationCounter::getNbAllocations() - nbAllocationsBefore;
+            ++nbRepetitions;
+        } while (totalTime < minTime);
+        writeRow("DiscreteFlowIterator::iterate " + FlowRunner::flowName(flowChoice).toStdString(), genus, depth, nbPoints,
+                 nbRepetitions, totalTime, nbAllocations);
+    }
+}
+
+static uint parseUint(const QCommandLineParser &parser, const QString &optionName)
+{
+    bool ok;
+    uint n = parser.value(optionName).toUInt(&ok);
+    if (!ok)
+    {
+        throw(QString("Error in HarmonyBenchmark: cannot read --%1 %2").arg(optionName, parser.value(optionName)));
+    }
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("HarmonyBenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the geometry kernels, the flow iterations and the mesh construction.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"genus-min", "Smallest genus.", "g", "2"},
+        {"genus-max", "Largest genus.", "g", "4"},
+        {"depth-min", "Smallest mesh depth.", "depth", "2"},
+        {"depth-max", "Largest mesh depth.", "depth", "7"},
+        {"min-time", "Minimum time spent on each benchmark, in seconds.", "seconds", "0.5"},
+        {"threads", "Number of threads of the flow iterations.", "N", "1"},
+        {"no-kernels", "Do not time the geometry kernels."}
+    });
+    parser.process(application);
+
+    try
+    {
+        bool ok;
+        minTime = parser.value("min-time").toDouble(&ok);
+        if (!ok)
+        {
+            throw(QString("Error in HarmonyBenchmark: cannot read --min-time %1").arg(parser.value("min-time")));
+        }
+        uint genusMin = std::max(2u, parseUint(parser, "genus-min")), genusMax = parseUint(parser, "genus-max");
+        uint depthMin = parseUint(parser, "depth-min"), depthMax = parseUint(parser, "depth-max");
+        uint nbThreads = parseUint(parser, "threads");
+
+        std::cout << "benchmark\tgenus\tdepth\tmesh points\trepetitions\tns/op\tmesh points/s\tallocations/op\tresident memory (kB)" << std::endl;
+        if (!parser.isSet("no-kernels"))
+        {
+            benchmarkKernels();
+        }
+        for (uint genus=genusMin; genus<=genusMax; ++genus)
+        {
+            for (uint depth=depthMin; depth<=depthMax; ++depth)
+            {
+                benchmarkMesh(genus, depth, nbThreads);
+            }
+        }
+    }
+    catch(QString errorMessage)
+    {
+        qDebug() << "Error caught (by HarmonyBenchmark): " << errorMessage;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <QCoreApplication>
+
+#include "tools.h"
+#include "h2point.h"
+#include "h2isometry.h"
+#include "fenchelnielsenconstructor.h"
+#include "liftedgraph.h"
+#include "discreteflowiterator.h"
+#include "discreteflowmultigrid.h"
+#include "flowchoice.h"
+
+// Consistency checks of the flows. Prints one line per check on the standard output, and exits with status 1 if one fails.
+
+// Runs the Newton flow and the multigrid flow to convergence on a surface of genus 2 with a mesh of depth 3, and compares their energies.
+// The lifts of a point on the boundary of the fundamental domain are one unknown: a multigrid cycle breaking their symmetry
+// converges to a wrong, lower energy.
+static bool checkMultigrid()
+{
+    FenchelNielsenConstructor FNDomain({2.0, 2.5, 3.0}, {0.0, 0.0, 0.0});
+    GroupRepresentation<H2Isometry> rhoDomain = FNDomain.getRepresentation();
+    FenchelNielsenConstructor FNImage({1.5, 3.0, 2.2}, {0.4, 0.0, -0.1});
+    GroupRepresentation<H2Isometry> rhoImage = FNImage.getRepresentation();
+
+    uint depth = 3, nbIterations = 15;
+    LiftedGraphFunctionTriangulated<H2Point, H2Isometry> domainFunction(rhoDomain, depth);
+    LiftedGraphFunctionTriangulated<H2Point, H2Isometry> imageFunction(domainFunction, rhoImage);
+    DiscreteFlowIterator<H2Point, H2Isometry> newtonIterator(&imageFunction), multigridIterator(&imageFunction);
+    DiscreteFlowMultigrid<H2Point, H2Isometry> multigrid(&multigridIterator, domainFunction, rhoDomain, rhoImage);
+
+    multigrid.runFullMultigrid();
+    for (uint n=0; n!=nbIterations; ++n)
+    {
+        newtonIterator.iterate(FLOW_ENERGY_NEWTON);
+        multigrid.iterate();
+    }
+    newtonIterator.updateEnergy();
+    multigridIterator.updateEnergy();
+
+    double newtonEnergy = newtonIterator.getEnergy(), multigridEnergy = multigridIterator.getEnergy();
+    bool isPassed = std::abs(multigridEnergy - newtonEnergy) <= 1e-8*newtonEnergy;
+    std::cout << "Multigrid check: energy " << multigridEnergy << ", Newton energy " << newtonEnergy
+              << (isPassed ? ", passed" : ", FAILED") << std::endl;
+    return isPassed;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("HarmonyCheck");
+
+    bool isPassed = true;
+    try
+    {
+        std::cout.precision(12);
+        isPassed = checkMultigrid() && isPassed;
+    }
+    catch(QString errorMessage)
+    {
+        qDebug() << "Error caught (by HarmonyCheck): " << errorMessage;
+        return 1;
+    }
+
+    return isPassed ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+#include <csignal>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "tools.h"
+#include "flowrunner.h"
+#include "parametersweep.h"
+#include "flowcontinuation.h"
+#include "profiler.h"
+
+// Headless flow runner: computes a discrete harmonic map without any widget, and writes
+// <output>_values.txt (the domain and image of every mesh point) and <output>_summary.txt (parameters, errors and timings).
+// Example:
+// HarmonyCli --genus 2 --depth 5 --domain-lengths 2,2.5,3 --domain-twists 0,0,0 --image-lengths 1.5,3,2.2 --image-twists 0.4,0,-0.1 --flow multigrid
+//
+// With --sweep file, runs a ParameterSweep instead and writes <output>_sweep.txt. Each line of the file reads
+// "domain lengths;domain twists;image lengths;image twists" (numbers separated by commas), and is a point of the sweep;
+// with --grid-steps or --random-samples, the file has two lines, the minimum and maximum corners of the box.
+//
+// With --path file, runs a FlowContinuation along a path of image representations and writes <output>_path.txt.
+// Each line of the file reads "image lengths;image twists" and is a point of the path; with --path-steps, the file has two lines,
+// the ends of a linear path.
+
+static std::vector<double> parseNumbers(const QString &string, const QString &optionName)
+{
+    std::vector<double> numbers;
+    bool ok;
+    for (const auto & item : string.split(',', QString::SkipEmptyParts))
+    {
+        numbers.push_back(item.toDouble(&ok));
+        if (!ok)
+        {
+            throw(QString("Error in HarmonyCli: cannot read --%1 %2").arg(optionName, string));
+        }
+    }
+    return numbers;
+}
+
+static uint parseUint(const QString &string, const QString &optionName)
+{
+    bool ok;
+    uint n = string.toUInt(&ok);
+    if (!ok)
+    {
+        throw(QString("Error in HarmonyCli: cannot read --%1 %2").arg(optionName, string));
+    }
+    return n;
+}
+
+static void checkOptionsSet(const QCommandLineParser &parser, const QStringList &names)
+{
+    for (const auto & name : names)
+    {
+        if (!parser.isSet(name))
+        {
+            throw(QString("Error in HarmonyCli: missing option --%1").arg(name));
+        }
+    }
+}
+
+static double parseDouble(const QString &string, const QString &optionName)
+{
+    bool ok;
+    double x = string.toDouble(&ok);
+    if (!ok)
+    {
+        throw(QString("Error in HarmonyCli: cannot read --%1 %2").arg(optionName, string));
+    }
+    return x;
+}
+
+static std::vector<QStringList> readFieldsFile(const QString &fileName, int nbFields)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        throw(QString("Error in HarmonyCli: cannot open %1").arg(fileName));
+    }
+
+    std::vector<QStringList> out;
+    QTextStream in(&file);
+    QString line;
+    QStringList fields;
+    while (!in.atEnd())
+    {
+        line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+        {
+            continue;
+        }
+        fields = line.split(';');
+        if (fields.size() != nbFields)
+        {
+            throw(QString("Error in HarmonyCli: expected %1 fields separated by ';' in %2").arg(QString::number(nbFields), fileName));
+        }
+        out.push_back(fields);
+    }
+    return out;
+}
+
+static std::vector<ParameterSweep::Coordinates> readSweepFile(const QString &fileName)
+{
+    std::vector<ParameterSweep::Coordinates> out;
+    ParameterSweep::Coordinates coordinates;
+    for (const auto & fields : readFieldsFile(fileName, 4))
+    {
+        coordinates.FNLengthsDomain = parseNumbers(fields[0], "sweep");
+        coordinates.FNTwistsDomain = parseNumbers(fields[1], "sweep");
+        coordinates.FNLengthsImage = parseNumbers(fields[2], "sweep");
+        coordinates.FNTwistsImage = parseNumbers(fields[3], "sweep");
+        out.push_back(coordinates);
+    }
+    return out;
+}
+
+// The first Ctrl-C stops the flow after the current iteration, and the output files are written as usual; the second one kills HarmonyCli
+static FlowRunner *interruptibleRunner = nullptr;
+
+static void interruptRunner(int)
+{
+    std::signal(SIGINT, SIG_DFL);
+    interruptibleRunner->cancel();
+}
+
+// Installs interruptRunner for a runner, and restores the default handler when destroyed, even if the run throws
+class RunnerInterruption
+{
+public:
+    explicit RunnerInterruption(FlowRunner &runner)
+    {
+        interruptibleRunner = &runner;
+        std::signal(SIGINT, interruptRunner);
+    }
+    RunnerInterruption(const RunnerInterruption &) = delete;
+    RunnerInterruption & operator=(RunnerInterruption) = delete;
+
+    ~RunnerInterruption()
+    {
+        std::signal(SIGINT, SIG_DFL);
+        interruptibleRunner = nullptr;
+    }
+};
+
+static void runInterruptibly(FlowRunner &runner)
+{
+    RunnerInterruption interruption(runner);
+    runner.run();
+}
+
+static int runFlow(const QCommandLineParser &parser)
+{
+    FlowRunner runner;
+
+    if (parser.isSet("resume"))
+    {
+        runner.setResumeFile(parser.value("resume"));
+    }
+    else
+    {
+        checkOptionsSet(parser, {"genus", "depth", "domain-lengths", "domain-twists", "image-lengths", "image-twists", "flow"});
+        runner.setGenus(parseUint(parser.value("genus"), "genus"));
+        runner.setMeshDepth(parseUint(parser.value("depth"), "depth"));
+        runner.setRhoDomain(parseNumbers(parser.value("domain-lengths"), "domain-lengths"),
+                            parseNumbers(parser.value("domain-twists"), "domain-twists"));
+        runner.setRhoImage(parseNumbers(parser.value("image-lengths"), "image-lengths"),
+                           parseNumbers(parser.value("image-twists"), "image-twists"));
+    }
+    if (parser.isSet("flow"))
+    {
+        runner.setFlowChoice(FlowRunner::flowChoiceFromName(parser.value("flow")));
+    }
+
+    runner.setTolerance(parseDouble(parser.value("tolerance"), "tolerance"));
+    runner.setMaxNbIterations(parseUint(parser.value("max-iterations"), "max-iterations"));
+    runner.setNbThreads(parseUint(parser.value("threads"), "threads"));
+    runner.setAndersonMemory(parseUint(parser.value("anderson-memory"), "anderson-memory"));
+    runner.setOverRelaxationFactor(parseDouble(parser.value("over-relaxation"), "over-relaxation"));
+    if (parser.isSet("checkpoint"))
+    {
+        runner.setCheckpointFile(parser.value("checkpoint"), parseUint(parser.value("checkpoint-every"), "checkpoint-every"));
+    }
+    if (parser.isSet("telemetry"))
+    {
+        runner.setTelemetryFile(parser.value("telemetry"), parseUint(parser.value("telemetry-stride"), "telemetry-stride"),
+                                FlowTelemetry::formatFromName(parser.value("telemetry-format")));
+    }
+
+    runInterruptibly(runner);
+
+    QString prefix = parser.value("output");
+    runner.writeValues(prefix + "_values.txt");
+    runner.writeSummary(prefix + "_summary.txt");
+
+    std::cout << "Iterated " << runner.getNbIterations() << " times (for " << runner.getNbPoints() << " mesh points). "
+              << "Final error: " << runner.getSupError() << ". Setup time: " << runner.getSetupTime()
+              << "s. Flow time: " << runner.getFlowTime() << "s." << std::endl;
+
+    return runner.hasConverged() ? 0 : 2;
+}
+
+static int runSweep(const QCommandLineParser &parser)
+{
+    checkOptionsSet(parser, {"genus", "depth", "flow"});
+    ParameterSweep sweep(parseUint(parser.value("genus"), "genus"), parseUint(parser.value("depth"), "depth"),
+                         FlowRunner::flowChoiceFromName(parser.value("flow")));
+    sweep.setTolerance(parseDouble(parser.value("tolerance"), "tolerance"));
+    sweep.setMaxNbIterations(parseUint(parser.value("max-iterations"), "max-iterations"));
+    sweep.setNbJobs(parseUint(parser.value("jobs"), "jobs"));
+    sweep.setAndersonMemory(parseUint(parser.value("anderson-memory"), "anderson-memory"));
+    sweep.setOverRelaxationFactor(parseDouble(parser.value("over-relaxation"), "over-relaxation"));
+
+    std::vector<ParameterSweep::Coordinates> coordinates = readSweepFile(parser.value("sweep"));
+    if (parser.isSet("grid-steps") || parser.isSet("random-samples"))
+    {
+        if (coordinates.size() != 2)
+        {
+            throw(QString("Error in HarmonyCli: a grid or random sweep needs exactly the two corners of the box"));
+        }
+        if (parser.isSet("grid-steps"))
+        {
+            sweep.addGrid(coordinates[0], coordinates[1], parseUint(parser.value("grid-steps"), "grid-steps"));
+        }
+        else
+        {
+            sweep.addRandomSamples(coordinates[0], coordinates[1], parseUint(parser.value("random-samples"), "random-samples"),
+                    parseUint(parser.value("seed"), "seed"));
+        }
+    }
+    else
+    {
+        for (const auto & point : coordinates)
+        {
+            sweep.addPoint(point);
+        }
+    }
+
+    sweep.run();
+    sweep.writeTable(parser.value("output") + "_sweep.txt");
+
+    uint nbConverged = 0;
+    for (const auto & result : sweep.getResults())
+    {
+        nbConverged += result.hasConverged ? 1 : 0;
+    }
+    std::cout << "Swept " << sweep.getNbPoints() << " points, " << nbConverged << " converged. "
+              << "Wall time: " << sweep.getWallTime() << "s." << std::endl;
+
+    return (nbConverged == sweep.getNbPoints()) ? 0 : 2;
+}
+
+static int runPath(const QCommandLineParser &parser)
+{
+    checkOptionsSet(parser, {"genus", "depth", "domain-lengths", "domain-twists", "flow"});
+    FlowContinuation continuation(parseUint(parser.value("genus"), "genus"), parseUint(parser.value("depth"), "depth"),
+                                  FlowRunner::flowChoiceFromName(parser.value("flow")));
+    continuation.setRhoDomain(parseNumbers(parser.value("domain-lengths"), "domain-lengths"),
+                              parseNumbers(parser.value("domain-twists"), "domain-twists"));
+    continuation.setTolerance(parseDouble(parser.value("tolerance"), "tolerance"));
+    continuation.setMaxNbIterations(parseUint(parser.value("max-iterations"), "max-iterations"));
+    continuation.setNbThreads(parseUint(parser.value("threads"), "threads"));
+    continuation.setAndersonMemory(parseUint(parser.value("anderson-memory"), "anderson-memory"));
+    continuation.setOverRelaxationFactor(parseDouble(parser.value("over-relaxation"), "over-relaxation"));
+    continuation.setWarmStart(!parser.isSet("cold-start"));
+    continuation.setUsePredictor(parser.isSet("predictor"));
+
+    std::vector<QStringList> points = readFieldsFile(parser.value("path"), 2);
+    if (parser.isSet("path-steps"))
+    {
+        if (points.size() != 2)
+        {
+            throw(QString("Error in HarmonyCli: a linear path needs exactly its two ends"));
+        }
+        continuation.addLinearPath(parseNumbers(points[0][0], "path"), parseNumbers(points[0][1], "path"),
+                parseNumbers(points[1][0], "path"), parseNumbers(points[1][1], "path"), parseUint(parser.value("path-steps"), "path-steps"));
+    }
+    else
+    {
+        for (const auto & fields : points)
+        {
+            continuation.addPathPoint(parseNumbers(fields[0], "path"), parseNumbers(fields[1], "path"));
+        }
+    }
+
+    continuation.run();
+    continuation.writeTable(parser.value("output") + "_path.txt");
+
+    uint nbConverged = 0, nbIterations = 0;
+    for (const auto & result : continuation.getResults())
+    {
+        nbConverged += result.hasConverged ? 1 : 0;
+        nbIterations += result.nbIterations;
+    }
+    std::cout << "Followed " << continuation.getNbPathPoints() << " points, " << nbConverged << " converged, "
+              << nbIterations << " iterations in total. Wall time: " << continuation.getWallTime() << "s." << std::endl;
+
+    return (nbConverged == continuation.getNbPathPoints()) ? 0 : 2;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("HarmonyCli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Computes discrete equivariant harmonic maps between hyperbolic surfaces.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"genus", "Genus of the surface.", "g"},
+        {"depth", "Depth of the mesh.", "depth"},
+        {"domain-lengths", "Fenchel-Nielsen lengths of the domain, separated by commas.", "lengths"},
+        {"domain-twists", "Fenchel-Nielsen twists of the domain, separated by commas.", "twists"},
+        {"image-lengths", "Fenchel-Nielsen lengths of the image, separated by commas.", "lengths"},
+        {"image-twists", "Fenchel-Nielsen twists of the image, separated by commas.", "twists"},
+        {"flow", "Flow method: centroid, constant-step, optimal-step, newton, multigrid, centroid-anderson or centroid-gauss-seidel.", "method"},
+        {"anderson-memory", "Number of previous iterates used by the centroid-anderson flow.", "N", "5"},
+        {"over-relaxation", "Over-relaxation factor in [1, 2) of the centroid-gauss-seidel flow, 0 for an automatic estimate.", "w", "0"},
+        {"tolerance", "Stop when the sup error is below this tolerance.", "tolerance", "1e-10"},
+        {"max-iterations", "Maximum number of iterations.", "N", "100000"},
+        {"threads", "Number of threads (0 for one per core).", "N", "0"},
+        {"output", "Prefix of the output files.", "prefix", "harmony"},
+        {"checkpoint", "Write a checkpoint to this file.", "file"},
+        {"checkpoint-every", "Number of iterations between checkpoints.", "N", "100"},
+        {"trace", "Write the timeline of the run in this file, in the Chrome trace event format (needs HARMONY_PROFILE).", "file"},
+        {"telemetry", "Record the convergence of the flow (energy, errors, step, time) in this file.", "file"},
+        {"telemetry-stride", "Number of iterations between telemetry records.", "N", "1"},
+        {"telemetry-format", "Format of the telemetry file: csv or binary.", "format", "csv"},
+        {"resume", "Resume the run saved in this checkpoint file (genus, depth and coordinates are read from it).", "file"},
+        {"sweep", "Run a parameter sweep over the FN coordinates read from this file.", "file"},
+        {"grid-steps", "Sweep a grid with N values for each coordinate that varies.", "N"},
+        {"random-samples", "Sweep N random points.", "N"},
+        {"seed", "Seed of the random samples.", "seed", "0"},
+        {"jobs", "Number of flows run at the same time by a sweep (0 for one per core).", "N", "0"},
+        {"path", "Follow a path of image FN coordinates read from this file.", "file"},
+        {"path-steps", "Follow the linear path with N steps between the two points of the path file.", "N"},
+        {"predictor", "Extrapolate the previous two points of the path to start each flow."},
+        {"cold-start", "Start each point of the path from the initial piecewise linear map instead of the previous one."}
+    });
+    parser.process(application);
+
+    try
+    {
+        if (parser.isSet("trace") && !Profiler::isEnabled())
+        {
+            throw(QString("Error in HarmonyCli: --trace needs a build with HARMONY_PROFILE defined (see harmonycore.pri)"));
+        }
+        Profiler::setThreadName("main thread");
+        int out;
+        if (parser.isSet("sweep"))
+        {
+            out = runSweep(parser);
+        }
+        else
+        {
+            out = parser.isSet("path") ? runPath(parser) : runFlow(parser);
+        }
+        if (parser.isSet("trace"))
+        {
+            Profiler::writeChromeTrace(parser.value("trace"));
+        }
+        return out;
+    }
+    catch(QString errorMessage)
+    {
+        qDebug() << "Error caught (by HarmonyCli): " << errorMessage;
+        return 1;
+    }
+}
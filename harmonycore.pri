@@ -0,0 +1,107 @@
+#-------------------------------------------------
+#
+# Sources without widgets, shared by Harmony.pro and HarmonyCli.pro
+#
+#-------------------------------------------------
+
+CONFIG += c++11
+CONFIG += thread
+
+# Count the heap allocations made by DiscreteFlowIterator::iterate (debug)
+# DEFINES += HARMONY_COUNT_ALLOCATIONS
+
+# Scoped timers of the hot paths, saved in the Chrome trace event format (see profiler.h)
+# DEFINES += HARMONY_PROFILE
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/discretegroup.cpp \
+    $$PWD/topologicalsurface.cpp \
+    $$PWD/grouprepresentation.cpp \
+    $$PWD/sl2cmatrix.cpp \
+    $$PWD/cp1point.cpp \
+    $$PWD/h3point.cpp \
+    $$PWD/h2point.cpp \
+    $$PWD/sl2rmatrix.cpp \
+    $$PWD/h2geodesic.cpp \
+    $$PWD/planarline.cpp \
+    $$PWD/circle.cpp \
+    $$PWD/h2polygon.cpp \
+    $$PWD/h2isometry.cpp \
+    $$PWD/h3isometry.cpp \
+    $$PWD/tools.cpp \
+    $$PWD/fenchelnielsenconstructor.cpp \
+    $$PWD/h2mesh.cpp \
+    $$PWD/h2triangle.cpp \
+    $$PWD/h2trianglelocator.cpp \
+    $$PWD/trianglerasterizer.cpp \
+    $$PWD/h2polygontriangulater.cpp \
+    $$PWD/h2meshconstructor.cpp \
+    $$PWD/h2meshpoint.cpp \
+    $$PWD/word.cpp \
+    $$PWD/liftedgraph.cpp \
+    $$PWD/triangularsubdivision.cpp \
+    $$PWD/fundamentaldomaingenerator.cpp \
+    $$PWD/h2tangentvector.cpp \
+    $$PWD/discreteflowfactory.cpp \
+    $$PWD/discreteflowiterator.cpp \
+    $$PWD/discreteflowmultigrid.cpp \
+    $$PWD/threadpool.cpp \
+    $$PWD/h2batch.cpp \
+    $$PWD/allocationcounter.cpp \
+    $$PWD/flowcheckpoint.cpp \
+    $$PWD/flowrunner.cpp \
+    $$PWD/parametersweep.cpp \
+    $$PWD/flowcontinuation.cpp \
+    $$PWD/flowtelemetry.cpp \
+    $$PWD/profiler.cpp \
+    $$PWD/flowprogress.cpp
+
+HEADERS += \
+    $$PWD/discretegroup.h \
+    $$PWD/topologicalsurface.h \
+    $$PWD/grouprepresentation.h \
+    $$PWD/sl2cmatrix.h \
+    $$PWD/cp1point.h \
+    $$PWD/h3point.h \
+    $$PWD/h2point.h \
+    $$PWD/sl2rmatrix.h \
+    $$PWD/h2geodesic.h \
+    $$PWD/planarline.h \
+    $$PWD/circle.h \
+    $$PWD/h2polygon.h \
+    $$PWD/h2isometry.h \
+    $$PWD/h3isometry.h \
+    $$PWD/tools.h \
+    $$PWD/types.h \
+    $$PWD/fenchelnielsenconstructor.h \
+    $$PWD/h2mesh.h \
+    $$PWD/h2triangle.h \
+    $$PWD/h2trianglelocator.h \
+    $$PWD/trianglerasterizer.h \
+    $$PWD/h2polygontriangulater.h \
+    $$PWD/h2meshconstructor.h \
+    $$PWD/h2meshpoint.h \
+    $$PWD/word.h \
+    $$PWD/liftedgraph.h \
+    $$PWD/triangularsubdivision.h \
+    $$PWD/fundamentaldomaingenerator.h \
+    $$PWD/h2tangentvector.h \
+    $$PWD/discreteflowfactory.h \
+    $$PWD/discreteflowiterator.h \
+    $$PWD/discreteflowmultigrid.h \
+    $$PWD/threadpool.h \
+    $$PWD/h2batch.h \
+    $$PWD/allocationcounter.h \
+    $$PWD/flowchoice.h \
+    $$PWD/flowcheckpoint.h \
+    $$PWD/flowrunner.h \
+    $$PWD/parametersweep.h \
+    $$PWD/flowcontinuation.h \
+    $$PWD/ringbuffer.h \
+    $$PWD/flowtelemetry.h \
+    $$PWD/profiler.h \
+    $$PWD/flowprogress.h \
+    $$PWD/triplebuffer.h
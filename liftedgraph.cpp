@@ -1,18 +1,13 @@
 #include "liftedgraph.h"
 
+#include <map>
+
 #include "h2mesh.h"
 
 
 void LiftedGraph::cloneCopyAssignImpl(const LiftedGraph *other)
 {
-    Gamma = other->Gamma;
-    nbBoundaryPoints = other->nbBoundaryPoints;
-    nbPoints = other->nbPoints;
-    neighborsIndices = other->neighborsIndices;
-    neighborsWeightsCentroid = other->neighborsWeightsCentroid;
-    neighborsWeightsEnergy = other->neighborsWeightsEnergy;
-    boundaryPointsNeighborsPairings = other->boundaryPointsNeighborsPairings;
-    boundaryPointsPartnersIndices = other->boundaryPointsPartnersIndices;
+    topology = other->topology;
 }
 
 void LiftedGraph::cloneCopyAssign(const LiftedGraph *other)
@@ -21,16 +16,8 @@ void LiftedGraph::cloneCopyAssign(const LiftedGraph *other)
 }
 
 
-LiftedGraph::LiftedGraph(const LiftedGraph &other)
+LiftedGraph::LiftedGraph(const LiftedGraph &other) : topology(other.topology)
 {
-    Gamma = other.Gamma;
-    nbBoundaryPoints = other.nbBoundaryPoints;
-    nbPoints = other.nbPoints;
-    neighborsIndices = other.neighborsIndices;
-    neighborsWeightsCentroid = other.neighborsWeightsCentroid;
-    neighborsWeightsEnergy = other.neighborsWeightsEnergy;
-    boundaryPointsNeighborsPairings = other.boundaryPointsNeighborsPairings;
-    boundaryPointsPartnersIndices = other.boundaryPointsPartnersIndices;
 }
 
 LiftedGraph* LiftedGraph::cloneCopyConstructImpl() const
@@ -47,18 +34,24 @@ std::unique_ptr<LiftedGraph> LiftedGraph::cloneCopyConstruct() const
 
 uint LiftedGraph::getNbPoints() const
 {
-    return nbPoints;
+    return topology->nbPoints;
 }
 
 uint LiftedGraph::getNbBoundaryPoints() const
 {
-    return nbBoundaryPoints;
+    return topology->nbBoundaryPoints;
 }
 
 bool LiftedGraph::isBoundaryPoint(uint index) const
 {
-    assert(index < nbPoints);
-    return (index < nbBoundaryPoints);
+    assert(index < topology->nbPoints);
+    return (index < topology->nbBoundaryPoints);
+}
+
+uint LiftedGraph::getNbNeighbors(uint index) const
+{
+    assert(index < topology->nbPoints);
+    return topology->neighborsOffsets[index + 1] - topology->neighborsOffsets[index];
 }
 
 
@@ -70,7 +63,7 @@ void LiftedGraphFunction<Point, Map>::cloneCopyAssignImpl(const LiftedGraph *oth
     LiftedGraph::cloneCopyAssignImpl(other);
     const LiftedGraphFunction<Point, Map> *otherCast = static_cast<const LiftedGraphFunction<Point, Map>*>(other);
     rho = otherCast->rho;
-    boundaryPointsNeighborsPairingsValues = otherCast->boundaryPointsNeighborsPairingsValues;
+    pairingsValues = otherCast->pairingsValues;
     values = otherCast->values;
 }
 
@@ -86,7 +79,7 @@ template <typename Point, typename Map>
 LiftedGraphFunction<Point, Map>::LiftedGraphFunction(const LiftedGraphFunction<Point, Map> &other) : LiftedGraph(other)
 {
     rho = other.rho;
-    boundaryPointsNeighborsPairingsValues = other.boundaryPointsNeighborsPairingsValues;
+    pairingsValues = other.pairingsValues;
     values = other.values;
 }
 
@@ -126,10 +119,13 @@ std::vector<Point> LiftedGraphFunction<Point, Map>::getValues() const
 template <typename Point, typename Map>
 std::vector<Point> LiftedGraphFunction<Point, Map>::getNeighborsValues(uint index) const
 {
+    assert(index < this->topology->nbPoints);
+    const LiftedGraphTopology &topology = *this->topology;
     std::vector<Point> out;
-    for (auto neighborIndex : this->neighborsIndices.at(index))
+    out.reserve(this->getNbNeighbors(index));
+    for (uint k=topology.neighborsOffsets[index]; k!=topology.neighborsOffsets[index + 1]; ++k)
     {
-        out.push_back(values.at(neighborIndex));
+        out.push_back(values.at(topology.neighborsIndices[k]));
     }
     return out;
 }
@@ -137,22 +133,21 @@ std::vector<Point> LiftedGraphFunction<Point, Map>::getNeighborsValues(uint inde
 template <typename Point, typename Map>
 std::vector<Point> LiftedGraphFunction<Point, Map>::getNeighborsValuesKicked(uint index) const
 {    
+    const LiftedGraphTopology &topology = *this->topology;
     std::vector<Point> out;
-    out.reserve(this->neighborsIndices.at(index).size());
+    out.reserve(this->getNbNeighbors(index));
     if (this->isBoundaryPoint(index))
     {
-        uint i=0;
-        for (auto neighborIndex : this->neighborsIndices.at(index))
+        for (uint k=topology.neighborsOffsets[index]; k!=topology.neighborsOffsets[index + 1]; ++k)
         {
-            out.push_back(boundaryPointsNeighborsPairingsValues.at(index).at(i)*values.at(neighborIndex));
-            ++i;
+            out.push_back(pairingsValues.at(topology.boundaryPointsNeighborsPairingsIndices[k])*values.at(topology.neighborsIndices[k]));
         }
     }
     else
     {
-        for (auto neighborIndex : this->neighborsIndices.at(index))
+        for (uint k=topology.neighborsOffsets[index]; k!=topology.neighborsOffsets[index + 1]; ++k)
         {
-            out.push_back(values.at(neighborIndex));
+            out.push_back(values.at(topology.neighborsIndices[k]));
         }
     }
     return out;
@@ -161,10 +156,10 @@ std::vector<Point> LiftedGraphFunction<Point, Map>::getNeighborsValuesKicked(uin
 template <typename Point, typename Map>
 std::vector<Point> LiftedGraphFunction<Point, Map>::getPartnersValues(uint index) const
 {
-    if (isBoundaryPoint(index))
+    if (this->isBoundaryPoint(index))
     {
         std::vector<Point> out;
-        for (auto partnerIndex : boundaryPointsPartnersIndices.at(index))
+        for (auto partnerIndex : this->topology->boundaryPointsPartnersIndices.at(index))
         {
             out.push_back(values.at(partnerIndex));
         }
@@ -179,16 +174,18 @@ std::vector<Point> LiftedGraphFunction<Point, Map>::getPartnersValues(uint index
 
 
 template <typename Point, typename Map>
-void LiftedGraphFunction<Point, Map>::refreshBoundaryPointsNeighborsPairingsValues()
+void LiftedGraphFunction<Point, Map>::setRepresentation(const GroupRepresentation<Map> &rho)
 {
-    assert(this->boundaryPointsNeighborsPairings.size() == nbBoundaryPoints);
-    assert(this->boundaryPointsNeighborsPairingsValues.size() == nbBoundaryPoints);
+    // The values are kept: only the pairings of the neighbors of boundary points depend on rho
+    this->rho = rho;
+    refreshPairingsValues();
+}
 
-    uint i=0;
-    for(const auto &pairings : this->boundaryPointsNeighborsPairings)
-    {
-        this->boundaryPointsNeighborsPairingsValues[i++] = rho.evaluateRepresentation(pairings);
-    }
+template <typename Point, typename Map>
+void LiftedGraphFunction<Point, Map>::refreshPairingsValues()
+{
+    assert(this->topology->boundaryPointsNeighborsPairingsIndices.size() == this->topology->neighborsOffsets[this->topology->nbBoundaryPoints]);
+    this->pairingsValues = rho.evaluateRepresentation(this->topology->pairingsWords);
 }
 
 
@@ -196,7 +193,7 @@ void LiftedGraphFunction<Point, Map>::refreshBoundaryPointsNeighborsPairingsValu
 template <typename Point, typename Map>
 void LiftedGraphFunction<Point, Map>::resetValues(const std::vector<Point> &newValues)
 {
-    assert(newValues.size() == this->nbPoints);
+    assert(newValues.size() == this->topology->nbPoints);
     values = newValues;
 }
 
@@ -213,9 +210,6 @@ void LiftedGraphFunctionTriangulated<Point, Map>::cloneCopyAssignImpl(const Lift
 
     const LiftedGraphFunctionTriangulated<Point, Map> *otherCast = static_cast<const LiftedGraphFunctionTriangulated<Point, Map>*>(other);
     depth = otherCast->depth;
-    subdivisions = otherCast->subdivisions;
-    subdivisionsPointsIndicesInValues = otherCast->subdivisionsPointsIndicesInValues;
-    triangles = otherCast->triangles;
 }
 
 template <typename Point, typename Map>
@@ -230,9 +224,6 @@ template <typename Point, typename Map>
 LiftedGraphFunctionTriangulated<Point, Map>::LiftedGraphFunctionTriangulated(const LiftedGraphFunctionTriangulated<Point, Map> &other) : LiftedGraphFunction<Point, Map>(other)
 {
     depth = other.depth;
-    subdivisions = other.subdivisions;
-    subdivisionsPointsIndicesInValues = other.subdivisionsPointsIndicesInValues;
-    triangles = other.triangles;
 }
 
 template <typename Point, typename Map>
@@ -251,16 +242,16 @@ LiftedGraph* LiftedGraphFunctionTriangulated<Point, Map>::cloneCopyConstructImpl
 template <typename Point, typename Map>
 void LiftedGraphFunctionTriangulated<Point, Map>::initializePiecewiseLinear(const std::vector<Point> &polygonVerticesValues)
 {
-    assert(polygonVerticesValues.size()*(TriangularSubdivision<Point>::nbLines(depth)-1) == this->nbBoundaryPoints);
+    assert(polygonVerticesValues.size()*(TriangularSubdivision<Point>::nbLines(depth)-1) == this->topology->nbBoundaryPoints);
 
+    TriangularSubdivision<Point> subdivision(depth);
     uint index1, index2, index3;
-    for (uint i=0; i!=triangles.size(); ++i)
+    for (uint i=0; i!=this->topology->triangles.size(); ++i)
     {
-        triangles[i].getVertices(index1, index2, index3);
-        subdivisions[i].initializeSubdivisionByMidpoints(polygonVerticesValues.at(index1), polygonVerticesValues.at(index2), polygonVerticesValues.at(index3));
+        this->topology->triangles[i].getVertices(index1, index2, index3);
+        subdivision.initializeSubdivisionByMidpoints(polygonVerticesValues.at(index1), polygonVerticesValues.at(index2), polygonVerticesValues.at(index3));
+        copyValuesFromSubdivision(i, subdivision);
     }
-
-    refreshValuesFromSubdivisions();
 }
 
 
@@ -268,9 +259,9 @@ template <typename Point, typename Map>
 std::vector<Point> LiftedGraphFunctionTriangulated<Point, Map>::getBoundary() const
 {
     std::vector<Point> out;
-    out.reserve(this->nbBoundaryPoints);
+    out.reserve(this->topology->nbBoundaryPoints);
 
-    for (uint i=0; i!=this->nbBoundaryPoints; ++i)
+    for (uint i=0; i!=this->topology->nbBoundaryPoints; ++i)
     {
         out.push_back(this->values[i]);
     }
@@ -281,7 +272,7 @@ template <typename Point, typename Map>
 std::vector<uint> LiftedGraphFunctionTriangulated<Point, Map>::getSteinerWeights() const
 {
     std::vector<uint> weightsOut;
-    std::vector<uint> fullVerticesIndices = this->boundaryPointsPartnersIndices.front();
+    std::vector<uint> fullVerticesIndices = this->topology->boundaryPointsPartnersIndices.front();
     std::sort(fullVerticesIndices.begin(), fullVerticesIndices.end());
 
     uint currentVertexIndex = 0, nextVertexIndex;
@@ -291,7 +282,7 @@ std::vector<uint> LiftedGraphFunctionTriangulated<Point, Map>::getSteinerWeights
         weightsOut.push_back((nextVertexIndex-currentVertexIndex)/Tools::exponentiation(2, this->depth) - 1);
         currentVertexIndex = nextVertexIndex;
     }
-    weightsOut.push_back((this->nbBoundaryPoints-currentVertexIndex)/Tools::exponentiation(2, this->depth) - 1);
+    weightsOut.push_back((this->topology->nbBoundaryPoints-currentVertexIndex)/Tools::exponentiation(2, this->depth) - 1);
 
     return weightsOut;
 }
@@ -299,7 +290,7 @@ std::vector<uint> LiftedGraphFunctionTriangulated<Point, Map>::getSteinerWeights
 template <typename Point, typename Map>
 std::vector<Point> LiftedGraphFunctionTriangulated<Point, Map>::getFirstVertexOrbit() const
 {
-    std::vector<uint> orbitIndices = this->boundaryPointsPartnersIndices.front();
+    std::vector<uint> orbitIndices = this->topology->boundaryPointsPartnersIndices.front();
     orbitIndices.push_back(0);
     std::sort(orbitIndices.begin(), orbitIndices.end());
 
@@ -316,12 +307,16 @@ template <typename Point, typename Map>
 double LiftedGraphFunctionTriangulated<Point, Map>::getMinEdgeLengthForRegularTriangulation() const
 {
     std::vector<double> bigTrianglesSidelengths;
-    bigTrianglesSidelengths.reserve(3*subdivisions.size());
+    bigTrianglesSidelengths.reserve(3*this->topology->subdivisionsPointsIndicesInValues.size());
 
+    // The vertices of a subdivision are its first point and the first and last points of its last line
+    uint N = TriangularSubdivision<Point>::nbPoints(depth), L = TriangularSubdivision<Point>::nbLines(depth);
     Point A, B, C;
-    for (const auto &subdivision : subdivisions)
+    for (const auto &indices : this->topology->subdivisionsPointsIndicesInValues)
     {
-        subdivision.getBigTriangle(A, B, C);
+        A = this->values[indices[0]];
+        B = this->values[indices[N - L]];
+        C = this->values[indices[N - 1]];
         bigTrianglesSidelengths.push_back(Point::distance(A, B));
         bigTrianglesSidelengths.push_back(Point::distance(B, C));
         bigTrianglesSidelengths.push_back(Point::distance(C, A));
@@ -332,52 +327,17 @@ double LiftedGraphFunctionTriangulated<Point, Map>::getMinEdgeLengthForRegularTr
 
 
 template <typename Point, typename Map>
-void LiftedGraphFunctionTriangulated<Point, Map>::refreshValuesFromSubdivisions()
+void LiftedGraphFunctionTriangulated<Point, Map>::copyValuesFromSubdivision(uint subdivisionIndex, const TriangularSubdivision<Point> &subdivision)
 {
-    uint subdivisionIndex = 0, indexInSubdivision;
-    for (auto subdivisionPointsIndicesInValues : subdivisionsPointsIndicesInValues)
+    const std::vector<uint> &subdivisionPointsIndicesInValues = this->topology->subdivisionsPointsIndicesInValues[subdivisionIndex];
+    assert(subdivisionPointsIndicesInValues.size() == subdivision.points.size());
+    for (uint i=0; i!=subdivisionPointsIndicesInValues.size(); ++i)
     {
-        indexInSubdivision = 0;
-        for (auto subdivisionPointIndexInValues : subdivisionPointsIndicesInValues)
-        {
-            this->values.at(subdivisionPointIndexInValues) = subdivisions.at(subdivisionIndex).points->at(indexInSubdivision);
-            ++indexInSubdivision;
-        }
-        ++subdivisionIndex;
+        this->values[subdivisionPointsIndicesInValues[i]] = subdivision.points[i];
     }
 }
 
 
-template <typename Point, typename Map>
-void LiftedGraphFunctionTriangulated<Point, Map>::refreshSubdivisionsFromValues()
-{
-    uint subdivisionIndex = 0, indexInSubdivision;
-    for (auto subdivisionPointsIndicesInValues : subdivisionsPointsIndicesInValues)
-    {
-        indexInSubdivision = 0;
-        for (auto subdivisionPointIndexInValues : subdivisionPointsIndicesInValues)
-        {
-            subdivisions.at(subdivisionIndex).points->at(indexInSubdivision) = this->values.at(subdivisionPointIndexInValues);
-            ++indexInSubdivision;
-        }
-        ++subdivisionIndex;
-    }
-}
-
-template <typename Point, typename Map>
-void LiftedGraphFunctionTriangulated<Point, Map>::resetValues(const std::vector<Point> &newValues)
-{
-    if (newValues.size()!=this->nbPoints)
-    {
-        std::cout << "newValues has size = " << newValues.size() << std::endl;
-        std::cout << "nbPoints = " << this->nbPoints << std::endl;
-    }
-    assert(newValues.size() == this->nbPoints);
-    this->values = newValues;
-    refreshSubdivisionsFromValues();
-}
-
-
 template <typename Point, typename Map>
 std::vector< std::vector<Point> > LiftedGraphFunctionTriangulated<Point, Map>::getTrianglesUp() const
 {
@@ -385,10 +345,10 @@ std::vector< std::vector<Point> > LiftedGraphFunctionTriangulated<Point, Map>::g
     uint aIndex, bIndex, cIndex;
     uint L = TriangularSubdivision<Point>::nbLines(depth);
     uint i, j, m = 0;
-    out.reserve((subdivisions.size()*(L-1)*L)/2);
+    out.reserve((this->topology->subdivisionsPointsIndicesInValues.size()*(L-1)*L)/2);
 
 
-    for (const auto & indices : subdivisionsPointsIndicesInValues)
+    for (const auto & indices : this->topology->subdivisionsPointsIndicesInValues)
     {
         m = 0;
         for (i=0; i<L-1; i++)
@@ -414,10 +374,10 @@ std::vector< std::vector<Point> > LiftedGraphFunctionTriangulated<Point, Map>::g
     uint aIndex, bIndex, cIndex;
     uint L = TriangularSubdivision<Point>::nbLines(depth);
     uint i, j, m = 0;
-    out.reserve((subdivisions.size()*(L-1)*L)/2);
+    out.reserve((this->topology->subdivisionsPointsIndicesInValues.size()*(L-1)*L)/2);
 
 
-    for (const auto & indices : subdivisionsPointsIndicesInValues)
+    for (const auto & indices : this->topology->subdivisionsPointsIndicesInValues)
     {
         m = 0;
 
@@ -495,63 +455,112 @@ bool LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::triangleContaining(co
                                                                               uint &index1Out, uint &index2Out, uint &index3Out) const
 {
     H2Point A, B, C;
-    uint indexInSubdivision1, indexInSubdivision2, indexInSubdivision3, i = 0;
-    for(const auto &subdivision : subdivisions)
+    uint indexInSubdivision1, indexInSubdivision2, indexInSubdivision3;
+    for (const auto &indices : topology->subdivisionsPointsIndicesInValues)
     {
-        if (subdivision.triangleContaining(point, A, B, C, indexInSubdivision1, indexInSubdivision2, indexInSubdivision3))
+        if (TriangularSubdivision<H2Point>::triangleContaining(point, values, indices, depth,
+                                                               A, B, C, indexInSubdivision1, indexInSubdivision2, indexInSubdivision3))
         {
-            index1Out = subdivisionsPointsIndicesInValues[i][indexInSubdivision1];
-            index2Out = subdivisionsPointsIndicesInValues[i][indexInSubdivision2];
-            index3Out = subdivisionsPointsIndicesInValues[i][indexInSubdivision3];
+            index1Out = indices[indexInSubdivision1];
+            index2Out = indices[indexInSubdivision2];
+            index3Out = indices[indexInSubdivision3];
             triangleOut = H2Triangle(A, B, C);
             return true;
         }
-        ++i;
     }
     return false;
 }
 
-template <>
-void LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::rearrangeOrderForConstructFromH2Mesh(std::vector<uint> newIndices)
+template <typename Point, typename Map>
+std::vector<uint> LiftedGraphFunctionTriangulated<Point, Map>::getTrianglesVerticesIndices() const
 {
-    std::vector< std::vector<uint> > newNeighborsIndices(nbPoints), newBoundaryPointsPartnersIndices(nbBoundaryPoints), newSubdivisionsPointsIndicesInValues(subdivisions.size());
-    std::vector< std::vector<Word> > newBoundaryPointsNeighborsPairings(nbBoundaryPoints);
-    std::vector< std::vector<double> > newNeighborsWeightsCentroid(nbPoints),newNeighborsWeightsEnergy(nbPoints);
-
-    for (uint i=0; i!=nbPoints; ++i)
+    // The smallest triangles, in the order in which triangleContaining() searches them
+    std::vector<uint> trianglesIndicesInSubdivision = TriangularSubdivision<Point>::trianglesIndices(depth);
+    std::vector<uint> out;
+    out.reserve(this->topology->subdivisionsPointsIndicesInValues.size()*trianglesIndicesInSubdivision.size());
+    for (const auto &indices : this->topology->subdivisionsPointsIndicesInValues)
     {
-        for (auto neighborIndex : this->neighborsIndices[i])
+        for (auto indexInSubdivision : trianglesIndicesInSubdivision)
         {
-            newNeighborsIndices[newIndices[i]].push_back(newIndices[neighborIndex]);
+            out.push_back(indices[indexInSubdivision]);
         }
-        newNeighborsWeightsCentroid[newIndices[i]] = this->neighborsWeightsCentroid[i];
-        newNeighborsWeightsEnergy[newIndices[i]] = this->neighborsWeightsEnergy[i];
     }
+    return out;
+}
 
-    for (uint i=0; i!=nbBoundaryPoints; ++i)
+template <>
+void LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::rearrangeOrderForConstructFromH2Mesh(const std::vector<uint> &newIndices,
+                                                                                              const std::vector<const H2MeshPoint *> &meshPoints,
+                                                                                              const std::vector<const std::vector<Word> *> &meshPointsPairings,
+                                                                                              const std::vector< std::vector<uint> > &meshPointsPartnersIndices,
+                                                                                              LiftedGraphTopology &topologyOut)
+{
+    uint nbPoints = topologyOut.nbPoints, nbBoundaryPoints = topologyOut.nbBoundaryPoints;
+    uint nbInteriorPoints = nbPoints - nbBoundaryPoints;
+    assert(meshPoints.size() == nbPoints);
+    assert(meshPointsPairings.size() == nbBoundaryPoints);
+    assert(meshPointsPartnersIndices.size() == nbBoundaryPoints);
+
+    std::vector<uint> oldIndices(nbPoints);
+    uint nbNeighbors = 0;
+    for (uint i=0; i!=nbPoints; ++i)
     {
-        newBoundaryPointsNeighborsPairings[newIndices[i + nbPoints - nbBoundaryPoints]] = this->boundaryPointsNeighborsPairings[i];
-        for (auto partnerIndex : this->boundaryPointsPartnersIndices[i])
+        oldIndices[newIndices[i]] = i;
+        nbNeighbors += meshPoints[i]->neighborsIndices.size();
+    }
+
+    topologyOut.neighborsOffsets.reserve(nbPoints + 1);
+    topologyOut.neighborsIndices.reserve(nbNeighbors);
+    topologyOut.neighborsWeightsCentroid.reserve(nbNeighbors);
+    topologyOut.neighborsWeightsEnergy.reserve(nbNeighbors);
+    topologyOut.boundaryPointsPartnersIndices.resize(nbBoundaryPoints);
+
+    // Distinct pairings, compared after contraction
+    std::map<std::vector<letter>, uint> pairingsIndices;
+    const H2MeshPoint *meshPoint;
+    topologyOut.neighborsOffsets.push_back(0);
+    for (uint i=0; i!=nbPoints; ++i)
+    {
+        meshPoint = meshPoints[oldIndices[i]];
+        for (auto neighborIndex : meshPoint->neighborsIndices)
+        {
+            topologyOut.neighborsIndices.push_back(newIndices[neighborIndex]);
+        }
+        topologyOut.neighborsWeightsCentroid.insert(topologyOut.neighborsWeightsCentroid.end(),
+                                              meshPoint->neighborsWeightsCentroid.begin(), meshPoint->neighborsWeightsCentroid.end());
+        topologyOut.neighborsWeightsEnergy.insert(topologyOut.neighborsWeightsEnergy.end(),
+                                            meshPoint->neighborsWeightsEnergy.begin(), meshPoint->neighborsWeightsEnergy.end());
+
+        if (i < nbBoundaryPoints)
         {
-            newBoundaryPointsPartnersIndices[newIndices[i + nbPoints - nbBoundaryPoints]].push_back(newIndices[partnerIndex]);
+            assert(oldIndices[i] >= nbInteriorPoints);
+            const std::vector<Word> &pairings = *meshPointsPairings[oldIndices[i] - nbInteriorPoints];
+            assert(pairings.size() == meshPoint->neighborsIndices.size());
+            for (const auto & pairing : pairings)
+            {
+                auto inserted = pairingsIndices.insert(std::make_pair(Word::contract(pairing).getLetters(), topologyOut.pairingsWords.size()));
+                if (inserted.second)
+                {
+                    topologyOut.pairingsWords.push_back(pairing);
+                }
+                topologyOut.boundaryPointsNeighborsPairingsIndices.push_back(inserted.first->second);
+            }
+
+            for (auto partnerIndex : meshPointsPartnersIndices[oldIndices[i] - nbInteriorPoints])
+            {
+                topologyOut.boundaryPointsPartnersIndices[i].push_back(newIndices[partnerIndex]);
+            }
         }
+        topologyOut.neighborsOffsets.push_back(topologyOut.neighborsIndices.size());
     }
 
-    for (uint i=0; i!=subdivisions.size(); ++i)
+    for (auto &subdivisionPointsIndicesInValues : topologyOut.subdivisionsPointsIndicesInValues)
     {
-        newSubdivisionsPointsIndicesInValues[i].reserve(subdivisionsPointsIndicesInValues[i].size());
-        for (auto index : subdivisionsPointsIndicesInValues[i])
+        for (auto &index : subdivisionPointsIndicesInValues)
         {
-            newSubdivisionsPointsIndicesInValues[i].push_back(newIndices[index]);
+            index = newIndices[index];
         }
     }
-
-    this->neighborsIndices = newNeighborsIndices;
-    this->neighborsWeightsCentroid = newNeighborsWeightsCentroid;
-    this->neighborsWeightsEnergy = newNeighborsWeightsEnergy;
-    this->boundaryPointsPartnersIndices = newBoundaryPointsPartnersIndices;
-    this->boundaryPointsNeighborsPairings = newBoundaryPointsNeighborsPairings;
-    this->subdivisionsPointsIndicesInValues = newSubdivisionsPointsIndicesInValues;
 }
 
 template <>
@@ -564,45 +573,35 @@ void LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::constructFromH2Mesh(c
     assert(nbBoundaryPoints == mesh.exteriorSidesIndices.size());
     uint nbPoints = mesh.nbPoints();
     assert(nbInteriorPoints + nbBoundaryPoints == nbPoints);
-    this->nbBoundaryPoints = nbBoundaryPoints;
-    this->nbPoints = nbPoints;
-
-    this->Gamma = mesh.rho.getDiscreteGroup();
+    std::shared_ptr<LiftedGraphTopology> topology = std::make_shared<LiftedGraphTopology>();
+    topology->nbBoundaryPoints = nbBoundaryPoints;
+    topology->nbPoints = nbPoints;
 
+    topology->Gamma = mesh.rho.getDiscreteGroup();
 
-    this->neighborsIndices.clear();
-    this->neighborsWeightsCentroid.clear();
-    this->neighborsWeightsEnergy.clear();
-    this->boundaryPointsNeighborsPairings.clear();
-    this->boundaryPointsPartnersIndices.clear();
 
-    this->neighborsIndices.reserve(nbPoints);
-    this->neighborsWeightsCentroid.reserve(nbPoints);
-    this->neighborsWeightsEnergy.reserve(nbPoints);
-    this->boundaryPointsNeighborsPairings.reserve(nbBoundaryPoints);
-    this->boundaryPointsPartnersIndices.reserve(nbBoundaryPoints);
+    std::vector<const H2MeshPoint *> meshPoints;
+    std::vector<const std::vector<Word> *> meshPointsPairings;
+    std::vector< std::vector<uint> > meshPointsPartnersIndices;
+    meshPoints.reserve(nbPoints);
+    meshPointsPairings.reserve(nbBoundaryPoints);
+    meshPointsPartnersIndices.reserve(nbBoundaryPoints);
 
     for (const auto & meshPoint : mesh.regularPoints)
     {
-        neighborsIndices.push_back(meshPoint.neighborsIndices);
-        neighborsWeightsCentroid.push_back(meshPoint.neighborsWeightsCentroid);
-        neighborsWeightsEnergy.push_back(meshPoint.neighborsWeightsEnergy);
+        meshPoints.push_back(&meshPoint);
     }
 
     for (const auto &meshPoint : mesh.cutPoints)
     {
-        neighborsIndices.push_back(meshPoint.neighborsIndices);
-        neighborsWeightsCentroid.push_back(meshPoint.neighborsWeightsCentroid);
-        neighborsWeightsEnergy.push_back(meshPoint.neighborsWeightsEnergy);
+        meshPoints.push_back(&meshPoint);
     }
 
     for (const auto &meshPoint : mesh.boundaryPoints)
     {
-        neighborsIndices.push_back(meshPoint.neighborsIndices);
-        neighborsWeightsCentroid.push_back(meshPoint.neighborsWeightsCentroid);
-        neighborsWeightsEnergy.push_back(meshPoint.neighborsWeightsEnergy);
-        this->boundaryPointsNeighborsPairings.push_back(meshPoint.neighborsPairings);
-        this->boundaryPointsPartnersIndices.push_back({meshPoint.partnerPointIndex});
+        meshPoints.push_back(&meshPoint);
+        meshPointsPairings.push_back(&meshPoint.neighborsPairings);
+        meshPointsPartnersIndices.push_back({meshPoint.partnerPointIndex});
     }
 
 
@@ -617,10 +616,8 @@ void LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::constructFromH2Mesh(c
     std::vector<uint> partnersIndices;
     for (const auto &meshPoint : mesh.vertexPoints)
     {
-        neighborsIndices.push_back(meshPoint.neighborsIndices);
-        neighborsWeightsCentroid.push_back(meshPoint.neighborsWeightsCentroid);
-        neighborsWeightsEnergy.push_back(meshPoint.neighborsWeightsEnergy);
-        this->boundaryPointsNeighborsPairings.push_back(meshPoint.neighborsPairings);
+        meshPoints.push_back(&meshPoint);
+        meshPointsPairings.push_back(&meshPoint.neighborsPairings);
 
         partnersIndices.clear();
         partnersIndices.reserve(verticesIndices.size()-1);
@@ -631,23 +628,20 @@ void LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::constructFromH2Mesh(c
                 partnersIndices.push_back(index);
             }
         }
-        this->boundaryPointsPartnersIndices.push_back(partnersIndices);
+        meshPointsPartnersIndices.push_back(partnersIndices);
     }
 
     for (const auto &meshPoint : mesh.steinerPoints)
     {
-        neighborsIndices.push_back(meshPoint.neighborsIndices);
-        neighborsWeightsCentroid.push_back(meshPoint.neighborsWeightsCentroid);
-        neighborsWeightsEnergy.push_back(meshPoint.neighborsWeightsEnergy);
-        this->boundaryPointsNeighborsPairings.push_back(meshPoint.neighborsPairings);
-        this->boundaryPointsPartnersIndices.push_back({meshPoint.partnerPointIndex});
+        meshPoints.push_back(&meshPoint);
+        meshPointsPairings.push_back(&meshPoint.neighborsPairings);
+        meshPointsPartnersIndices.push_back({meshPoint.partnerPointIndex});
     }
 
     this->rho = mesh.rho;
     this->depth = mesh.depth;
-    this->subdivisions = mesh.subdivisions;
-    this->triangles = mesh.triangles;
-    this->subdivisionsPointsIndicesInValues = mesh.meshIndicesInSubdivisions;
+    topology->triangles = mesh.triangles;
+    topology->subdivisionsPointsIndicesInValues = mesh.meshIndicesInSubdivisions;
 
 
     //clock_t a = clock();
@@ -663,14 +657,17 @@ void LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::constructFromH2Mesh(c
     {
         newIndices[i]= i + nbBoundaryPoints;
     }
-    rearrangeOrderForConstructFromH2Mesh(newIndices);
+    rearrangeOrderForConstructFromH2Mesh(newIndices, meshPoints, meshPointsPairings, meshPointsPartnersIndices, *topology);
+    this->topology = topology;
     //clock_t b = clock();
 
 
-    this->boundaryPointsNeighborsPairingsValues.resize(nbBoundaryPoints);
     this->values.resize(nbPoints);
-    this->refreshBoundaryPointsNeighborsPairingsValues();
-    refreshValuesFromSubdivisions();
+    this->refreshPairingsValues();
+    for (uint i=0; i!=mesh.subdivisions.size(); ++i)
+    {
+        copyValuesFromSubdivision(i, mesh.subdivisions[i]);
+    }
 
     //clock_t t1 = clock();
     //std::cout << "Time to generate graph from mesh: " << 0.001*int(1000*(t1 - t0)*1.0/CLOCKS_PER_SEC)
@@ -689,28 +686,12 @@ LiftedGraphFunctionTriangulated<H2Point, H2Isometry>::LiftedGraphFunctionTriangu
 template <typename Point, typename Map>
 void LiftedGraphFunctionTriangulated<Point, Map>::constructUninitialized(const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &domainFunction, const GroupRepresentation<Map> &rhoImage)
 {
-    this->Gamma = domainFunction.Gamma;
-    this->nbBoundaryPoints = domainFunction.nbBoundaryPoints;
-    this->nbPoints = domainFunction.nbPoints;
-    this->neighborsIndices = domainFunction.neighborsIndices;
-    this->neighborsWeightsCentroid = domainFunction.neighborsWeightsCentroid;
-    this->neighborsWeightsEnergy = domainFunction.neighborsWeightsEnergy;
-    this->boundaryPointsNeighborsPairings = domainFunction.boundaryPointsNeighborsPairings;
-    this->boundaryPointsPartnersIndices = domainFunction.boundaryPointsPartnersIndices;
+    this->topology = domainFunction.topology;
     this->rho = rhoImage;
-    this->boundaryPointsNeighborsPairingsValues.resize(this->nbBoundaryPoints);
-    this->refreshBoundaryPointsNeighborsPairingsValues();
+    this->refreshPairingsValues();
     this->depth = domainFunction.depth;
-    this->triangles = domainFunction.triangles;
-    this->subdivisionsPointsIndicesInValues = domainFunction.subdivisionsPointsIndicesInValues;
-
-    subdivisions.clear();
-    for (uint i=0; i!=triangles.size(); ++i)
-    {
-        subdivisions.push_back(TriangularSubdivision<Point>(depth));
-    }
 
-    this->values.resize(this->nbPoints);
+    this->values.resize(this->topology->nbPoints);
 }
 
 template <typename Point, typename Map>
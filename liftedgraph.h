@@ -10,6 +10,36 @@
 
 class Word;
 template <typename Point, typename Map> class DiscreteFlowIterator;
+template <typename Point, typename Map> class DiscreteFlowMultigrid;
+template <typename Point, typename Map> class DiscreteFlowFactory;
+
+
+// Topology and weights of a lifted graph. They are never modified once constructed,
+// and are shared by all the functions on the same graph (the domain and image functions, and their clones).
+struct LiftedGraphTopology
+{
+    DiscreteGroup Gamma;
+
+    uint nbBoundaryPoints,  nbPoints;
+
+    // Compressed sparse row storage: the neighbors of point i are stored at positions
+    // neighborsOffsets[i], ..., neighborsOffsets[i+1] - 1 of the flat arrays below.
+    // Boundary points come first, so boundaryPointsNeighborsPairingsIndices has neighborsOffsets[nbBoundaryPoints] entries.
+    std::vector<uint> neighborsOffsets;
+    std::vector<uint> neighborsIndices;
+    std::vector<double> neighborsWeightsCentroid,neighborsWeightsEnergy;
+
+    // Only a few distinct words kick the neighbors of boundary points: they are listed once in pairingsWords,
+    // and the neighbor at position k is kicked by pairingsWords[boundaryPointsNeighborsPairingsIndices[k]].
+    std::vector<Word> pairingsWords;
+    std::vector<uint> boundaryPointsNeighborsPairingsIndices;
+    std::vector< std::vector<uint> > boundaryPointsPartnersIndices;
+
+    // Triangulated graphs only: the point of index j in the subdivision of triangles[i] is the point subdivisionsPointsIndicesInValues[i][j]
+    std::vector<TriangulationTriangle> triangles;
+    std::vector< std::vector<uint> > subdivisionsPointsIndicesInValues;
+};
+
 
 class LiftedGraph
 {
@@ -24,6 +54,7 @@ public:
     uint getNbPoints() const;
     uint getNbBoundaryPoints() const;
     bool isBoundaryPoint(uint index) const;
+    uint getNbNeighbors(uint index) const;
 
 protected:
     LiftedGraph(const LiftedGraph &other);
@@ -33,15 +64,8 @@ protected:
 
 
 
-    DiscreteGroup Gamma;
-
-    uint nbBoundaryPoints,  nbPoints;
-
-    std::vector< std::vector<uint> > neighborsIndices;
-    std::vector< std::vector<double> > neighborsWeightsCentroid,neighborsWeightsEnergy;
-
-    std::vector< std::vector<Word> > boundaryPointsNeighborsPairings;
-    std::vector< std::vector<uint> > boundaryPointsPartnersIndices;
+    // Copying a lifted graph only copies this pointer
+    std::shared_ptr<const LiftedGraphTopology> topology;
 };
 
 
@@ -58,6 +82,7 @@ public:
     virtual ~LiftedGraphFunction() {}
 
     GroupRepresentation<Map> getRepresentation() const;
+    void setRepresentation(const GroupRepresentation<Map> &rho);
     Point getValue(uint index) const;
     std::vector<Point> getValues() const;
     std::vector<Point> getNeighborsValues(uint index) const;
@@ -69,21 +94,26 @@ protected:
     virtual LiftedGraph *cloneCopyConstructImpl() const override;
     virtual void cloneCopyAssignImpl(const LiftedGraph *other) override;
 
-    void refreshBoundaryPointsNeighborsPairingsValues();
+    void refreshPairingsValues();
     virtual void resetValues(const std::vector<Point> &newValues);
 
     GroupRepresentation<Map> rho;
-    std::vector< std::vector<Map> > boundaryPointsNeighborsPairingsValues;
+    std::vector<Map> pairingsValues;
+    // Each point is stored once: in a triangulated graph, the point of index j in the subdivision of triangle i
+    // is values[topology->subdivisionsPointsIndicesInValues[i][j]]
     std::vector<Point> values;
 };
 
 
-class H2Mesh; class TriangulationTriangle; class H2Point;
+class H2Mesh; class H2MeshPoint; class TriangulationTriangle; class H2Point;
 
 template <typename Point, typename Map> class LiftedGraphFunctionTriangulated : public LiftedGraphFunction<Point, Map>
 {
     friend class MathsContainer;
     friend class FenchelNielsenUser;
+    friend class FlowRunner;
+    friend class DiscreteFlowMultigrid<H2Point, H2Isometry>;
+    friend class DiscreteFlowFactory<H2Point, H2Isometry>;
 
 private:
 
@@ -96,6 +126,7 @@ public:
     std::vector<Point> getBoundary() const;
     std::vector< std::vector<Point> > getTrianglesUp() const;
     std::vector< std::vector<Point> > getAllTriangles() const;
+    std::vector<uint> getTrianglesVerticesIndices() const;
     std::vector<uint> getSteinerWeights() const;
     std::vector<Point> getFirstVertexOrbit() const;
     double getMinEdgeLengthForRegularTriangulation() const;
@@ -117,20 +148,18 @@ private:
 
     void constructUninitialized(const LiftedGraphFunctionTriangulated<H2Point, H2Isometry> &domainFunction, const GroupRepresentation<Map> &rhoImage);
     void initializePiecewiseLinear(const std::vector<Point> &polygonVerticesValues);
-    void refreshValuesFromSubdivisions();
-    void refreshSubdivisionsFromValues();
-    virtual void resetValues(const std::vector<Point> &newValues) override;
+    void copyValuesFromSubdivision(uint subdivisionIndex, const TriangularSubdivision<Point> &subdivision);
 
     // Specialization to Point = H2Point, Map = H2Isometry
     void constructFromH2Mesh(const H2Mesh &mesh);
-    void rearrangeOrderForConstructFromH2Mesh(std::vector<uint> newIndices);
+    void rearrangeOrderForConstructFromH2Mesh(const std::vector<uint> &newIndices, const std::vector<const H2MeshPoint *> &meshPoints,
+                                              const std::vector<const std::vector<Word> *> &meshPointsPairings,
+                                              const std::vector< std::vector<uint> > &meshPointsPartnersIndices,
+                                              LiftedGraphTopology &topologyOut);
 
 
 
     uint depth;
-    std::vector< TriangularSubdivision<Point> > subdivisions;
-    std::vector< std::vector<uint> > subdivisionsPointsIndicesInValues;
-    std::vector<TriangulationTriangle> triangles;
 };
 
 #endif // LIFTEDGRAPH_H
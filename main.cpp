@@ -5,8 +5,23 @@
 #include "h2tangentvector.h"
 #include "fenchelnielsenconstructor.h"
 #include "outputmenu.h"
+#include "profiler.h"
 
 int main(int argc, char *argv[])
 {
-    return MainApplication(argc, argv).exec();
+    int out = MainApplication(argc, argv).exec();
+
+    // With HARMONY_PROFILE, the timeline of the session is saved when the application quits
+    if (Profiler::isEnabled())
+    {
+        try
+        {
+            Profiler::writeChromeTrace("harmony_trace.json");
+        }
+        catch(QString errorMessage)
+        {
+            qDebug() << "Error caught (by main): " << errorMessage;
+        }
+    }
+    return out;
 }
@@ -1,10 +1,12 @@
 #include "mainapplication.h"
 #include "topfactory.h"
+#include "profiler.h"
 
 MainApplication::MainApplication(int &argc, char **argv) : QApplication(argc, argv)
 {
     errorCaught = false;
     srand (static_cast <unsigned> (time(0))); // Seed the random number generator
+    Profiler::setThreadName("GUI thread");
 
     try
     {
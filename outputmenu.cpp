@@ -33,6 +33,10 @@ void OutputMenu::createButtons()
     flowComboBox->addItem(QString("Cosh-center of mass"), FLOW_CENTROID);
     flowComboBox->addItem(QString("Discrete heat flow (C)"), FLOW_ENERGY_CONSTANT_STEP);
     flowComboBox->addItem(QString("Discrete heat flow (O)"), FLOW_ENERGY_OPTIMAL_STEP);
+    flowComboBox->addItem(QString("Energy minimization (Newton)"), FLOW_ENERGY_NEWTON);
+    flowComboBox->addItem(QString("Energy minimization (multigrid)"), FLOW_MULTIGRID);
+    flowComboBox->addItem(QString("Cosh-center of mass (Anderson)"), FLOW_CENTROID_ANDERSON);
+    flowComboBox->addItem(QString("Cosh-center of mass (Gauss-Seidel)"), FLOW_CENTROID_GAUSS_SEIDEL);
     flowComboBox->setToolTip("Choose flow method");
     
     resetButton = new QPushButton(QString("Reset"));
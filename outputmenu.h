@@ -4,6 +4,7 @@
 #include <QGroupBox>
 
 #include "tools.h"
+#include "flowchoice.h"
 
 class QGridLayout; class QLabel; class QCheckBox; class QPushButton; class QSpinBox; class QComboBox;
 
@@ -17,7 +18,6 @@ class OutputMenu : public QGroupBox
     friend class ActionHandler;
 
 public:
-    enum FlowChoice {FLOW_CHOICE, FLOW_CENTROID, FLOW_ENERGY_CONSTANT_STEP, FLOW_ENERGY_OPTIMAL_STEP};
 
     OutputMenu() = delete;
     OutputMenu(const OutputMenu &) = delete;
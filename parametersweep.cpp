@@ -0,0 +1,282 @@
+#include "parametersweep.h"
+
+#include <exception>
+#include <random>
+#include <thread>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include "flowchoice.h"
+#include "flowrunner.h"
+#include "threadpool.h"
+
+ParameterSweep::ParameterSweep(uint genus, uint meshDepth, int flowChoice) :
+    genus(genus), meshDepth(meshDepth), flowChoice(flowChoice)
+{
+    if (genus < 2)
+    {
+        throw(QString("Error in ParameterSweep::ParameterSweep: genus must be at least 2"));
+    }
+    if (flowChoice <= FLOW_CHOICE || flowChoice > FLOW_CENTROID_GAUSS_SEIDEL)
+    {
+        throw(QString("Error in ParameterSweep::ParameterSweep: no legal flow choice"));
+    }
+    maxNbIterations = 100000;
+    nbJobs = ThreadPool::defaultNbThreads();
+    andersonMemory = 5;
+    overRelaxationFactor = 0.0;
+    tolerance = 0.0000000001;
+    wallTime = 0.0;
+}
+
+void ParameterSweep::setTolerance(double tolerance)
+{
+    this->tolerance = tolerance;
+}
+
+void ParameterSweep::setMaxNbIterations(uint maxNbIterations)
+{
+    this->maxNbIterations = maxNbIterations;
+}
+
+void ParameterSweep::setNbJobs(uint nbJobs)
+{
+    // nbJobs = 0 means one job per core
+    this->nbJobs = (nbJobs == 0) ? ThreadPool::defaultNbThreads() : nbJobs;
+}
+
+void ParameterSweep::setAndersonMemory(uint andersonMemory)
+{
+    this->andersonMemory = andersonMemory;
+}
+
+void ParameterSweep::setOverRelaxationFactor(double overRelaxationFactor)
+{
+    this->overRelaxationFactor = overRelaxationFactor;
+}
+
+void ParameterSweep::checkCoordinates(const Coordinates &coordinates) const
+{
+    uint N = 3*genus - 3;
+    if (coordinates.FNLengthsDomain.size() != N || coordinates.FNTwistsDomain.size() != N ||
+            coordinates.FNLengthsImage.size() != N || coordinates.FNTwistsImage.size() != N)
+    {
+        throw(QString("Error in ParameterSweep::checkCoordinates: genus does not match number of FN coordinates"));
+    }
+}
+
+std::vector<double> ParameterSweep::flatten(const Coordinates &coordinates)
+{
+    std::vector<double> out;
+    out.insert(out.end(), coordinates.FNLengthsDomain.begin(), coordinates.FNLengthsDomain.end());
+    out.insert(out.end(), coordinates.FNTwistsDomain.begin(), coordinates.FNTwistsDomain.end());
+    out.insert(out.end(), coordinates.FNLengthsImage.begin(), coordinates.FNLengthsImage.end());
+    out.insert(out.end(), coordinates.FNTwistsImage.begin(), coordinates.FNTwistsImage.end());
+    return out;
+}
+
+ParameterSweep::Coordinates ParameterSweep::unflatten(const std::vector<double> &flatCoordinates) const
+{
+    uint N = 3*genus - 3;
+    Coordinates out;
+    out.FNLengthsDomain.assign(flatCoordinates.begin(), flatCoordinates.begin() + N);
+    out.FNTwistsDomain.assign(flatCoordinates.begin() + N, flatCoordinates.begin() + 2*N);
+    out.FNLengthsImage.assign(flatCoordinates.begin() + 2*N, flatCoordinates.begin() + 3*N);
+    out.FNTwistsImage.assign(flatCoordinates.begin() + 3*N, flatCoordinates.begin() + 4*N);
+    return out;
+}
+
+void ParameterSweep::addPoint(const Coordinates &coordinates)
+{
+    checkCoordinates(coordinates);
+    points.push_back(coordinates);
+}
+
+void ParameterSweep::addGrid(const Coordinates &minimum, const Coordinates &maximum, uint nbStepsPerCoordinate)
+{
+    // Only the coordinates whose minimum and maximum differ vary, each taking nbStepsPerCoordinate equally spaced values
+    checkCoordinates(minimum);
+    checkCoordinates(maximum);
+    if (nbStepsPerCoordinate < 2)
+    {
+        throw(QString("Error in ParameterSweep::addGrid: need at least 2 steps per coordinate"));
+    }
+
+    std::vector<double> flatMinimum = flatten(minimum), flatMaximum = flatten(maximum), flatPoint = flatMinimum;
+    std::vector<uint> varyingIndices;
+    for (uint k=0; k!=flatMinimum.size(); ++k)
+    {
+        if (flatMinimum[k] != flatMaximum[k])
+        {
+            varyingIndices.push_back(k);
+        }
+    }
+
+    std::vector<uint> steps(varyingIndices.size(), 0);
+    uint j;
+    while (true)
+    {
+        for (j=0; j!=varyingIndices.size(); ++j)
+        {
+            uint k = varyingIndices[j];
+            flatPoint[k] = flatMinimum[k] + (flatMaximum[k] - flatMinimum[k])*steps[j]/(nbStepsPerCoordinate - 1);
+        }
+        points.push_back(unflatten(flatPoint));
+
+        for (j=0; j!=steps.size(); ++j)
+        {
+            if (++steps[j] != nbStepsPerCoordinate)
+            {
+                break;
+            }
+            steps[j] = 0;
+        }
+        if (j == steps.size())
+        {
+            break;
+        }
+    }
+}
+
+void ParameterSweep::addRandomSamples(const Coordinates &minimum, const Coordinates &maximum, uint nbSamples, uint seed)
+{
+    // Uniform in the box [minimum, maximum], reproducible for a given seed
+    checkCoordinates(minimum);
+    checkCoordinates(maximum);
+
+    std::vector<double> flatMinimum = flatten(minimum), flatMaximum = flatten(maximum), flatPoint(flatMinimum.size());
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    for (uint n=0; n!=nbSamples; ++n)
+    {
+        for (uint k=0; k!=flatPoint.size(); ++k)
+        {
+            flatPoint[k] = flatMinimum[k] + (flatMaximum[k] - flatMinimum[k])*distribution(generator);
+        }
+        points.push_back(unflatten(flatPoint));
+    }
+}
+
+void ParameterSweep::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    results.clear();
+    results.resize(points.size());
+    nextPoint = 0;
+
+    // The calling thread works too
+    uint nbWorkers = std::min(nbJobs, static_cast<uint>(points.size()));
+    std::vector<std::thread> workers;
+    for (uint i=1; i<nbWorkers; ++i)
+    {
+        workers.push_back(std::thread(&ParameterSweep::workerLoop, this));
+    }
+    workerLoop();
+    for (auto & worker : workers)
+    {
+        worker.join();
+    }
+
+    wallTime = timer.nsecsElapsed()*1e-9;
+}
+
+void ParameterSweep::workerLoop()
+{
+    uint index;
+    while ((index = nextPoint++) < points.size())
+    {
+        runPoint(index);
+    }
+}
+
+void ParameterSweep::runPoint(uint index)
+{
+    Result &result = results[index];
+    result.coordinates = points[index];
+    result.isComputed = false;
+    result.hasConverged = false;
+    result.nbIterations = 0;
+    result.energy = 0.0;
+    result.supError = 0.0;
+
+    QElapsedTimer timer;
+    timer.start();
+    try
+    {
+        FlowRunner runner;
+        runner.setNbThreads(1);
+        runner.setGenus(genus);
+        runner.setMeshDepth(meshDepth);
+        runner.setRhoDomain(result.coordinates.FNLengthsDomain, result.coordinates.FNTwistsDomain);
+        runner.setRhoImage(result.coordinates.FNLengthsImage, result.coordinates.FNTwistsImage);
+        runner.setFlowChoice(flowChoice);
+        runner.setTolerance(tolerance);
+        runner.setMaxNbIterations(maxNbIterations);
+        runner.setAndersonMemory(andersonMemory);
+        runner.setOverRelaxationFactor(overRelaxationFactor);
+        runner.run();
+
+        result.isComputed = true;
+        result.hasConverged = runner.hasConverged();
+        result.nbIterations = runner.getNbIterations();
+        result.energy = runner.getEnergy();
+        result.supError = runner.getSupError();
+    }
+    catch(QString errorMessage)
+    {
+        result.errorMessage = errorMessage;
+    }
+    catch(const std::exception &exception)
+    {
+        // For instance std::bad_alloc on a fine mesh: the point fails, the other points of the sweep go on
+        result.errorMessage = QString("Error in ParameterSweep::runPoint: %1").arg(exception.what());
+    }
+    catch(...)
+    {
+        result.errorMessage = QString("Error in ParameterSweep::runPoint: unknown exception");
+    }
+    result.wallTime = timer.nsecsElapsed()*1e-9;
+}
+
+void ParameterSweep::writeTable(const QString &fileName) const
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        throw(QString("Error in ParameterSweep::writeTable: cannot open %1").arg(fileName));
+    }
+    QTextStream out(&file);
+    out.setRealNumberPrecision(17);
+
+    // Tab separated, one row per point. The FN coordinates are comma separated.
+    out << "index\tdomain FN lengths\tdomain FN twists\timage FN lengths\timage FN twists\t"
+        << "energy\titerations\tsup error\tconverged\twall time (s)\terror\n";
+    for (uint i=0; i!=results.size(); ++i)
+    {
+        const Result &result = results[i];
+        out << i << "\t"
+            << Tools::joinNumbers(result.coordinates.FNLengthsDomain) << "\t"
+            << Tools::joinNumbers(result.coordinates.FNTwistsDomain) << "\t"
+            << Tools::joinNumbers(result.coordinates.FNLengthsImage) << "\t"
+            << Tools::joinNumbers(result.coordinates.FNTwistsImage) << "\t";
+        if (result.isComputed)
+        {
+            out << result.energy << "\t" << result.nbIterations << "\t" << result.supError << "\t"
+                << (result.hasConverged ? "yes" : "no") << "\t" << result.wallTime << "\t\n";
+        }
+        else
+        {
+            QString errorMessage = result.errorMessage;
+            errorMessage.replace('\t', ' ').replace('\n', ' ');
+            out << "\t\t\tno\t" << result.wallTime << "\t" << errorMessage << "\n";
+        }
+    }
+
+    if (!file.commit())
+    {
+        throw(QString("Error in ParameterSweep::writeTable: cannot write %1").arg(fileName));
+    }
+}
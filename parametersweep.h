@@ -0,0 +1,67 @@
+#ifndef PARAMETERSWEEP_H
+#define PARAMETERSWEEP_H
+
+#include <atomic>
+
+#include "tools.h"
+
+
+// Runs the flow for a list of Fenchel-Nielsen coordinates of the domain and image representations, with a common genus,
+// mesh depth and flow method. The coordinates are given one by one, as a grid or as random samples in a box.
+// The runs are done concurrently by nbJobs threads (one per core by default), each run using one thread,
+// and each run gives one row of the table of results.
+
+class ParameterSweep
+{
+public:
+    struct Coordinates
+    {
+        std::vector<double> FNLengthsDomain, FNTwistsDomain, FNLengthsImage, FNTwistsImage;
+    };
+
+    struct Result
+    {
+        Coordinates coordinates;
+        bool isComputed, hasConverged;
+        QString errorMessage;
+        uint nbIterations;
+        double energy, supError, wallTime;
+    };
+
+    ParameterSweep(uint genus, uint meshDepth, int flowChoice);
+    ParameterSweep(const ParameterSweep &) = delete;
+    ParameterSweep & operator=(ParameterSweep) = delete;
+
+    void setTolerance(double tolerance);
+    void setMaxNbIterations(uint maxNbIterations);
+    void setNbJobs(uint nbJobs);
+    void setAndersonMemory(uint andersonMemory);
+    void setOverRelaxationFactor(double overRelaxationFactor);
+
+    void addPoint(const Coordinates &coordinates);
+    void addGrid(const Coordinates &minimum, const Coordinates &maximum, uint nbStepsPerCoordinate);
+    void addRandomSamples(const Coordinates &minimum, const Coordinates &maximum, uint nbSamples, uint seed);
+    uint getNbPoints() const {return points.size();}
+
+    void run();
+    const std::vector<Result> & getResults() const {return results;}
+    double getWallTime() const {return wallTime;}
+    void writeTable(const QString &fileName) const;
+
+private:
+    void checkCoordinates(const Coordinates &coordinates) const;
+    static std::vector<double> flatten(const Coordinates &coordinates);
+    Coordinates unflatten(const std::vector<double> &flatCoordinates) const;
+    void workerLoop();
+    void runPoint(uint index);
+
+    uint genus, meshDepth, maxNbIterations, nbJobs, andersonMemory;
+    int flowChoice;
+    double tolerance, wallTime, overRelaxationFactor;
+
+    std::vector<Coordinates> points;
+    std::vector<Result> results;
+    std::atomic<uint> nextPoint;
+};
+
+#endif // PARAMETERSWEEP_H
@@ -0,0 +1,176 @@
+#include "profiler.h"
+
+#ifdef HARMONY_PROFILE
+
+#include <chrono>
+#include <mutex>
+#include <QSaveFile>
+#include <QTextStream>
+
+namespace
+{
+
+struct Event
+{
+    const char *name;
+    char phase;
+    long long timestamp, duration;
+    double value;
+};
+
+// The buffers are shared with the registry, so that the events of a thread are kept after it finishes
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    std::vector<Event> events;
+    uint threadIndex;
+    const char *threadName;
+};
+
+std::mutex registryMutex;
+std::vector< std::shared_ptr<ThreadBuffer> > registry;
+const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+long long now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+std::shared_ptr<ThreadBuffer> registerThread()
+{
+    std::shared_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+    buffer->threadName = nullptr;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->threadIndex = registry.size() + 1;
+    registry.push_back(buffer);
+    return buffer;
+}
+
+ThreadBuffer & threadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer = registerThread();
+    return *buffer;
+}
+
+void record(const Event &event)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back(event);
+}
+
+}
+
+Profiler::Scope::Scope(const char *name) : name(name), begin(now())
+{
+}
+
+Profiler::Scope::~Scope()
+{
+    Event event;
+    event.name = name;
+    event.phase = 'X';
+    event.timestamp = begin;
+    event.duration = now() - begin;
+    event.value = 0.0;
+    record(event);
+}
+
+bool Profiler::isEnabled()
+{
+    return true;
+}
+
+void Profiler::setThreadName(const char *name)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.threadName = name;
+}
+
+void Profiler::counter(const char *name, double value)
+{
+    Event event;
+    event.name = name;
+    event.phase = 'C';
+    event.timestamp = now();
+    event.duration = 0;
+    event.value = value;
+    record(event);
+}
+
+void Profiler::writeChromeTrace(const QString &fileName)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        throw(QString("Error in Profiler::writeChromeTrace: cannot open %1").arg(fileName));
+    }
+    QTextStream out(&file);
+    out.setRealNumberPrecision(17);
+
+    // Timestamps and durations are in microseconds
+    out << "{\"traceEvents\":[\n";
+    bool isFirst = true;
+    std::lock_guard<std::mutex> registryLock(registryMutex);
+    for (const auto & buffer : registry)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (buffer->threadName != nullptr)
+        {
+            out << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIndex
+                << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+            isFirst = false;
+        }
+        for (const auto & event : buffer->events)
+        {
+            out << (isFirst ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":"
+                << buffer->threadIndex << ",\"ts\":" << event.timestamp*1e-3;
+            if (event.phase == 'X')
+            {
+                out << ",\"dur\":" << event.duration*1e-3 << "}";
+            }
+            else
+            {
+                out << ",\"args\":{\"value\":" << event.value << "}}";
+            }
+            isFirst = false;
+        }
+    }
+    out << "\n]}\n";
+
+    if (!file.commit())
+    {
+        throw(QString("Error in Profiler::writeChromeTrace: cannot write %1").arg(fileName));
+    }
+}
+
+#else
+
+Profiler::Scope::Scope(const char *name) : name(name), begin(0)
+{
+}
+
+Profiler::Scope::~Scope()
+{
+}
+
+bool Profiler::isEnabled()
+{
+    return false;
+}
+
+void Profiler::setThreadName(const char *)
+{
+}
+
+void Profiler::counter(const char *, double)
+{
+}
+
+void Profiler::writeChromeTrace(const QString &)
+{
+    throw(QString("Error in Profiler::writeChromeTrace: compiled without HARMONY_PROFILE"));
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "tools.h"
+
+
+// Scoped timers and counters for the hot paths, compiled only with HARMONY_PROFILE defined (see harmonycore.pri):
+// otherwise PROFILE_SCOPE and PROFILE_COUNTER expand to nothing.
+// PROFILE_SCOPE(name) times the enclosing scope and PROFILE_COUNTER(name, value) records a value; name must be a string literal.
+// Each thread records its events in its own buffer, and writeChromeTrace() writes the events of all the threads on one timeline,
+// in the Chrome trace event format (open the file in chrome://tracing or ui.perfetto.dev).
+
+class Profiler
+{
+public:
+    class Scope
+    {
+    public:
+        explicit Scope(const char *name);
+        Scope(const Scope &) = delete;
+        Scope & operator=(Scope) = delete;
+        ~Scope();
+
+    private:
+        const char *name;
+        long long begin;
+    };
+
+    static bool isEnabled();
+    static void setThreadName(const char *name);
+    static void counter(const char *name, double value);
+    static void writeChromeTrace(const QString &fileName);
+};
+
+#ifdef HARMONY_PROFILE
+#define PROFILE_CONCATENATE_IMPLEMENTATION(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_IMPLEMENTATION(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCATENATE(profilerScope, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::counter(name, value)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNTER(name, value)
+#endif
+
+#endif // PROFILER_H
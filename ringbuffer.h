@@ -0,0 +1,72 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+
+#include "tools.h"
+
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// push() fails instead of blocking when the queue is full, and pop() fails when it is empty.
+// The capacity is rounded up to a power of 2.
+
+template <typename T> class RingBuffer
+{
+public:
+    explicit RingBuffer(uint capacity);
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer & operator=(RingBuffer) = delete;
+
+    bool push(const T &item);
+    bool pop(T &itemOut);
+    uint getCapacity() const {return items.size();}
+
+private:
+    std::vector<T> items;
+    unsigned long long mask;
+
+    // head is only written by the producer and tail by the consumer: they are kept on different cache lines
+    char paddingBefore[64];
+    std::atomic<unsigned long long> head;
+    char paddingBetween[64];
+    std::atomic<unsigned long long> tail;
+    char paddingAfter[64];
+};
+
+
+template <typename T> RingBuffer<T>::RingBuffer(uint capacity) : head(0), tail(0)
+{
+    uint size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    items.resize(size);
+    mask = size - 1;
+}
+
+template <typename T> bool RingBuffer<T>::push(const T &item)
+{
+    unsigned long long currentHead = head.load(std::memory_order_relaxed);
+    if (currentHead - tail.load(std::memory_order_acquire) == items.size())
+    {
+        return false;
+    }
+    items[currentHead & mask] = item;
+    head.store(currentHead + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T> bool RingBuffer<T>::pop(T &itemOut)
+{
+    unsigned long long currentTail = tail.load(std::memory_order_relaxed);
+    if (currentTail == head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    itemOut = items[currentTail & mask];
+    tail.store(currentTail + 1, std::memory_order_release);
+    return true;
+}
+
+#endif // RINGBUFFER_H
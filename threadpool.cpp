@@ -0,0 +1,152 @@
+#include "threadpool.h"
+
+
+ThreadPool::ThreadPool(uint nbThreads) : nbThreads(0), stopping(false), generation(0), nbBusyWorkers(0),
+    taskInvoke(nullptr), taskContext(nullptr), nbTasks(0), nextTask(0), nbTasksDone(0)
+{
+    setNbThreads(nbThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    stopWorkers();
+}
+
+uint ThreadPool::getNbThreads() const
+{
+    return nbThreads;
+}
+
+uint ThreadPool::defaultNbThreads()
+{
+    uint nbCores = std::thread::hardware_concurrency();
+    return nbCores == 0 ? 1 : nbCores;
+}
+
+void ThreadPool::setNbThreads(uint nbThreads)
+{
+    if (nbThreads == 0)
+    {
+        nbThreads = defaultNbThreads();
+    }
+    if (nbThreads == this->nbThreads)
+    {
+        return;
+    }
+
+    stopWorkers();
+    this->nbThreads = nbThreads;
+    startWorkers();
+}
+
+void ThreadPool::startWorkers()
+{
+    stopping = false;
+
+    // The calling thread works too, so nbThreads - 1 workers are needed
+    workers.reserve(nbThreads - 1);
+    for (uint i=1; i<nbThreads; ++i)
+    {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+void ThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned long long seenGeneration = 0;
+    void (*invoke)(void *, uint);
+    void *context;
+    uint nbTasks;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&]{return stopping || generation != seenGeneration;});
+            if (stopping)
+            {
+                return;
+            }
+            seenGeneration = generation;
+            invoke = taskInvoke;
+            context = taskContext;
+            nbTasks = this->nbTasks;
+            ++nbBusyWorkers;
+        }
+
+        work(invoke, context, nbTasks);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --nbBusyWorkers;
+        }
+        doneCondition.notify_all();
+    }
+}
+
+void ThreadPool::work(void (*invoke)(void *, uint), void *context, uint nbTasks)
+{
+    uint taskIndex;
+    while ((taskIndex = nextTask.fetch_add(1)) < nbTasks)
+    {
+        try
+        {
+            invoke(context, taskIndex);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!taskException)
+            {
+                taskException = std::current_exception();
+            }
+        }
+        nbTasksDone.fetch_add(1);
+    }
+}
+
+void ThreadPool::runTasks(uint nbTasks, void (*invoke)(void *, uint), void *context)
+{
+    {
+        // A worker which woke up late for the previous batch must be done with it before the counters are reset
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [&]{return nbBusyWorkers == 0;});
+        taskInvoke = invoke;
+        taskContext = context;
+        this->nbTasks = nbTasks;
+        nextTask = 0;
+        nbTasksDone = 0;
+        taskException = nullptr;
+        ++generation;
+    }
+    wakeCondition.notify_all();
+
+    work(invoke, context, nbTasks);
+
+    std::exception_ptr exception;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [&]{return nbBusyWorkers == 0 && nbTasksDone == nbTasks;});
+        exception = taskException;
+        taskException = nullptr;
+    }
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
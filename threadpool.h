@@ -0,0 +1,89 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+#include "tools.h"
+
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint nbThreads = 1);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(ThreadPool) = delete;
+    ~ThreadPool();
+
+    uint getNbThreads() const;
+    void setNbThreads(uint nbThreads);
+
+    template <typename Function> void parallelFor(uint begin, uint end, Function &f);
+    static uint defaultNbThreads();
+
+private:
+    template <typename Function> struct ParallelForTask
+    {
+        Function *f;
+        uint begin, size, nbChunks;
+    };
+    template <typename Function> static void invokeChunk(void *context, uint chunkIndex);
+
+    void startWorkers();
+    void stopWorkers();
+    void workerLoop();
+    void work(void (*invoke)(void *, uint), void *context, uint nbTasks);
+    void runTasks(uint nbTasks, void (*invoke)(void *, uint), void *context);
+
+    uint nbThreads;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition, doneCondition;
+    bool stopping;
+    unsigned long long generation;
+    uint nbBusyWorkers;
+
+    void (*taskInvoke)(void *, uint);
+    void *taskContext;
+    uint nbTasks;
+    std::atomic<uint> nextTask, nbTasksDone;
+    std::exception_ptr taskException;
+};
+
+
+template <typename Function> void ThreadPool::invokeChunk(void *context, uint chunkIndex)
+{
+    const ParallelForTask<Function> *task = static_cast<const ParallelForTask<Function>*>(context);
+    uint chunkBegin = task->begin + static_cast<uint>((static_cast<unsigned long long>(task->size)*chunkIndex)/task->nbChunks);
+    uint chunkEnd = task->begin + static_cast<uint>((static_cast<unsigned long long>(task->size)*(chunkIndex + 1))/task->nbChunks);
+    (*task->f)(chunkBegin, chunkEnd);
+}
+
+template <typename Function> void ThreadPool::parallelFor(uint begin, uint end, Function &f)
+{
+    // f(chunkBegin, chunkEnd) is called on disjoint contiguous chunks covering [begin, end).
+    // The chunks only depend on the range and the number of threads, not on scheduling.
+    if (end <= begin)
+    {
+        return;
+    }
+    uint size = end - begin;
+    if (nbThreads == 1 || size < 2*nbThreads)
+    {
+        f(begin, end);
+        return;
+    }
+
+    ParallelForTask<Function> task;
+    task.f = &f;
+    task.begin = begin;
+    task.size = size;
+    task.nbChunks = nbThreads;
+    runTasks(nbThreads, &ThreadPool::invokeChunk<Function>, &task);
+}
+
+#endif // THREADPOOL_H
@@ -49,3 +49,18 @@ std::string Tools::convertToString(int i)
     return s;
 }
 
+QString Tools::joinNumbers(const std::vector<double> &V)
+{
+    // Comma separated, with enough digits to read back the same doubles
+    QString s;
+    for (uint i=0; i!=V.size(); ++i)
+    {
+        if (i != 0)
+        {
+            s += ",";
+        }
+        s += QString::number(V[i], 'g', 17);
+    }
+    return s;
+}
+
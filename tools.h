@@ -53,6 +53,7 @@ template <typename T> T exponentiation(T base, int power)
 }
 
 std::string convertToString(int i);
+QString joinNumbers(const std::vector<double> &V);
 
 template <typename T> std::vector<uint> findInList(const T &x, const std::vector<T> &V)
 {
@@ -35,15 +35,19 @@ void TopFactory::stopTimers()
 
 void TopFactory::sendLiveMessageForStatusBar()
 {
-    nbIterations = h2factory.getNbIterations();
-    double error = h2factory.getSupError();
+    // The flow runs in h2factory's thread: its progress is read from a snapshot
+    FlowProgress::Snapshot progress = h2factory.getProgress();
     QString message = QString("Iterating discrete heat flow (for %1 mesh vertices)...          Iterations :  %2 Error :  %3 (target: %4)%5 Time elapsed :  %6s")
             .arg(nbVertices)
-            .arg(nbIterations, -13)
-            .arg(error, 0, 'e', 2)
-            .arg(h2factory.getTolerance(), 0, 'e', 2)
+            .arg(progress.nbIterations, -13)
+            .arg(progress.supError, 0, 'e', 2)
+            .arg(progress.tolerance, 0, 'e', 2)
             .arg("", -13)
             .arg(time->elapsed()*0.001, 0, 'g');
+    if (progress.isRunning && progress.remainingTime >= 0.0)
+    {
+        message += QString("  Time remaining :  ~%1s").arg(progress.remainingTime, 0, 'f', 1);
+    }
     handler->showStatusBarMessage(message);
 }
 
@@ -0,0 +1,308 @@
+#include "trianglerasterizer.h"
+
+#include <cmath>
+
+
+std::unique_ptr<ThreadPool> TriangleRasterizer::threadPool;
+std::mutex TriangleRasterizer::threadPoolMutex;
+
+TriangleRasterizer::TriangleRasterizer(uint tileSize) : tileSize(tileSize)
+{
+    if (tileSize == 0)
+    {
+        throw(QString("Error in TriangleRasterizer::TriangleRasterizer: tiles must not be empty"));
+    }
+}
+
+void TriangleRasterizer::clear()
+{
+    verticesX.clear();
+    verticesY.clear();
+    colors.clear();
+}
+
+void TriangleRasterizer::reserve(uint nbTriangles)
+{
+    verticesX.reserve(3*nbTriangles);
+    verticesY.reserve(3*nbTriangles);
+    colors.reserve(nbTriangles);
+}
+
+uint TriangleRasterizer::getNbTriangles() const
+{
+    return colors.size();
+}
+
+void TriangleRasterizer::addTriangle(double xA, double yA, double xB, double yB, double xC, double yC, uint color)
+{
+    double x[3] = {xA, xB, xC}, y[3] = {yA, yB, yC};
+    double cross = (xB - xA)*(yC - yA) - (yB - yA)*(xC - xA);
+    double lengths[3], normalsX[3], normalsY[3];
+    uint k, next, previous;
+    for (k=0; k!=3; ++k)
+    {
+        next = (k + 1) % 3;
+        lengths[k] = std::sqrt((x[next] - x[k])*(x[next] - x[k]) + (y[next] - y[k])*(y[next] - y[k]));
+    }
+
+    // A flat triangle is kept as it is, and covers nothing
+    if (std::abs(cross) > 1e-12 && lengths[0] > 1e-12 && lengths[1] > 1e-12 && lengths[2] > 1e-12)
+    {
+        // Outward unit normal of side k, from vertex k to vertex k+1
+        double orientation = (cross > 0.0) ? 1.0 : -1.0;
+        for (k=0; k!=3; ++k)
+        {
+            next = (k + 1) % 3;
+            normalsX[k] = orientation*(y[next] - y[k])/lengths[k];
+            normalsY[k] = -orientation*(x[next] - x[k])/lengths[k];
+        }
+
+        // Each vertex moves to the intersection of its two sides pushed out by half a pixel, at most one pixel away (miter limit 2)
+        double halfWidth = 0.5, dot, miterX, miterY, miterLength, grownX[3], grownY[3];
+        for (k=0; k!=3; ++k)
+        {
+            previous = (k + 2) % 3;
+            dot = normalsX[previous]*normalsX[k] + normalsY[previous]*normalsY[k];
+            miterX = (normalsX[previous] + normalsX[k])*halfWidth/(1.0 + dot);
+            miterY = (normalsY[previous] + normalsY[k])*halfWidth/(1.0 + dot);
+            miterLength = std::sqrt(miterX*miterX + miterY*miterY);
+            if (miterLength > 2.0*halfWidth)
+            {
+                miterX *= 2.0*halfWidth/miterLength;
+                miterY *= 2.0*halfWidth/miterLength;
+            }
+            grownX[k] = x[k] + miterX;
+            grownY[k] = y[k] + miterY;
+        }
+        for (k=0; k!=3; ++k)
+        {
+            x[k] = grownX[k];
+            y[k] = grownY[k];
+        }
+    }
+
+    for (k=0; k!=3; ++k)
+    {
+        verticesX.push_back(x[k]);
+        verticesY.push_back(y[k]);
+    }
+    colors.push_back(color & 0xFFFFFF);
+}
+
+void TriangleRasterizer::binTriangles(uint width, uint height, uint nbTilesX, uint nbTilesY)
+{
+    // Count the triangles of each tile, then fill the tiles in increasing order of triangles
+    uint nbTriangles = getNbTriangles(), t, i, j;
+    std::vector<uint> trianglesTiles(4*nbTriangles);
+    std::vector<bool> isTriangleInImage(nbTriangles);
+    tilesOffsets.assign(nbTilesX*nbTilesY + 1, 0);
+    double xMin, xMax, yMin, yMax;
+    for (t=0; t!=nbTriangles; ++t)
+    {
+        xMin = std::min(verticesX[3*t], std::min(verticesX[3*t + 1], verticesX[3*t + 2]));
+        xMax = std::max(verticesX[3*t], std::max(verticesX[3*t + 1], verticesX[3*t + 2]));
+        yMin = std::min(verticesY[3*t], std::min(verticesY[3*t + 1], verticesY[3*t + 2]));
+        yMax = std::max(verticesY[3*t], std::max(verticesY[3*t + 1], verticesY[3*t + 2]));
+        isTriangleInImage[t] = (xMax > 0.0) && (xMin < width) && (yMax > 0.0) && (yMin < height);
+        if (!isTriangleInImage[t])
+        {
+            continue;
+        }
+        trianglesTiles[4*t] = uint(std::max(xMin, 0.0))/tileSize;
+        trianglesTiles[4*t + 1] = uint(std::min(xMax, width - 1.0))/tileSize;
+        trianglesTiles[4*t + 2] = uint(std::max(yMin, 0.0))/tileSize;
+        trianglesTiles[4*t + 3] = uint(std::min(yMax, height - 1.0))/tileSize;
+        for (j=trianglesTiles[4*t + 2]; j<=trianglesTiles[4*t + 3]; ++j)
+        {
+            for (i=trianglesTiles[4*t]; i<=trianglesTiles[4*t + 1]; ++i)
+            {
+                ++tilesOffsets[j*nbTilesX + i + 1];
+            }
+        }
+    }
+    for (i=0; i!=nbTilesX*nbTilesY; ++i)
+    {
+        tilesOffsets[i + 1] += tilesOffsets[i];
+    }
+
+    tilesTriangles.resize(tilesOffsets.back());
+    std::vector<uint> tilesNextPositions(tilesOffsets.begin(), tilesOffsets.end() - 1);
+    for (t=0; t!=nbTriangles; ++t)
+    {
+        if (!isTriangleInImage[t])
+        {
+            continue;
+        }
+        for (j=trianglesTiles[4*t + 2]; j<=trianglesTiles[4*t + 3]; ++j)
+        {
+            for (i=trianglesTiles[4*t]; i<=trianglesTiles[4*t + 1]; ++i)
+            {
+                tilesTriangles[tilesNextPositions[j*nbTilesX + i]++] = t;
+            }
+        }
+    }
+}
+
+void TriangleRasterizer::rasterize(uint *pixels, uint width, uint height, uint pixelsPerLine)
+{
+    if (width == 0 || height == 0 || getNbTriangles() == 0)
+    {
+        return;
+    }
+
+    uint nbTilesX = (width + tileSize - 1)/tileSize, nbTilesY = (height + tileSize - 1)/tileSize, nbTiles = nbTilesX*nbTilesY;
+    binTriangles(width, height, nbTilesX, nbTilesY);
+
+    std::unique_lock<std::mutex> lock(threadPoolMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        std::vector<double> coverage(tileSize, 0.0);
+        for (uint c=0; c!=nbTiles; ++c)
+        {
+            fillTile(c, nbTilesX, width, height, pixels, pixelsPerLine, coverage);
+        }
+        return;
+    }
+    if (!threadPool)
+    {
+        threadPool.reset(new ThreadPool(ThreadPool::defaultNbThreads()));
+    }
+
+    // The chunks of the thread pool are contiguous: list the tiles so that every chunk takes tiles from all over the image
+    uint nbThreads = threadPool->getNbThreads();
+    std::vector<uint> tilesOrder;
+    tilesOrder.reserve(nbTiles);
+    for (uint first=0; first!=std::min(nbThreads, nbTiles); ++first)
+    {
+        for (uint c=first; c<nbTiles; c+=nbThreads)
+        {
+            tilesOrder.push_back(c);
+        }
+    }
+
+    auto fillChunk = [&](uint begin, uint end)
+    {
+        std::vector<double> coverage(tileSize, 0.0);
+        for (uint k=begin; k!=end; ++k)
+        {
+            fillTile(tilesOrder[k], nbTilesX, width, height, pixels, pixelsPerLine, coverage);
+        }
+    };
+    threadPool->parallelFor(0, nbTiles, fillChunk);
+}
+
+void TriangleRasterizer::fillTile(uint tileIndex, uint nbTilesX, uint width, uint height, uint *pixels, uint pixelsPerLine, std::vector<double> &coverage) const
+{
+    uint x0 = (tileIndex % nbTilesX)*tileSize, y0 = (tileIndex / nbTilesX)*tileSize;
+    uint x1 = std::min(x0 + tileSize, width), y1 = std::min(y0 + tileSize, height);
+    for (uint k=tilesOffsets[tileIndex]; k!=tilesOffsets[tileIndex + 1]; ++k)
+    {
+        fillTriangleInTile(tilesTriangles[k], x0, y0, x1, y1, pixels, pixelsPerLine, coverage);
+    }
+}
+
+void TriangleRasterizer::fillTriangleInTile(uint triangleIndex, uint x0, uint y0, uint x1, uint y1,
+                                            uint *pixels, uint pixelsPerLine, std::vector<double> &coverage) const
+{
+    // Vertices a, b, c sorted by increasing y
+    double ax = verticesX[3*triangleIndex], ay = verticesY[3*triangleIndex];
+    double bx = verticesX[3*triangleIndex + 1], by = verticesY[3*triangleIndex + 1];
+    double cx = verticesX[3*triangleIndex + 2], cy = verticesY[3*triangleIndex + 2];
+    if (ay > by)
+    {
+        std::swap(ax, bx);
+        std::swap(ay, by);
+    }
+    if (by > cy)
+    {
+        std::swap(bx, cx);
+        std::swap(by, cy);
+    }
+    if (ay > by)
+    {
+        std::swap(ax, bx);
+        std::swap(ay, by);
+    }
+    if (cy <= ay)
+    {
+        return;
+    }
+
+    uint color = colors[triangleIndex];
+    double subScanlineWeight = 1.0/nbSubScanlines, subY, left, right;
+    uint rowBegin = std::max(y0, uint(std::max(ay, 0.0))), rowEnd = uint(std::min(double(y1), std::ceil(cy)));
+    uint row, s, i, iLeft, iRight, spanBegin, spanEnd;
+    uint *line;
+    for (row=rowBegin; row<rowEnd; ++row)
+    {
+        spanBegin = x1;
+        spanEnd = x0;
+        for (s=0; s!=nbSubScanlines; ++s)
+        {
+            subY = row + (s + 0.5)*subScanlineWeight;
+            if (subY < ay || subY >= cy)
+            {
+                continue;
+            }
+
+            left = ax + (subY - ay)*(cx - ax)/(cy - ay);
+            right = (subY < by) ? ax + (subY - ay)*(bx - ax)/(by - ay) : bx + (subY - by)*(cx - bx)/(cy - by);
+            if (left > right)
+            {
+                std::swap(left, right);
+            }
+            left = std::max(left, double(x0));
+            right = std::min(right, double(x1));
+            if (left >= right)
+            {
+                continue;
+            }
+
+            // Exact horizontal coverage of the span [left, right] on the pixels of the sub-scanline
+            iLeft = uint(left);
+            iRight = std::min(uint(right), x1 - 1);
+            if (iLeft == iRight)
+            {
+                coverage[iLeft - x0] += (right - left)*subScanlineWeight;
+            }
+            else
+            {
+                coverage[iLeft - x0] += (iLeft + 1 - left)*subScanlineWeight;
+                for (i=iLeft + 1; i<iRight; ++i)
+                {
+                    coverage[i - x0] += subScanlineWeight;
+                }
+                coverage[iRight - x0] += (right - iRight)*subScanlineWeight;
+            }
+            spanBegin = std::min(spanBegin, iLeft);
+            spanEnd = std::max(spanEnd, iRight + 1);
+        }
+
+        line = pixels + row*pixelsPerLine;
+        for (i=spanBegin; i<spanEnd; ++i)
+        {
+            if (coverage[i - x0] > 0.0)
+            {
+                line[i] = blend(line[i], color, coverage[i - x0]);
+            }
+            coverage[i - x0] = 0.0;
+        }
+    }
+}
+
+uint TriangleRasterizer::blend(uint destination, uint color, double coverage)
+{
+    // Source over, with an opaque source of alpha coverage, on premultiplied ARGB32
+    uint alpha = Tools::intRound(256.0*std::min(coverage, 1.0));
+    if (alpha >= 256)
+    {
+        return 0xFF000000 | color;
+    }
+    uint source = 0xFF000000 | color, res = 0, shift, channel;
+    for (shift=0; shift!=32; shift+=8)
+    {
+        channel = ((((source >> shift) & 0xFF)*alpha + ((destination >> shift) & 0xFF)*(256 - alpha)) >> 8);
+        res |= channel << shift;
+    }
+    return res;
+}
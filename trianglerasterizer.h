@@ -0,0 +1,56 @@
+#ifndef TRIANGLERASTERIZER_H
+#define TRIANGLERASTERIZER_H
+
+#include <mutex>
+
+#include "tools.h"
+#include "threadpool.h"
+
+
+// Antialiased filling of many opaque triangles into an ARGB32 premultiplied image, each one drawn over the previous ones.
+// Each triangle is grown by half a pixel on each side, like a triangle filled and outlined with a one pixel wide pen of its color,
+// so that neighbouring triangles leave no gaps between them.
+// The image is cut into square tiles, each tile lists the triangles meeting it in the order they were added, and the tiles are filled
+// in parallel, each by a single thread. The coverage of a pixel is measured exactly along a few sub-scanlines per row of pixels.
+// All the rasterizers share one pool with one thread per core, created by the first rasterization.
+// A rasterization starting while another one uses the pool fills its tiles on the calling thread instead of waiting.
+class TriangleRasterizer
+{
+public:
+    explicit TriangleRasterizer(uint tileSize = 64);
+    TriangleRasterizer(const TriangleRasterizer &) = delete;
+    TriangleRasterizer & operator=(TriangleRasterizer) = delete;
+
+    void clear();
+    void reserve(uint nbTriangles);
+    uint getNbTriangles() const;
+
+    // Pixel (i, j) is the square [i, i+1] x [j, j+1]; color is 0xRRGGBB
+    void addTriangle(double xA, double yA, double xB, double yB, double xC, double yC, uint color);
+
+    // Pixel (i, j) is pixels[j*pixelsPerLine + i], for 0 <= i < width and 0 <= j < height
+    void rasterize(uint *pixels, uint width, uint height, uint pixelsPerLine);
+
+private:
+    static const uint nbSubScanlines = 4;
+
+    static std::unique_ptr<ThreadPool> threadPool;
+    static std::mutex threadPoolMutex;
+
+    void binTriangles(uint width, uint height, uint nbTilesX, uint nbTilesY);
+    void fillTile(uint tileIndex, uint nbTilesX, uint width, uint height, uint *pixels, uint pixelsPerLine, std::vector<double> &coverage) const;
+    void fillTriangleInTile(uint triangleIndex, uint x0, uint y0, uint x1, uint y1,
+                            uint *pixels, uint pixelsPerLine, std::vector<double> &coverage) const;
+    static uint blend(uint destination, uint color, double coverage);
+
+    uint tileSize;
+
+    // Triangle t has vertices (verticesX[3t+k], verticesY[3t+k]), already grown, and color colors[t]
+    std::vector<double> verticesX, verticesY;
+    std::vector<uint> colors;
+
+    // The triangles meeting tile c are tilesTriangles[tilesOffsets[c]], ..., tilesTriangles[tilesOffsets[c+1] - 1], in increasing order
+    std::vector<uint> tilesOffsets, tilesTriangles;
+};
+
+#endif // TRIANGLERASTERIZER_H
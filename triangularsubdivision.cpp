@@ -4,226 +4,85 @@
 
 template <typename Point> TriangularSubdivision<Point>::TriangularSubdivision()
 {
-    A.reset();
-    B.reset();
-    C.reset();
-    O.reset();
-    points.reset();
+    depth = 0;
 }
 
-template <typename Point> TriangularSubdivision<Point>::TriangularSubdivision(const TriangularSubdivision<Point> &other)
+template <typename Point> TriangularSubdivision<Point>::TriangularSubdivision(uint depth) : depth(depth), points(nbPoints(depth))
 {
-    if (other.points != nullptr)
-    {
-        points = std::make_shared< std::vector<Point> >(*other.points);
-        copy(other, points);
-    }
-    else
-    {
-        A.reset();
-        B.reset();
-        C.reset();
-        O.reset();
-        points.reset();
-    }
 }
 
-template <typename Point> void TriangularSubdivision<Point>::copy(const TriangularSubdivision<Point> &other, std::shared_ptr< std::vector<Point> > points)
+template <typename Point> TriangularSubdivision<Point>::TriangularSubdivision(const std::vector<Point> &points, uint depth)
 {
-    aIndex = other.aIndex;
-    bIndex = other.bIndex;
-    cIndex = other.cIndex;
-    depth = other.depth;
-    totalDepth = other.totalDepth;
-    this->points = points;
-
-    if (depth == 0)
+    if (nbPoints(depth) == points.size())
     {
-        A.reset();
-        B.reset();
-        C.reset();
-        O.reset();
+        this->depth = depth;
+        this->points = points;
     }
     else
     {
-        A = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-        B = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-        C = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-        O = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-
-        /* C++14
-        A = std::make_unique< TriangularSubdivision<Point> >();
-        B = std::make_unique< TriangularSubdivision<Point> >();
-        C = std::make_unique< TriangularSubdivision<Point> >();
-        O = std::make_unique< TriangularSubdivision<Point>> ();
-        */
-
-        A->copy(*other.A, points);
-        B->copy(*other.B, points);
-        C->copy(*other.C, points);
-        O->copy(*other.O, points);
+        throw(QString("Error in H2TriangleSubdivision::H2TriangleSubdivision(const std::vector<H2Point> &points, int depth): points.size() does not match expected size"));
     }
 }
 
-template <typename S> void swap(TriangularSubdivision<S> &first, TriangularSubdivision<S> &second)
+template <typename Point> uint TriangularSubdivision<Point>::index(uint n, uint p)
 {
-    std::swap(first.A, second.A);
-    std::swap(first.B, second.B);
-    std::swap(first.C, second.C);
-    std::swap(first.O, second.O);
-
-    std::swap(first.aIndex, second.aIndex);
-    std::swap(first.bIndex, second.bIndex);
-    std::swap(first.cIndex, second.cIndex);
-
-    std::swap(first.depth, second.depth);
-    std::swap(first.totalDepth, second.totalDepth);
-    std::swap(first.points, second.points);
-}
-
-template <typename Point> TriangularSubdivision<Point> & TriangularSubdivision<Point>::operator=(TriangularSubdivision<Point> other)
-{
-    swap(*this, other);
-    return *this;
-}
-
-template <typename Point> TriangularSubdivision<Point>::TriangularSubdivision(uint depth)
-{
-    points = std::make_shared< std::vector<Point> >();
-    this->depth = depth;
-    totalDepth = depth;
-    uint L = nbLines(depth), N = nbPoints(depth);
-
-    uint an = 0, ap = 0, bn = L - 1, bp = 0, cn = L - 1, cp = L - 1;
-    aIndex = 0;
-    cIndex = N - 1;
-    bIndex = cIndex - cp;
-
-    constructIndices(aIndex, bIndex, cIndex, depth, depth, an, bn, cn, ap, bp, cp, points);
-}
-
-template <typename Point> void TriangularSubdivision<Point>::constructIndices(uint aIndex, uint bIndex, uint cIndex, uint depth, uint totalDepth,
-                                                                              uint an, uint bn, uint cn, uint ap, uint bp, uint cp,
-                                                                              std::shared_ptr< std::vector<Point> > points)
-{
-    this->aIndex = aIndex;
-    this->bIndex = bIndex;
-    this->cIndex = cIndex;
-    this->depth = depth;
-    this->totalDepth = totalDepth;
-    this->points = points;
-
-    if (depth == 0)
-    {
-        A.reset();
-        B.reset();
-        C.reset();
-        O.reset();
-    }
-    else
-    {
-        uint midabn = (an + bn)/2, midacn = (an + cn)/2, midbcn = (bn + cn)/2;
-        uint midabp = (ap + bp)/2, midacp = (ap + cp)/2, midbcp = (bp + cp)/2;
-        uint midabIndex = (midabn*(midabn+1))/2 + midabp;
-        uint midacIndex = (midacn*(midacn+1))/2 + midacp;
-        uint midbcIndex = (midbcn*(midbcn+1))/2 + midbcp;
-
-        A = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-        B = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-        C = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-        O = std::unique_ptr<TriangularSubdivision<Point> >(new TriangularSubdivision<Point>);
-
-        /* C++14
-        A = std::make_unique< TriangularSubdivision<Point> >();
-        B = std::make_unique< TriangularSubdivision<Point> >();
-        C = std::make_unique< TriangularSubdivision<Point> >();
-        O = std::make_unique< TriangularSubdivision<Point>> ();
-        */
-
-
-        A->constructIndices(aIndex, midabIndex, midacIndex, depth - 1, totalDepth, an, midabn, midacn, ap, midabp, midacp, points);
-        B->constructIndices(midabIndex, bIndex, midbcIndex, depth - 1, totalDepth, midabn, bn, midbcn, midabp, bp, midbcp, points);
-        C->constructIndices(midacIndex, midbcIndex, cIndex, depth - 1, totalDepth, midacn, midbcn, cn, midacp, midbcp, cp, points);
-        O->constructIndices(midbcIndex, midacIndex, midabIndex, depth - 1, totalDepth, midbcn, midacn, midabn, midbcp, midacp, midabp, points);
-    }
+    return (n*(n+1))/2 + p;
 }
 
 template <typename Point> void TriangularSubdivision<Point>::initializeSubdivisionByMidpoints(const Point &a, const Point &b, const Point &c)
 {
     uint N = nbPoints(depth);
     uint L = nbLines(depth);
-    points->resize(N);
+    points.resize(N);
     std::vector<bool> filled;
     filled.resize(N);
     std::fill(filled.begin(), filled.end(), false);
 
-    points->at(aIndex) = a;
-    points->at(bIndex) = b;
-    points->at(cIndex) = c;
-    filled[aIndex] = true;
-    filled[bIndex] = true;
-    filled[cIndex] = true;
-
     uint an = 0, ap = 0, bn = L - 1, bp = 0, cn = L - 1, cp = L - 1;
 
-    constructMidpoints(an, bn, cn, ap, bp, cp, filled);
+    points[index(an, ap)] = a;
+    points[index(bn, bp)] = b;
+    points[index(cn, cp)] = c;
+    filled[index(an, ap)] = true;
+    filled[index(bn, bp)] = true;
+    filled[index(cn, cp)] = true;
+
+    constructMidpoints(depth, an, bn, cn, ap, bp, cp, filled);
 }
 
 
-template <typename Point> void TriangularSubdivision<Point>::constructMidpoints(uint an, uint bn, uint cn,
+template <typename Point> void TriangularSubdivision<Point>::constructMidpoints(uint depth, uint an, uint bn, uint cn,
                                                                                 uint ap, uint bp, uint cp, std::vector<bool> &filled)
 {
     if (depth != 0)
     {
         uint midabn = (an + bn)/2, midacn = (an + cn)/2, midbcn = (bn + cn)/2;
         uint midabp = (ap + bp)/2, midacp = (ap + cp)/2, midbcp = (bp + cp)/2;
-        uint midabIndex = (midabn*(midabn+1))/2 + midabp;
-        uint midacIndex = (midacn*(midacn+1))/2 + midacp;
-        uint midbcIndex = (midbcn*(midbcn+1))/2 + midbcp;
+        uint aIndex = index(an, ap), bIndex = index(bn, bp), cIndex = index(cn, cp);
+        uint midabIndex = index(midabn, midabp);
+        uint midacIndex = index(midacn, midacp);
+        uint midbcIndex = index(midbcn, midbcp);
 
         if (!filled[midabIndex])
         {
-            points->at(midabIndex) = Point::midpoint(points->at(aIndex), points->at(bIndex));
+            points[midabIndex] = Point::midpoint(points[aIndex], points[bIndex]);
             filled[midabIndex] = true;
         }
         if (!filled[midacIndex])
         {
-            points->at(midacIndex) = Point::midpoint(points->at(aIndex), points->at(cIndex));
+            points[midacIndex] = Point::midpoint(points[aIndex], points[cIndex]);
             filled[midacIndex] = true;
         }
         if (!filled[midbcIndex])
         {
-            points->at(midbcIndex) = Point::midpoint(points->at(bIndex), points->at(cIndex));
+            points[midbcIndex] = Point::midpoint(points[bIndex], points[cIndex]);
             filled[midbcIndex] = true;
         }
 
-        A->constructMidpoints(an, midabn, midacn, ap, midabp, midacp, filled);
-        B->constructMidpoints(midabn, bn, midbcn, midabp, bp, midbcp, filled);
-        C->constructMidpoints(midacn, midbcn, cn, midacp, midbcp, cp, filled);
-        O->constructMidpoints(midbcn, midacn, midabn, midbcp, midacp, midabp, filled);
-    }
-}
-
-
-
-template <typename Point> TriangularSubdivision<Point>::TriangularSubdivision(const std::vector<Point> &points, uint depth)
-{
-    if (nbPoints(depth) == points.size())
-    {
-        this->points = std::make_shared< std::vector<Point> >(points);
-        totalDepth = depth;
-        uint L = nbLines(depth), N = nbPoints(depth);
-
-        uint an = 0, ap = 0, bn = L - 1, bp = 0, cn = L - 1, cp = L - 1;
-        aIndex = 0;
-        cIndex = N - 1;
-        bIndex = cIndex - cp;
-
-        constructIndices(aIndex, bIndex, cIndex, depth, depth, an, bn, cn, ap, bp, cp, this->points);
-    }
-    else
-    {
-        throw(QString("Error in H2TriangleSubdivision::H2TriangleSubdivision(const std::vector<H2Point> &points, int depth): points.size() does not match expected size"));
+        constructMidpoints(depth - 1, an, midabn, midacn, ap, midabp, midacp, filled);
+        constructMidpoints(depth - 1, midabn, bn, midbcn, midabp, bp, midbcp, filled);
+        constructMidpoints(depth - 1, midacn, midbcn, cn, midacp, midbcp, cp, filled);
+        constructMidpoints(depth - 1, midbcn, midacn, midabn, midbcp, midacp, midabp, filled);
     }
 }
 
@@ -251,38 +110,67 @@ template <typename Point> uint TriangularSubdivision<Point>::nbLines(uint depth)
 
 template <typename Point> uint TriangularSubdivision<Point>::getTotalDepth() const
 {
-    return totalDepth;
-}
-
-template <typename Point> bool TriangularSubdivision<Point>::isRoot() const
-{
-    return depth == totalDepth;
+    return depth;
 }
 
 template <typename Point> std::vector<Point> TriangularSubdivision<Point>::getPoints() const
 {
-    return *points;
+    return points;
 }
 
 template <typename Point> Point TriangularSubdivision<Point>::getPoint(uint index) const
 {
-    return points->at(index);
+    return points.at(index);
 }
 
 template <typename Point> void TriangularSubdivision<Point>::getBigTriangle(Point &outA, Point &outB, Point &outC) const
 {
-    outA = points->at(aIndex);
-    outB = points->at(bIndex);
-    outC = points->at(cIndex);
+    uint L = nbLines(depth);
+    outA = points.at(index(0, 0));
+    outB = points.at(index(L - 1, 0));
+    outC = points.at(index(L - 1, L - 1));
 }
 
-template <> bool TriangularSubdivision<H2Point>::triangleContaining(const H2Point &point, H2Point &outA, H2Point &outB, H2Point &outC,
-                                                                    uint &index1, uint&index2, uint &index3) const
+template <typename Point> std::vector<uint> TriangularSubdivision<Point>::trianglesIndices(uint depth)
 {
-    getBigTriangle(outA, outB, outC);
-    index1 = aIndex;
-    index2 = bIndex;
-    index3 = cIndex;
+    uint L = nbLines(depth);
+    std::vector<uint> out;
+    out.reserve(3*Tools::exponentiation(4, depth));
+    trianglesIndices(depth, 0, L - 1, L - 1, 0, 0, L - 1, out);
+    return out;
+}
+
+template <typename Point> void TriangularSubdivision<Point>::trianglesIndices(uint depth, uint an, uint bn, uint cn, uint ap, uint bp, uint cp,
+                                                                              std::vector<uint> &out)
+{
+    if (depth == 0)
+    {
+        out.push_back(index(an, ap));
+        out.push_back(index(bn, bp));
+        out.push_back(index(cn, cp));
+    }
+    else
+    {
+        uint midabn = (an + bn)/2, midacn = (an + cn)/2, midbcn = (bn + cn)/2;
+        uint midabp = (ap + bp)/2, midacp = (ap + cp)/2, midbcp = (bp + cp)/2;
+        trianglesIndices(depth - 1, an, midabn, midacn, ap, midabp, midacp, out);
+        trianglesIndices(depth - 1, midabn, bn, midbcn, midabp, bp, midbcp, out);
+        trianglesIndices(depth - 1, midacn, midbcn, cn, midacp, midbcp, cp, out);
+        trianglesIndices(depth - 1, midbcn, midacn, midabn, midbcp, midacp, midabp, out);
+    }
+}
+
+template <> template <typename PointAt>
+bool TriangularSubdivision<H2Point>::triangleContaining(const H2Point &point, const PointAt &pointAt,
+                                                        uint depth, uint an, uint bn, uint cn, uint ap, uint bp, uint cp,
+                                                        H2Point &outA, H2Point &outB, H2Point &outC, uint &index1, uint&index2, uint &index3)
+{
+    index1 = index(an, ap);
+    index2 = index(bn, bp);
+    index3 = index(cn, cp);
+    outA = pointAt(index1);
+    outB = pointAt(index2);
+    outC = pointAt(index3);
 
     if (H2Triangle(outA, outB, outC).contains(point))
     {
@@ -292,10 +180,12 @@ template <> bool TriangularSubdivision<H2Point>::triangleContaining(const H2Poin
         }
         else
         {
-            if (A->triangleContaining(point, outA, outB, outC, index1, index2, index3) ||
-                    B->triangleContaining(point, outA, outB, outC, index1, index2, index3) ||
-                    C->triangleContaining(point, outA, outB, outC, index1, index2, index3) ||
-                    O->triangleContaining(point, outA, outB, outC, index1, index2, index3))
+            uint midabn = (an + bn)/2, midacn = (an + cn)/2, midbcn = (bn + cn)/2;
+            uint midabp = (ap + bp)/2, midacp = (ap + cp)/2, midbcp = (bp + cp)/2;
+            if (triangleContaining(point, pointAt, depth - 1, an, midabn, midacn, ap, midabp, midacp, outA, outB, outC, index1, index2, index3) ||
+                    triangleContaining(point, pointAt, depth - 1, midabn, bn, midbcn, midabp, bp, midbcp, outA, outB, outC, index1, index2, index3) ||
+                    triangleContaining(point, pointAt, depth - 1, midacn, midbcn, cn, midacp, midbcp, cp, outA, outB, outC, index1, index2, index3) ||
+                    triangleContaining(point, pointAt, depth - 1, midbcn, midacn, midabn, midbcp, midacp, midabp, outA, outB, outC, index1, index2, index3))
             {
                 return true;
             }
@@ -312,18 +202,31 @@ template <> bool TriangularSubdivision<H2Point>::triangleContaining(const H2Poin
     }
 }
 
-template <typename Point> std::vector<bool> TriangularSubdivision<Point>::areBoundaryPoints() const
+template <> bool TriangularSubdivision<H2Point>::triangleContaining(const H2Point &point, H2Point &outA, H2Point &outB, H2Point &outC,
+                                                                    uint &index1, uint&index2, uint &index3) const
 {
-    if (depth != totalDepth)
-    {
-        throw(QString("ERROR in H2TriangleSubdivision::areBoundaryPoints : not a root subdivision"));
-    }
+    uint L = nbLines(depth);
+    auto pointAt = [this](uint index) {return points.at(index);};
+    return triangleContaining(point, pointAt, depth, 0, L - 1, L - 1, 0, 0, L - 1, outA, outB, outC, index1, index2, index3);
+}
+
+template <> bool TriangularSubdivision<H2Point>::triangleContaining(const H2Point &point, const std::vector<H2Point> &values,
+                                                                    const std::vector<uint> &indicesInValues, uint depth,
+                                                                    H2Point &outA, H2Point &outB, H2Point &outC,
+                                                                    uint &index1, uint&index2, uint &index3)
+{
+    uint L = nbLines(depth);
+    auto pointAt = [&values, &indicesInValues](uint index) {return values.at(indicesInValues.at(index));};
+    return triangleContaining(point, pointAt, depth, 0, L - 1, L - 1, 0, 0, L - 1, outA, outB, outC, index1, index2, index3);
+}
 
-    std::vector<bool> res(points->size());
+template <typename Point> std::vector<bool> TriangularSubdivision<Point>::areBoundaryPoints() const
+{
+    std::vector<bool> res(points.size());
     std::fill(res.begin(), res.end(), false);
 
 
-    uint i, k=0, L = nbLines(totalDepth);
+    uint i, k=0, L = nbLines(depth);
     res[0] = true;
     for (i=1; i<L-1; i++)
     {
@@ -341,21 +244,17 @@ template <typename Point> std::vector<bool> TriangularSubdivision<Point>::areBou
 
 template <typename Point> std::vector<std::vector<uint> > TriangularSubdivision<Point>::neighborsIndices() const
 {
-    if (depth != totalDepth)
-    {
-        throw(QString("ERROR in H2TriangleSubdivision::neighborsIndices : not a root subdivision"));
-    }
-    if (points == nullptr)
+    if (points.empty())
     {
         throw(QString("ERROR in H2TriangleSubdivision::neighborsIndices : empty subdivision"));
     }
 
     std::vector< std::vector<uint> > out;
-    out.reserve(points->size());
+    out.reserve(points.size());
 
     std::vector<uint> neighbors = {1, 2};
     out.push_back(neighbors);
-    uint i, j, k = 0, L = nbLines(totalDepth);
+    uint i, j, k = 0, L = nbLines(depth);
     for (i=1; i!=L-1; ++i)
     {
         k += i;
@@ -386,13 +285,8 @@ template <typename Point> std::vector<std::vector<uint> > TriangularSubdivision<
 
 template <typename Point> std::vector<uint> TriangularSubdivision<Point>::sidePointsIndices(uint vertexIndex1, uint vertexIndex2) const
 {
-    if (depth != totalDepth)
-    {
-        qDebug() << "WARNING in H2TriangleSubdivision::SidePointsIndices: not a root subdivision";
-    }
-
     std::vector<uint> out;
-    uint L = nbLines(totalDepth);
+    uint L = nbLines(depth);
     out.resize(L);
 
     uint i, k;
@@ -7,56 +7,58 @@ class H2Point; class H2Triangle; class H2Isometry;
 template <typename Point, typename Map> class LiftedGraphFunctionTriangulated;
 
 
+// The points of the subdivision of depth d are stored in one flat array: line n = 0, ..., 2^d has n+1 points,
+// and the point in line n and position p has index n(n+1)/2 + p. The vertices of the big triangle are (0,0), (2^d,0) and (2^d,2^d).
+// A triangle with vertices a, b, c is subdivided into A = (a, mid(a,b), mid(a,c)), B = (mid(a,b), b, mid(b,c)),
+// C = (mid(a,c), mid(b,c), c) and O = (mid(b,c), mid(a,c), mid(a,b)): the sub-triangles are computed from the line
+// and position coordinates of their vertices, so that copying a subdivision only copies its points.
+// trianglesIndices() lists the smallest triangles, three indices each, in the order and with the vertices order of triangleContaining().
+// The static triangleContaining() searches a subdivision whose point of index i is values[indicesInValues[i]], without copying it.
 template <typename Point> class TriangularSubdivision
 {
     friend class H2Mesh;
     friend class H2MeshConstructor;
-    template <typename S> friend void swap(TriangularSubdivision<S> &first, TriangularSubdivision<S> &second);
-    //template <typename Point, typename Map> friend class LiftedGraphFunctionTriangulated;
     friend class LiftedGraphFunctionTriangulated<H2Point, H2Isometry>;
 
 public:
     TriangularSubdivision();
-    TriangularSubdivision(const TriangularSubdivision<Point> &other);
     TriangularSubdivision(uint depth);
     TriangularSubdivision(const std::vector<Point> &points, uint depth);
-    TriangularSubdivision<Point> & operator=(TriangularSubdivision<Point> other);
 
     void initializeSubdivisionByMidpoints(const Point &a, const Point &b, const Point &c);
 
     uint getTotalDepth() const;
-    bool isRoot() const;
 
     static uint nbLines(uint depth);
     static uint nbPoints(uint depth);
     static uint nbInteriorPoints(uint depth);
     static uint nbBoundaryPoints(uint depth);
     std::vector<uint> sidePointsIndices(uint vertexIndex1, uint vertexIndex2) const;
+    static std::vector<uint> trianglesIndices(uint depth);
 
     void getBigTriangle(Point &outA, Point &outB, Point &outC) const;
     std::vector<Point> getPoints() const;
     Point getPoint(uint index) const;
 
     bool triangleContaining(const H2Point &point, Point &outA, Point &outB, Point &outC, uint &index1, uint&index2, uint &index3) const;
+    static bool triangleContaining(const H2Point &point, const std::vector<Point> &values, const std::vector<uint> &indicesInValues, uint depth,
+                                   Point &outA, Point &outB, Point &outC, uint &index1, uint&index2, uint &index3);
 
 
     std::vector<std::vector<uint> > neighborsIndices() const;
     std::vector<bool> areBoundaryPoints() const;
 
 private:
-    void constructIndices(uint aIndex, uint bIndex, uint cIndex, uint depth, uint totalDepth,
-                          uint an, uint bn, uint cn, uint ap, uint bp, uint cp, std::shared_ptr< std::vector<Point> > points);
-    void constructMidpoints( uint an, uint bn, uint cn, uint ap, uint bp, uint cp, std::vector<bool> &filled);
-    void constructWithGivenPoints(uint aIndex, uint bIndex, uint cIndex, uint depth, uint totalDepth, std::vector<H2Point> *points,
-                   std::vector<bool> &filled, uint an, uint bn, uint cn, uint ap, uint bp, uint cp);
-    void copy(const TriangularSubdivision<Point> &other,  std::shared_ptr< std::vector<Point> > points);
+    static uint index(uint n, uint p);
+    static void trianglesIndices(uint depth, uint an, uint bn, uint cn, uint ap, uint bp, uint cp, std::vector<uint> &out);
+    void constructMidpoints(uint depth, uint an, uint bn, uint cn, uint ap, uint bp, uint cp, std::vector<bool> &filled);
+    template <typename PointAt> static bool triangleContaining(const H2Point &point, const PointAt &pointAt,
+                                                               uint depth, uint an, uint bn, uint cn, uint ap, uint bp, uint cp,
+                                                               Point &outA, Point &outB, Point &outC, uint &index1, uint&index2, uint &index3);
 
 
 
-    std::unique_ptr< TriangularSubdivision<Point> > A, B, C, O;
-    uint aIndex, bIndex, cIndex;
-    uint depth, totalDepth;
-
-    std::shared_ptr< std::vector<Point> > points;
+    uint depth;
+    std::vector<Point> points;
 };
 #endif // TRIANGULARSUBDIVISION_H
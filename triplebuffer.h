@@ -0,0 +1,69 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+#include "tools.h"
+
+
+// Latest value channel for exactly one writer thread and one reader thread, where neither ever waits for the other.
+// The writer fills getWriteBuffer() and calls publish(). The reader calls update(), which returns true if a buffer was published
+// since its last call, and then reads getReadBuffer(), which stays valid until its next call to update().
+// Each thread owns one of the three buffers, and the third one holds the latest published buffer: publish() and update()
+// exchange their buffer with it. The buffers are reused, so that a vector filled in place is only allocated the first times.
+// discard() drops a published buffer that the reader has not taken; it must only be called while neither thread uses the channel.
+
+template <typename T> class TripleBuffer
+{
+public:
+    TripleBuffer();
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer & operator=(TripleBuffer) = delete;
+
+    T & getWriteBuffer() {return buffers[writeIndex];}
+    void publish();
+    bool update();
+    void discard();
+    const T & getReadBuffer() const {return buffers[readIndex];}
+
+private:
+    // Index of the latest published buffer, with isFreshBit set until the reader takes it
+    static const uint isFreshBit = 4;
+
+    T buffers[3];
+
+    // writeIndex is only used by the writer and readIndex by the reader: they are kept on different cache lines
+    char paddingBefore[64];
+    uint writeIndex;
+    char paddingBetween[64];
+    uint readIndex;
+    char paddingAfter[64];
+    std::atomic<uint> latestIndex;
+};
+
+
+template <typename T> TripleBuffer<T>::TripleBuffer() : writeIndex(0), readIndex(1), latestIndex(2)
+{
+}
+
+template <typename T> void TripleBuffer<T>::publish()
+{
+    writeIndex = latestIndex.exchange(writeIndex | isFreshBit, std::memory_order_acq_rel) & ~isFreshBit;
+}
+
+template <typename T> bool TripleBuffer<T>::update()
+{
+    if (!(latestIndex.load(std::memory_order_relaxed) & isFreshBit))
+    {
+        return false;
+    }
+    readIndex = latestIndex.exchange(readIndex, std::memory_order_acq_rel) & ~isFreshBit;
+    return true;
+}
+
+template <typename T> void TripleBuffer<T>::discard()
+{
+    latestIndex.fetch_and(~isFreshBit, std::memory_order_relaxed);
+}
+
+#endif // TRIPLEBUFFER_H